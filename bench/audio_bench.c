@@ -0,0 +1,200 @@
+/*
+ * audio_bench.c
+ *
+ * Decode throughput benchmark. Decodes every track under the given paths
+ * as fast as possible, through the same decoder backends as the player
+ * (mpg123 for MP3, in-place PCM for WAV), into an unpaced null sink. No
+ * audio hardware needed.
+ *
+ * Per track it prints the realtime factor (seconds of audio per wall
+ * second), decoder CPU time per second of audio, and peak resident memory.
+ *
+ *   ./build/blackhand-audio-bench [file-or-dir ...]   (default ./Music)
+ */
+#include <dirent.h>
+#include <mpg123.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "audio/audio_decoder.h"
+#include "audio/audio_sink.h"
+
+typedef struct {
+    double audio_sec;
+    double wall_sec;
+    double cpu_sec;
+    long peak_kb;
+} track_result;
+
+static double clock_sec(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Peak RSS is process-wide and only grows. On Linux writing 5 to
+ * clear_refs resets it, so each track gets its own peak; elsewhere the
+ * figure is the running maximum.
+ */
+static void reset_peak_memory(void) {
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (!f) return;
+    fputs("5", f);
+    fclose(f);
+}
+
+static long peak_memory_kb(void) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+        }
+        fclose(f);
+        if (kb >= 0) return kb;
+    }
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+#if defined(__APPLE__)
+    return ru.ru_maxrss / 1024; /* bytes on macOS */
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+static int decode_track(const char *path, audio_sink_t *sink, track_result *out) {
+    memset(out, 0, sizeof(*out));
+
+    reset_peak_memory();
+    double wall0 = clock_sec(CLOCK_MONOTONIC);
+    double cpu0 = clock_sec(CLOCK_THREAD_CPUTIME_ID);
+
+    audio_decoder_t dec;
+    int result = -1;
+    unsigned long long frames = 0;
+    if (audio_decoder_open(&dec, path) != 0) return -1;
+
+    /* The player's decoders all produce signed 16-bit. */
+    if (audio_sink_start(sink, dec.rate, dec.channels, MPG123_ENC_SIGNED_16) != 0) goto done;
+
+    size_t frame_bytes = (size_t)dec.channels * sizeof(int16_t);
+    while (1) {
+        const unsigned char *pcm;
+        size_t done_bytes = 0;
+        int r = audio_decoder_read(&dec, &pcm, &done_bytes);
+        if (r == AUDIO_DECODER_NEW_FORMAT) {
+            if (audio_sink_start(sink, dec.rate, dec.channels, MPG123_ENC_SIGNED_16) != 0) break;
+            frame_bytes = (size_t)dec.channels * sizeof(int16_t);
+            continue;
+        }
+        if (r == AUDIO_DECODER_ERROR) break;
+
+        audio_sink_play(sink, pcm, done_bytes);
+        frames += done_bytes / frame_bytes;
+        if (r == AUDIO_DECODER_DONE) {
+            result = 0;
+            break;
+        }
+    }
+
+done:
+    out->wall_sec = clock_sec(CLOCK_MONOTONIC) - wall0;
+    out->cpu_sec = clock_sec(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+    out->audio_sec = dec.rate > 0 ? (double)frames / (double)dec.rate : 0.0;
+    out->peak_kb = peak_memory_kb();
+
+    audio_decoder_close(&dec);
+    return result;
+}
+
+typedef struct {
+    track_result total;
+    int tracks;
+    int failed;
+    long peak_kb;
+    audio_sink_t *sink;
+} bench_state;
+
+static void bench_file(bench_state *bs, const char *path) {
+    track_result tr;
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+
+    if (decode_track(path, bs->sink, &tr) != 0) {
+        printf("%-28.28s  decode failed\n", name);
+        bs->failed++;
+        return;
+    }
+
+    double rtf = tr.wall_sec > 0.0 ? tr.audio_sec / tr.wall_sec : 0.0;
+    double cpu_ms = tr.audio_sec > 0.0 ? tr.cpu_sec * 1000.0 / tr.audio_sec : 0.0;
+    printf("%-28.28s %8.1f %9.1fx %9.2f %9ld\n", name, tr.audio_sec, rtf, cpu_ms, tr.peak_kb);
+
+    bs->total.audio_sec += tr.audio_sec;
+    bs->total.wall_sec += tr.wall_sec;
+    bs->total.cpu_sec += tr.cpu_sec;
+    if (tr.peak_kb > bs->peak_kb) bs->peak_kb = tr.peak_kb;
+    bs->tracks++;
+}
+
+static void bench_path(bench_state *bs, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "audio-bench: cannot stat %s\n", path);
+        bs->failed++;
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        bench_file(bs, path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char child[1024];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (stat(child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode) || audio_decoder_find(entry->d_name)) bench_path(bs, child);
+    }
+    closedir(dir);
+}
+
+int main(int argc, char **argv) {
+    if (mpg123_init() != MPG123_OK) return 1;
+
+    audio_sink_t sink;
+    if (audio_sink_open(&sink, AUDIO_SINK_NULL, NULL, 0, 0.0) != 0) return 1;
+
+    bench_state bs;
+    memset(&bs, 0, sizeof(bs));
+    bs.sink = &sink;
+
+    printf("%-28s %8s %10s %9s %9s\n", "track", "audio s", "realtime", "cpu ms/s", "peak KB");
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) bench_path(&bs, argv[i]);
+    } else {
+        bench_path(&bs, "./Music");
+    }
+
+    if (bs.tracks > 0) {
+        double rtf = bs.total.wall_sec > 0.0 ? bs.total.audio_sec / bs.total.wall_sec : 0.0;
+        double cpu_ms = bs.total.audio_sec > 0.0 ? bs.total.cpu_sec * 1000.0 / bs.total.audio_sec : 0.0;
+        printf("%-28s %8.1f %9.1fx %9.2f %9ld\n", "TOTAL", bs.total.audio_sec, rtf, cpu_ms, bs.peak_kb);
+    }
+    printf("%d tracks decoded, %d failed\n", bs.tracks, bs.failed);
+
+    audio_sink_close(&sink, 0);
+    mpg123_exit();
+    return bs.failed > 0 ? 1 : 0;
+}
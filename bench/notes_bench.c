@@ -0,0 +1,228 @@
+/*
+ * notes_bench.c
+ *
+ * Note search timing over a synthetic notebook. Builds the full-text
+ * index in memory, saves it, maps it back, then searches it the way the
+ * search screen does: once per keystroke, the last word as a prefix.
+ * Each query also runs as a scan that tokenizes every note, and the
+ * match counts have to agree. Finally a few hundred notes are edited so
+ * searches cover both the mapped file and the in-memory part.
+ *
+ *   ./build/blackhand-notes-bench [notes]   (default 5000)
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "services/notes_index.h"
+
+#define BENCH_REPS 21
+#define BENCH_WORDS 20000	/* Vocabulary size */
+#define BENCH_NOTE_WORDS 300 /* Average words per note */
+#define BENCH_EDITS 500
+#define BENCH_HITS 20
+
+typedef struct {
+    char name[32];
+    char title[64];
+    char *body;
+} bench_note_t;
+
+static char words[BENCH_WORDS][12];
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* Roughly Zipf: low word numbers are far more common, as in real text. */
+static const char *random_word(uint64_t *s) {
+    double u = (double)(next_random(s) % 1000000) / 1000000.0;
+    size_t w = (size_t)((double)BENCH_WORDS * u * u * u);
+    return words[w < BENCH_WORDS ? w : BENCH_WORDS - 1];
+}
+
+static void make_word(char *out, size_t size, uint64_t *s) {
+    static const char letters[] = "etaoinshrdlucmfwypvbgkjqxz";
+    size_t len = 3 + next_random(s) % 7;
+    if (len >= size) len = size - 1;
+    for (size_t i = 0; i < len; i++) out[i] = letters[next_random(s) % (i == 0 ? 20 : 26)];
+    out[len] = '\0';
+}
+
+static void make_note(bench_note_t *n, size_t i, uint64_t *s) {
+    snprintf(n->name, sizeof(n->name), "note_%06zu.md", i);
+    snprintf(n->title, sizeof(n->title), "%s %s", random_word(s), random_word(s));
+    size_t count = BENCH_NOTE_WORDS / 2 + next_random(s) % BENCH_NOTE_WORDS;
+    size_t cap = count * 12 + 1;
+    free(n->body);
+    n->body = malloc(cap);
+    size_t len = 0;
+    for (size_t w = 0; w < count && n->body; w++) {
+        const char *word = random_word(s);
+        size_t wl = strlen(word);
+        memcpy(n->body + len, word, wl);
+        len += wl;
+        n->body[len++] = (w % 12 == 11) ? '\n' : ' ';
+    }
+    if (n->body) n->body[len] = '\0';
+}
+
+/* Does text hold token (or a word starting with it, for a prefix)? */
+static int text_has(const char *text, const char *token, int prefix) {
+    char t[NOTES_INDEX_TOKEN_MAX + 1];
+    size_t len = strlen(token);
+    while (notes_index_next_token(&text, t) > 0) {
+        if (prefix ? strncmp(t, token, len) == 0 : strcmp(t, token) == 0) return 1;
+    }
+    return 0;
+}
+
+/* The same query by reading every note. */
+static size_t scan_matches(const bench_note_t *notes, size_t count, const char *query) {
+    char tokens[8][NOTES_INDEX_TOKEN_MAX + 1];
+    size_t n = 0;
+    const char *q = query;
+    while (n < 8 && notes_index_next_token(&q, tokens[n]) > 0) n++;
+    size_t qlen = strlen(query);
+    int typing = qlen > 0 && query[qlen - 1] != ' ';
+
+    size_t matches = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t k = 0;
+        for (; k < n; k++) {
+            int prefix = typing && k == n - 1;
+            if (!text_has(notes[i].title, tokens[k], prefix) && !text_has(notes[i].body, tokens[k], prefix)) break;
+        }
+        matches += n > 0 && k == n;
+    }
+    return matches;
+}
+
+static double median(double *v, int n) {
+    for (int i = 1; i < n; i++) {
+        double x = v[i];
+        int k = i - 1;
+        while (k >= 0 && v[k] > x) {
+            v[k + 1] = v[k];
+            k--;
+        }
+        v[k + 1] = x;
+    }
+    return v[n / 2];
+}
+
+/* Time every keystroke of query against the index and once as a scan. */
+static int bench_query(const notes_index_t *ix, const bench_note_t *notes, size_t count, const char *query) {
+    notes_index_hit_t hits[BENCH_HITS];
+    char typed[128];
+    size_t qlen = strlen(query);
+    double worst = 0.0;
+    size_t matches = 0;
+    for (size_t k = 1; k <= qlen && k < sizeof(typed); k++) {
+        memcpy(typed, query, k);
+        typed[k] = '\0';
+        double t[BENCH_REPS];
+        for (int r = 0; r < BENCH_REPS; r++) {
+            double t0 = now_sec();
+            matches = notes_index_search(ix, typed, hits, BENCH_HITS);
+            t[r] = (now_sec() - t0) * 1e3;
+        }
+        double m = median(t, BENCH_REPS);
+        if (m > worst) worst = m;
+    }
+
+    double t0 = now_sec();
+    size_t scanned = scan_matches(notes, count, query);
+    double scan_ms = (now_sec() - t0) * 1e3;
+    int ok = scanned == matches;
+    printf("%-24s %8zu %9.3f ms %9.1f ms %s\n", query, matches, worst, scan_ms, ok ? "" : "MISMATCH");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t count = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 5000;
+    if (count == 0) count = 1;
+
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < BENCH_WORDS; i++) make_word(words[i], sizeof(words[i]), &seed);
+
+    bench_note_t *notes = calloc(count, sizeof(*notes));
+    if (!notes) return 1;
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        make_note(&notes[i], i, &seed);
+        if (!notes[i].body) return 1;
+        bytes += strlen(notes[i].body);
+    }
+
+    const char *path = "/tmp/blackhand-notes-bench.index";
+    notes_index_t ix;
+    notes_index_open(&ix, "/nonexistent");
+
+    double t0 = now_sec();
+    for (size_t i = 0; i < count; i++) {
+        if (notes_index_put(&ix, notes[i].name, 0, 0, notes[i].title, notes[i].body) != 0) return 1;
+    }
+    double build_ms = (now_sec() - t0) * 1e3;
+    t0 = now_sec();
+    if (notes_index_save(&ix, path) != 0) return 1;
+    double save_ms = (now_sec() - t0) * 1e3;
+    t0 = now_sec();
+    if (notes_index_reload(&ix, path) != 0) return 1;
+    double load_ms = (now_sec() - t0) * 1e3;
+    struct stat st;
+    long file_kb = stat(path, &st) == 0 ? (long)(st.st_size / 1024) : -1;
+
+    printf("%zu notes, %.1f MB of text\n", count, (double)bytes / 1e6);
+    printf("index %.1f ms, save %.1f ms, map %.2f ms, file %ld KB\n", build_ms, save_ms, load_ms, file_kb);
+
+    const char *queries[] = {
+        words[0], words[40], words[3000], words[19000], "", "", "", "",
+    };
+    char pair[64], triple[96], title[96], miss[16];
+    snprintf(pair, sizeof(pair), "%s %s", words[10], words[200]);
+    snprintf(triple, sizeof(triple), "%s %s %s", words[5], words[50], words[500]);
+    snprintf(title, sizeof(title), "%s", notes[count / 2].title);
+    snprintf(miss, sizeof(miss), "zzqqxx");
+    queries[4] = pair;
+    queries[5] = triple;
+    queries[6] = title;
+    queries[7] = miss;
+
+    int all_ok = 1;
+    printf("%-24s %8s %12s %12s\n", "query (typed)", "matches", "worst key", "scan");
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        all_ok &= bench_query(&ix, notes, count, queries[q]);
+    }
+
+    /* Edit some notes: their new text lives in memory, the old is masked in the file. */
+    t0 = now_sec();
+    for (int e = 0; e < BENCH_EDITS; e++) {
+        size_t i = (size_t)(next_random(&seed) % count);
+        make_note(&notes[i], i, &seed);
+        if (notes_index_put(&ix, notes[i].name, 1, 1, notes[i].title, notes[i].body) != 0) return 1;
+    }
+    double edit_us = (now_sec() - t0) * 1e6 / BENCH_EDITS;
+    printf("after %d edits (%.1f us each):\n", BENCH_EDITS, edit_us);
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        all_ok &= bench_query(&ix, notes, count, queries[q]);
+    }
+
+    notes_index_close(&ix);
+    remove(path);
+    for (size_t i = 0; i < count; i++) free(notes[i].body);
+    free(notes);
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/*
+ * notes_save_bench.c
+ *
+ * Key-to-frame latency while notes are being saved. Runs the notes
+ * service in a scratch directory and drives it the way the UI loop does:
+ * each frame handles one key, then polls for finished saves, then waits
+ * for the next frame. The same frames run four ways:
+ *
+ *   idle        keys that do not save (cursor moves), the baseline
+ *   async       every key edits a note and saves it through the service
+ *   sync fopen  every key rewrites the note in place on the frame thread,
+ *               as notes_service did before the background writer
+ *   sync fsync  every key writes a temporary file, syncs and renames it on
+ *               the frame thread, which is what a crash-safe save costs there
+ *
+ * Per run it prints the median, 99th percentile and worst frame time; for
+ * async also how many file writes the saves were merged into. Afterwards
+ * every note file must hold the last text saved.
+ *
+ *   ./build/blackhand-notes-save-bench [frames] [note KB]   (default 600, 64)
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "services/notes_service.h"
+
+#define BENCH_NOTES 8
+#define FRAME_GAP_US 2000 /* Wait between frames: 500 keys a second, far faster than typing */
+
+typedef struct {
+    Note *note;
+    char *text;
+    size_t len;
+} bench_note_t;
+
+typedef enum { RUN_IDLE, RUN_ASYNC, RUN_SYNC_FOPEN, RUN_SYNC_FSYNC } run_kind;
+
+static bench_note_t notes[BENCH_NOTES];
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void edit(bench_note_t *b, int frame) {
+    b->text[((size_t)frame * 7919u) % b->len] = (char)('a' + frame % 26);
+}
+
+static void write_fopen(const Note *n, const char *text) {
+    char path[1024];
+    snprintf(path, sizeof(path), "./Notes/%s", n->filename);
+    FILE *f = fopen(path, "w");
+    if (!f) return;
+    fprintf(f, "Title: %s\n", n->title);
+    fprintf(f, "Created: %s\n\n", n->created_at);
+    fprintf(f, "%s", text);
+    fclose(f);
+}
+
+static void write_fsync(const Note *n, const char *text) {
+    char path[1024];
+    char tmp[1100];
+    snprintf(path, sizeof(path), "./Notes/%s", n->filename);
+    snprintf(tmp, sizeof(tmp), "./Notes/.%s.tmp", n->filename);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+    fprintf(f, "Title: %s\nCreated: %s\n\n%s", n->title, n->created_at, text);
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    rename(tmp, path);
+    int dir = open("./Notes", O_RDONLY | O_DIRECTORY);
+    if (dir >= 0) {
+        fsync(dir);
+        close(dir);
+    }
+}
+
+static void run(run_kind kind, const char *label, int frames, double *t) {
+    size_t polled = 0;
+    for (int f = 0; f < frames; f++) {
+        bench_note_t *b = &notes[f % BENCH_NOTES];
+        double t0 = now_sec();
+        if (kind != RUN_IDLE) edit(b, f);
+        if (kind == RUN_ASYNC) {
+            Note edited = *b->note;
+            edited.content = b->text;
+            notes_service_update_note(&edited);
+        } else if (kind == RUN_SYNC_FOPEN) {
+            write_fopen(b->note, b->text);
+        } else if (kind == RUN_SYNC_FSYNC) {
+            write_fsync(b->note, b->text);
+        }
+        polled += notes_service_poll();
+        t[f] = (now_sec() - t0) * 1e3;
+        usleep(FRAME_GAP_US);
+    }
+
+    qsort(t, (size_t)frames, sizeof(*t), cmp_double);
+    printf("%-12s %9.3f ms %9.3f ms %9.3f ms", label, t[frames / 2], t[frames * 99 / 100], t[frames - 1]);
+    if (kind == RUN_ASYNC) {
+        /* Let the writer finish, counting the writes it made. */
+        for (int i = 0; i < BENCH_NOTES; i++) {
+            while (notes[i].note->saving > 0) {
+                usleep(1000);
+                polled += notes_service_poll();
+            }
+        }
+        printf("   %d saves in %zu writes", frames, polled);
+    }
+    printf("\n");
+}
+
+/* Does the note's file hold exactly what was last saved? */
+static int check_file(const bench_note_t *b) {
+    char path[1024];
+    snprintf(path, sizeof(path), "./Notes/%s", b->note->filename);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    char expect_head[512];
+    int head = snprintf(expect_head, sizeof(expect_head), "Title: %s\nCreated: %s\n\n", b->note->title,
+                        b->note->created_at);
+    size_t want = (size_t)head + b->len;
+    char *data = malloc(want + 1);
+    size_t got = data ? fread(data, 1, want + 1, f) : 0;
+    fclose(f);
+    int ok = got == want && memcmp(data, expect_head, (size_t)head) == 0 && memcmp(data + head, b->text, b->len) == 0;
+    free(data);
+    return ok;
+}
+
+static void remove_tree(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+            remove(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+int main(int argc, char **argv) {
+    int frames = (argc > 1) ? atoi(argv[1]) : 600;
+    size_t note_kb = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 64;
+    if (frames < 1) frames = 1;
+    if (note_kb < 1) note_kb = 1;
+
+    char root[] = "/tmp/blackhand-notes-save-XXXXXX";
+    if (!mkdtemp(root) || chdir(root) != 0) return 1;
+    notes_service_init();
+
+    for (int i = 0; i < BENCH_NOTES; i++) {
+        bench_note_t *b = &notes[i];
+        b->len = note_kb * 1024;
+        b->text = malloc(b->len + 1);
+        if (!b->text) return 1;
+        for (size_t k = 0; k < b->len; k++) b->text[k] = (k % 64 == 63) ? '\n' : (char)('a' + k % 26);
+        b->text[b->len] = '\0';
+        char title[32];
+        snprintf(title, sizeof(title), "Bench note %d", i);
+        b->note = notes_service_create(title, b->text);
+        if (!b->note) return 1;
+    }
+
+    double *t = malloc((size_t)frames * sizeof(*t));
+    if (!t) return 1;
+    printf("%d frames, %d notes of %zu KB, a key every %d us\n", frames, BENCH_NOTES, note_kb, FRAME_GAP_US);
+    printf("%-12s %12s %12s %12s\n", "run", "median", "p99", "worst");
+    run(RUN_IDLE, "idle", frames, t);
+    run(RUN_ASYNC, "async", frames, t);
+
+    int ok = 1;
+    for (int i = 0; i < BENCH_NOTES; i++) ok &= notes[i].note->save_error == 0 && check_file(&notes[i]);
+    if (!ok) printf("async: a note file does not hold the last save\n");
+
+    run(RUN_SYNC_FOPEN, "sync fopen", frames, t);
+    run(RUN_SYNC_FSYNC, "sync fsync", frames, t);
+
+    notes_service_shutdown();
+    for (int i = 0; i < BENCH_NOTES; i++) free(notes[i].text);
+    free(t);
+    remove_tree("./Notes");
+    if (chdir("/") == 0) rmdir(root);
+    return ok ? 0 : 1;
+}
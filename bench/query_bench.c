@@ -0,0 +1,218 @@
+/*
+ * query_bench.c
+ *
+ * Smart playlist query timing over a synthetic library. Each query runs
+ * two ways: as the column scans in track_query.c, and as a loop over
+ * per-track structs comparing names with strcmp, which is what a query
+ * over AudioFile would do. The results have to agree. Also times
+ * re-testing single rows after a change, as happens when a play is counted.
+ *
+ *   ./build/blackhand-query-bench [tracks]   (default 100000)
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "services/track_query.h"
+
+#define BENCH_REPS 51
+#define BENCH_GENRES 24
+#define BENCH_AUTHORS 2000
+#define BENCH_UPDATES 10000
+#define BENCH_NOW 1790000000u
+
+typedef struct {
+    const char *genre;
+    const char *author;
+    uint32_t duration;
+    uint32_t plays;
+    uint32_t added;
+} bench_track_t;
+
+static char genre_names[BENCH_GENRES][16];
+static char author_names[BENCH_AUTHORS][24];
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static int resolve(track_column column, const char *name, void *ctx) {
+    (void)ctx;
+    if (column == TRACK_COL_GENRE) {
+        for (int i = 0; i < BENCH_GENRES; i++) {
+            if (strcmp(genre_names[i], name) == 0) return i;
+        }
+    } else {
+        for (int i = 0; i < BENCH_AUTHORS; i++) {
+            if (strcmp(author_names[i], name) == 0) return BENCH_GENRES + i;
+        }
+    }
+    return -1;
+}
+
+/* The same query, one struct and one strcmp at a time. */
+static int naive_match(const bench_track_t *t, const track_query_t *q) {
+    for (int c = 0; c < TRACK_COL_COUNT; c++) {
+        int used = 0;
+        int any = 0;
+        for (size_t i = 0; i < q->count; i++) {
+            const track_term_t *term = &q->terms[i];
+            if (term->column != (track_column)c) continue;
+            used = 1;
+            uint32_t v = 0;
+            switch (term->column) {
+                case TRACK_COL_GENRE:
+                    any |= term->lo < BENCH_GENRES && strcmp(t->genre, genre_names[term->lo]) == 0;
+                    continue;
+                case TRACK_COL_AUTHOR:
+                    any |= term->lo >= BENCH_GENRES && term->lo != TRACK_QUERY_NONE &&
+                           strcmp(t->author, author_names[term->lo - BENCH_GENRES]) == 0;
+                    continue;
+                case TRACK_COL_DURATION: v = t->duration; break;
+                case TRACK_COL_PLAYS: v = t->plays; break;
+                case TRACK_COL_ADDED: v = t->added; break;
+                default: break; /* Not filled in */
+            }
+            any |= v >= term->lo && v <= term->hi;
+        }
+        if (used && !any) return 0;
+    }
+    return 1;
+}
+
+static double median(double *v, int n) {
+    for (int i = 1; i < n; i++) {
+        double x = v[i];
+        int k = i - 1;
+        while (k >= 0 && v[k] > x) {
+            v[k + 1] = v[k];
+            k--;
+        }
+        v[k + 1] = x;
+    }
+    return v[n / 2];
+}
+
+static int write_query(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fputs(text, f);
+    return fclose(f);
+}
+
+int main(int argc, char **argv) {
+    size_t count = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 100000;
+    if (count == 0) count = 1;
+
+    for (int i = 0; i < BENCH_GENRES; i++) snprintf(genre_names[i], sizeof(genre_names[i]), "Genre %d", i);
+    for (int i = 0; i < BENCH_AUTHORS; i++) snprintf(author_names[i], sizeof(author_names[i]), "Artist %d", i);
+
+    bench_track_t *tracks = malloc(count * sizeof(*tracks));
+    track_table_t table;
+    memset(&table, 0, sizeof(table));
+    if (!tracks || track_table_resize(&table, count) != 0) return 1;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < count; i++) {
+        int author = (int)(next_random(&seed) % BENCH_AUTHORS);
+        int genre = author % BENCH_GENRES;
+        uint32_t plays = (uint32_t)(next_random(&seed) % 64);
+        tracks[i].genre = genre_names[genre];
+        tracks[i].author = author_names[author];
+        tracks[i].duration = 60 + (uint32_t)(next_random(&seed) % 540);
+        tracks[i].plays = plays < 40 ? 0 : plays - 40;
+        tracks[i].added = BENCH_NOW - (uint32_t)(next_random(&seed) % (730u * 86400u));
+        table.col[TRACK_COL_GENRE][i] = (uint32_t)genre;
+        table.col[TRACK_COL_AUTHOR][i] = (uint32_t)(BENCH_GENRES + author);
+        table.col[TRACK_COL_DURATION][i] = tracks[i].duration;
+        table.col[TRACK_COL_PLAYS][i] = tracks[i].plays;
+        table.col[TRACK_COL_ADDED][i] = tracks[i].added;
+        track_table_set_live(&table, i, 1);
+    }
+
+    static const char *queries[] = {
+        "genre Genre 3\ngenre Genre 7\nduration 180-300\n",
+        "plays 5-\n",
+        "added 30\nduration -240\n",
+        "author Artist 42\nauthor Artist 1999\n",
+    };
+    const char *path = "/tmp/blackhand-query-bench.query";
+    int all_ok = 1;
+    printf("%zu tracks\n", count);
+    printf("%-44s %8s %10s %10s\n", "query", "matches", "columns", "strcmp");
+
+    for (size_t qi = 0; qi < sizeof(queries) / sizeof(queries[0]); qi++) {
+        track_query_t q;
+        track_bitset_t hits;
+        memset(&hits, 0, sizeof(hits));
+        if (write_query(path, queries[qi]) != 0 || track_query_load(&q, path, resolve, NULL) != 0) return 1;
+        track_query_anchor(&q, BENCH_NOW);
+
+        double scan[BENCH_REPS];
+        double naive[BENCH_REPS];
+        size_t naive_matches = 0;
+        int ok = 1;
+        for (int r = 0; r < BENCH_REPS; r++) {
+            double t0 = now_sec();
+            track_query_run(&q, &table, &hits);
+            scan[r] = (now_sec() - t0) * 1e3;
+
+            t0 = now_sec();
+            naive_matches = 0;
+            for (size_t i = 0; i < count; i++) {
+                int m = naive_match(&tracks[i], &q);
+                naive_matches += (size_t)m;
+                if (m != track_bitset_test(&hits, i)) ok = 0;
+            }
+            naive[r] = (now_sec() - t0) * 1e3;
+        }
+        if (naive_matches != hits.matches) ok = 0;
+        all_ok &= ok;
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s", queries[qi]);
+        for (char *c = label; *c; c++) {
+            if (*c == '\n') *c = ';';
+        }
+        printf("%-44s %8zu %8.2f ms %7.2f ms %s\n", label, hits.matches, median(scan, BENCH_REPS),
+               median(naive, BENCH_REPS), ok ? "" : "MISMATCH");
+
+        /* Count plays on random tracks, re-testing each row as the player does. */
+        if (qi == 1) {
+            double t0 = now_sec();
+            for (int u = 0; u < BENCH_UPDATES; u++) {
+                size_t row = (size_t)(next_random(&seed) % count);
+                table.col[TRACK_COL_PLAYS][row]++;
+                tracks[row].plays++;
+                track_query_update(&q, &table, &hits, row);
+            }
+            double per_us = (now_sec() - t0) * 1e6 / BENCH_UPDATES;
+            track_bitset_t fresh;
+            memset(&fresh, 0, sizeof(fresh));
+            track_query_run(&q, &table, &fresh);
+            int same = fresh.matches == hits.matches &&
+                       memcmp(fresh.words, hits.words, (count + 63) / 64 * sizeof(uint64_t)) == 0;
+            all_ok &= same;
+            printf("%-44s %8zu %8.3f us %s\n", "  single-row update (plays)", hits.matches, per_us,
+                   same ? "" : "MISMATCH");
+            track_bitset_free(&fresh);
+        }
+        track_bitset_free(&hits);
+        track_query_free(&q);
+    }
+
+    remove(path);
+    track_table_free(&table);
+    free(tracks);
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/*
+ * queue_bench.c
+ *
+ * Save and restore timing for the play queue file. Builds a shuffled
+ * queue over a synthetic library, saves it, and restores it the way the
+ * player does at startup: once with the library unchanged, and once after
+ * a rescan shifted every index and dropped some tracks, so every id has
+ * to be looked up. Restores are checked against the saved order.
+ *
+ *   ./build/blackhand-queue-bench [tracks] [file]   (default 10000, /tmp)
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "services/play_queue.h"
+
+#define BENCH_REPS 200
+#define BENCH_DROP_EVERY 50 /* Tracks removed by the simulated rescan */
+
+typedef struct {
+    const uint64_t *ids; /* By library index */
+    size_t count;
+    uint32_t *slots;     /* Id table as in mp3_service: index + 1, 0 empty */
+    size_t mask;
+} bench_library_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t id_of(uint32_t index, void *ctx) {
+    return ((const bench_library_t *)ctx)->ids[index];
+}
+
+/* Same lookup as mp3_service: trust the hint, else the id table. */
+static int find(uint64_t id, uint32_t hint, void *ctx) {
+    const bench_library_t *lib = ctx;
+    if (hint < lib->count && lib->ids[hint] == id) return (int)hint;
+    size_t s = (size_t)(id ^ (id >> 32)) & lib->mask;
+    while (lib->slots[s]) {
+        uint32_t index = lib->slots[s] - 1;
+        if (lib->ids[index] == id) return (int)index;
+        s = (s + 1) & lib->mask;
+    }
+    return -1;
+}
+
+static int build_library(bench_library_t *lib, const uint64_t *ids, size_t count) {
+    size_t slots = 16;
+    while (slots < count * 2) slots *= 2;
+    lib->ids = ids;
+    lib->count = count;
+    lib->slots = calloc(slots, sizeof(*lib->slots));
+    lib->mask = slots - 1;
+    if (!lib->slots) return -1;
+    for (size_t i = 0; i < count; i++) {
+        size_t s = (size_t)(ids[i] ^ (ids[i] >> 32)) & lib->mask;
+        while (lib->slots[s]) s = (s + 1) & lib->mask;
+        lib->slots[s] = (uint32_t)i + 1;
+    }
+    return 0;
+}
+
+/* Median restore time in microseconds; 0 in *ok unless every restore matched. */
+static double time_restore(const char *path, bench_library_t *lib, const play_queue_t *saved,
+                           const uint64_t *saved_ids, int *ok) {
+    static double samples[BENCH_REPS];
+    *ok = 1;
+    for (int r = 0; r < BENCH_REPS; r++) {
+        play_queue_t q;
+        play_queue_init(&q);
+        double t0 = now_sec();
+        int loaded = play_queue_load(&q, path, find, lib);
+        samples[r] = (now_sec() - t0) * 1e6;
+
+        /* The survivors must play in the saved order. */
+        size_t j = 0;
+        for (size_t i = 0; loaded == 0 && i < saved->len && *ok; i++) {
+            uint64_t id = saved_ids[play_queue_at(saved, i)];
+            int index = find(id, UINT32_MAX, lib);
+            if (index < 0) continue;
+            if (j >= q.len || play_queue_at(&q, j) != index) *ok = 0;
+            j++;
+        }
+        if (loaded != 0 || j != q.len) *ok = 0;
+        play_queue_free(&q);
+    }
+
+    for (int i = 1; i < BENCH_REPS; i++) {
+        double v = samples[i];
+        int k = i - 1;
+        while (k >= 0 && samples[k] > v) {
+            samples[k + 1] = samples[k];
+            k--;
+        }
+        samples[k + 1] = v;
+    }
+    return samples[BENCH_REPS / 2];
+}
+
+int main(int argc, char **argv) {
+    size_t count = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 10000;
+    const char *path = (argc > 2) ? argv[2] : "/tmp/blackhand-queue-bench.bin";
+    if (count < 2) count = 2;
+
+    uint64_t *ids = malloc(count * sizeof(*ids));
+    uint32_t *list = malloc(count * sizeof(*list));
+    if (!ids || !list) return 1;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < count; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        ids[i] = seed;
+        list[i] = (uint32_t)i;
+    }
+
+    play_queue_t q;
+    play_queue_init(&q);
+    q.shuffle = 1;
+    q.repeat = PLAY_REPEAT_ALL;
+    if (play_queue_assign(&q, list, count, count / 3) != 0) return 1;
+    q.pos = count / 2;
+
+    bench_library_t lib;
+    if (build_library(&lib, ids, count) != 0) return 1;
+    double t0 = now_sec();
+    int saved = play_queue_save(&q, path, id_of, &lib);
+    double save_us = (now_sec() - t0) * 1e6;
+    if (saved != 0) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+
+    int ok_same = 0;
+    double same_us = time_restore(path, &lib, &q, ids, &ok_same);
+
+    /* Rescan: new files sort in front and some old ones are gone. */
+    size_t changed_count = 0;
+    uint64_t *changed = malloc((count + 16) * sizeof(*changed));
+    if (!changed) return 1;
+    for (int i = 0; i < 16; i++) changed[changed_count++] = 0xABCD0000ULL + (uint64_t)i;
+    for (size_t i = 0; i < count; i++) {
+        if (i % BENCH_DROP_EVERY != 0) changed[changed_count++] = ids[i];
+    }
+    bench_library_t rescanned;
+    if (build_library(&rescanned, changed, changed_count) != 0) return 1;
+
+    int ok_changed = 0;
+    double changed_us = time_restore(path, &rescanned, &q, ids, &ok_changed);
+
+    printf("queue of %zu tracks, %zu bytes on disk\n", count, 20 + count * 16);
+    printf("%-20s %9.1f us\n", "save", save_us);
+    printf("%-20s %9.1f us %s\n", "restore unchanged", same_us, ok_same ? "" : "MISMATCH");
+    printf("%-20s %9.1f us %s\n", "restore rescanned", changed_us, ok_changed ? "" : "MISMATCH");
+
+    remove(path);
+    play_queue_free(&q);
+    free(rescanned.slots);
+    free(lib.slots);
+    free(changed);
+    free(list);
+    free(ids);
+    return (ok_same && ok_changed) ? 0 : 1;
+}
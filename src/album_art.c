@@ -0,0 +1,72 @@
+#include "album_art.h"
+
+#include <string.h>
+
+typedef struct {
+    uint64_t key;           /* 0 for an empty slot */
+    struct ncplane *plane;  /* NULL if the image did not decode */
+    unsigned rows, cols;
+    unsigned long used;
+} art_slot_t;
+
+static art_slot_t slots[ALBUM_ART_SLOTS];
+static unsigned long use_clock = 0;
+
+static struct ncplane *render_thumbnail(struct notcurses *nc, const char *path, unsigned rows, unsigned cols) {
+    struct ncvisual *ncv = ncvisual_from_file(path);
+    if (!ncv) return NULL;
+
+    ncplane_options nopts = {
+        .rows = rows,
+        .cols = cols,
+        .name = "album-art",
+    };
+    struct ncplane *plane = ncpile_create(nc, &nopts);
+    if (plane) {
+        struct ncvisual_options vopts = {
+            .n = plane,
+            .scaling = NCSCALE_SCALE,
+            .blitter = NCBLIT_2x2,
+        };
+        if (!ncvisual_blit(nc, ncv, &vopts)) {
+            ncplane_destroy(plane);
+            plane = NULL;
+        }
+    }
+    ncvisual_destroy(ncv);
+    return plane;
+}
+
+static art_slot_t *lookup(struct notcurses *nc, uint64_t key, const char *path, unsigned rows, unsigned cols) {
+    art_slot_t *victim = &slots[0];
+    for (int i = 0; i < ALBUM_ART_SLOTS; i++) {
+        art_slot_t *s = &slots[i];
+        if (s->key == key && s->rows == rows && s->cols == cols) return s;
+        if (s->used < victim->used) victim = s;
+    }
+
+    if (victim->plane) ncplane_destroy(victim->plane);
+    victim->key = key;
+    victim->rows = rows;
+    victim->cols = cols;
+    victim->plane = render_thumbnail(nc, path, rows, cols);
+    return victim;
+}
+
+int album_art_draw(struct ncplane *dst, uint64_t key, const char *path, int y, int x, unsigned rows,
+                   unsigned cols) {
+    if (key == 0 || rows == 0 || cols == 0) return -1;
+
+    art_slot_t *s = lookup(ncplane_notcurses(dst), key, path, rows, cols);
+    s->used = ++use_clock;
+    if (!s->plane) return -1;
+    return ncplane_mergedown(s->plane, dst, 0, 0, rows, cols, y, x);
+}
+
+void album_art_shutdown(void) {
+    for (int i = 0; i < ALBUM_ART_SLOTS; i++) {
+        if (slots[i].plane) ncplane_destroy(slots[i].plane);
+    }
+    memset(slots, 0, sizeof(slots));
+    use_clock = 0;
+}
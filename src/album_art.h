@@ -0,0 +1,31 @@
+#ifndef ALBUM_ART_H
+#define ALBUM_ART_H
+
+#include <stdint.h>
+#include <notcurses/notcurses.h>
+
+/*
+ * album_art.h
+ *
+ * Cover thumbnails for the music player. An image is decoded with
+ * ncvisual, scaled once to the thumbnail size and blitted with the
+ * quadrant blitter (half blocks where the terminal lacks quadrants) into
+ * a plane of its own pile, which is never rendered. Drawing a thumbnail
+ * merges that plane's cells onto the screen, so a track change only costs
+ * a decode the first time its image is seen.
+ *
+ * Planes are keyed by a hash of the image bytes and the least recently
+ * drawn one is dropped past ALBUM_ART_SLOTS. Images that fail to decode
+ * are remembered too, so they are not retried every frame.
+ */
+
+#define ALBUM_ART_SLOTS 8
+
+/* Draw the image at path, rows x cols cells at y, x on dst. -1 if it can't be shown. */
+int album_art_draw(struct ncplane *dst, uint64_t key, const char *path, int y, int x, unsigned rows,
+                   unsigned cols);
+
+/* Destroys the cached planes; call before notcurses_stop(). */
+void album_art_shutdown(void);
+
+#endif
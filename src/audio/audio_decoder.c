@@ -0,0 +1,65 @@
+#include "audio_decoder.h"
+
+#include <string.h>
+#include <strings.h>
+
+#define MAX_BACKENDS 8
+
+static const audio_decoder_backend *backends[MAX_BACKENDS] = {
+    &audio_decoder_mpg123,
+    &audio_decoder_wav,
+};
+static size_t backend_count = 2;
+
+int audio_decoder_register(const audio_decoder_backend *backend) {
+    if (!backend || backend_count == MAX_BACKENDS) return -1;
+    backends[backend_count++] = backend;
+    return 0;
+}
+
+const audio_decoder_backend *audio_decoder_find(const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *ext = strrchr(slash ? slash : path, '.');
+    if (!ext) return NULL;
+    for (size_t b = 0; b < backend_count; b++) {
+        for (const char *const *e = backends[b]->extensions; *e; e++) {
+            if (strcasecmp(ext, *e) == 0) return backends[b];
+        }
+    }
+    return NULL;
+}
+
+int audio_decoder_open(audio_decoder_t *d, const char *path) {
+    memset(d, 0, sizeof(*d));
+    const audio_decoder_backend *backend = audio_decoder_find(path);
+    if (!backend) return -1;
+    d->backend = backend;
+    if (backend->open(d, path) != 0) {
+        memset(d, 0, sizeof(*d));
+        return -1;
+    }
+    return 0;
+}
+
+void audio_decoder_close(audio_decoder_t *d) {
+    if (d->backend) d->backend->close(d);
+    memset(d, 0, sizeof(*d));
+}
+
+int audio_decoder_read(audio_decoder_t *d, const unsigned char **pcm, size_t *bytes) {
+    *pcm = NULL;
+    *bytes = 0;
+    return d->backend ? d->backend->read(d, pcm, bytes) : AUDIO_DECODER_ERROR;
+}
+
+long long audio_decoder_seek(audio_decoder_t *d, long long frame) {
+    return (d->backend && frame >= 0) ? d->backend->seek(d, frame) : -1;
+}
+
+long long audio_decoder_tell(audio_decoder_t *d) {
+    return d->backend ? d->backend->tell(d) : -1;
+}
+
+long long audio_decoder_length(audio_decoder_t *d) {
+    return d->backend ? d->backend->length(d) : 0;
+}
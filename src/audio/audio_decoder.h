@@ -0,0 +1,76 @@
+#ifndef AUDIO_DECODER_H
+#define AUDIO_DECODER_H
+
+#include <stddef.h>
+
+/*
+ * audio_decoder.h
+ *
+ * Decoder backends behind one interface, picked by file extension. Every
+ * backend reads its file through a read-only mapping and produces
+ * interleaved signed 16-bit PCM, mono or stereo, at the file's own rate.
+ *
+ * A read hands back a pointer to the next block of PCM rather than filling
+ * a caller buffer: mpg123 points at the block it decoded into, and the WAV
+ * backend points straight into the mapping, so playing a WAV file costs
+ * no decoding and no copy. The block stays valid until the next call on
+ * the same decoder.
+ *
+ * Positions and lengths are in frames at the current rate.
+ */
+
+enum
+{
+	AUDIO_DECODER_OK = 0,
+	AUDIO_DECODER_DONE,		  /* Last block returned, or none left */
+	AUDIO_DECODER_NEW_FORMAT, /* Rate or channels changed; nothing returned */
+	AUDIO_DECODER_ERROR = -1
+};
+
+typedef struct audio_decoder_backend audio_decoder_backend;
+
+typedef struct
+{
+	const audio_decoder_backend *backend;
+	void *impl;
+	long rate;
+	int channels;
+} audio_decoder_t;
+
+struct audio_decoder_backend
+{
+	const char *name;
+	const char *const *extensions; /* With the dot, NULL-terminated; matched ignoring case */
+	int (*open)(audio_decoder_t *d, const char *path);
+	int (*read)(audio_decoder_t *d, const unsigned char **pcm, size_t *bytes);
+	long long (*seek)(audio_decoder_t *d, long long frame);
+	long long (*tell)(audio_decoder_t *d);
+	long long (*length)(audio_decoder_t *d); /* 0 if unknown */
+	void (*close)(audio_decoder_t *d);
+};
+
+extern const audio_decoder_backend audio_decoder_mpg123;
+extern const audio_decoder_backend audio_decoder_wav;
+
+/* Add a backend, tried after the ones before it. Before any decoder is opened. */
+int audio_decoder_register(const audio_decoder_backend *backend);
+
+/* The backend for path by its extension, or NULL. */
+const audio_decoder_backend *audio_decoder_find(const char *path);
+
+/* On success d->rate and d->channels hold the first format. */
+int audio_decoder_open(audio_decoder_t *d, const char *path);
+void audio_decoder_close(audio_decoder_t *d);
+
+/* One block of PCM in *pcm; returns an AUDIO_DECODER_ status. */
+int audio_decoder_read(audio_decoder_t *d, const unsigned char **pcm, size_t *bytes);
+
+/* Returns the frame reached, or -1. */
+long long audio_decoder_seek(audio_decoder_t *d, long long frame);
+long long audio_decoder_tell(audio_decoder_t *d);
+long long audio_decoder_length(audio_decoder_t *d);
+
+/* The mpg123 handle for tags and the frame index; NULL for other backends. */
+struct mpg123_handle_struct *audio_decoder_mpg123_handle(const audio_decoder_t *d);
+
+#endif
@@ -0,0 +1,132 @@
+#include "audio_decoder.h"
+#include "audio_mmap.h"
+
+#include <mpg123.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Frame index entries per track. mpg123 doubles the step when it fills,
+ * so an hour-long file still lands within ~2 s of any seek target.
+ */
+#define FRAME_INDEX_SIZE 4096
+
+typedef struct {
+    mpg123_handle *mh;
+    audio_mmap_t src;
+    unsigned char *block;
+    size_t block_size;
+} mpg123_decoder_t;
+
+static const char *const extensions[] = { ".mp3", NULL };
+
+static void mpg123_decoder_close(audio_decoder_t *d) {
+    mpg123_decoder_t *m = d->impl;
+    if (!m) return;
+    if (m->mh) {
+        mpg123_close(m->mh);
+        mpg123_delete(m->mh);
+    }
+    audio_mmap_close(&m->src);
+    free(m->block);
+    free(m);
+    d->impl = NULL;
+}
+
+static int mpg123_decoder_open(audio_decoder_t *d, const char *path) {
+    mpg123_decoder_t *m = calloc(1, sizeof(*m));
+    if (!m) return -1;
+    d->impl = m;
+
+    int err = 0;
+    m->mh = mpg123_new(NULL, &err);
+    if (!m->mh) {
+        mpg123_decoder_close(d);
+        return -1;
+    }
+
+    /*
+     * MPG123_GAPLESS makes mpg123 read the LAME/Xing header and drop the
+     * encoder delay and padding, so decoded tracks butt together exactly.
+     * Pinning the output to 16-bit is what the resampler consumes.
+     */
+    mpg123_param(m->mh, MPG123_ADD_FLAGS, MPG123_GAPLESS | MPG123_PICTURE, 0.0);
+    mpg123_param(m->mh, MPG123_INDEX_SIZE, FRAME_INDEX_SIZE, 0.0);
+    const long *rates = NULL;
+    size_t rate_count = 0;
+    mpg123_rates(&rates, &rate_count);
+    mpg123_format_none(m->mh);
+    for (size_t i = 0; i < rate_count; i++) {
+        mpg123_format(m->mh, rates[i], MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
+    }
+
+    /*
+     * Decode straight out of a read-only mapping instead of mpg123's own
+     * buffered file reads, so a slow card costs page faults the kernel is
+     * already reading ahead for rather than a read() per frame.
+     */
+    int encoding = 0;
+    if (audio_mmap_open(&m->src, path) != 0 ||
+        mpg123_replace_reader_handle(m->mh, audio_mmap_read, audio_mmap_seek, NULL) != MPG123_OK ||
+        mpg123_open_handle(m->mh, &m->src) != MPG123_OK ||
+        mpg123_getformat(m->mh, &d->rate, &d->channels, &encoding) != MPG123_OK) {
+        mpg123_decoder_close(d);
+        return -1;
+    }
+
+    m->block_size = mpg123_outblock(m->mh);
+    m->block = m->block_size ? malloc(m->block_size) : NULL;
+    if (!m->block) {
+        mpg123_decoder_close(d);
+        return -1;
+    }
+    return 0;
+}
+
+static int mpg123_decoder_read(audio_decoder_t *d, const unsigned char **pcm, size_t *bytes) {
+    mpg123_decoder_t *m = d->impl;
+    size_t done = 0;
+    int r = mpg123_read(m->mh, m->block, m->block_size, &done);
+    if (r == MPG123_NEW_FORMAT) {
+        int encoding = 0;
+        if (mpg123_getformat(m->mh, &d->rate, &d->channels, &encoding) != MPG123_OK) return AUDIO_DECODER_ERROR;
+        return AUDIO_DECODER_NEW_FORMAT;
+    }
+    if (r != MPG123_OK && r != MPG123_DONE) return AUDIO_DECODER_ERROR;
+    *pcm = m->block;
+    *bytes = done;
+    return r == MPG123_DONE ? AUDIO_DECODER_DONE : AUDIO_DECODER_OK;
+}
+
+static long long mpg123_decoder_seek(audio_decoder_t *d, long long frame) {
+    mpg123_decoder_t *m = d->impl;
+    off_t pos = mpg123_seek(m->mh, (off_t)frame, SEEK_SET);
+    return pos < 0 ? -1 : (long long)pos;
+}
+
+static long long mpg123_decoder_tell(audio_decoder_t *d) {
+    mpg123_decoder_t *m = d->impl;
+    return (long long)mpg123_tell(m->mh);
+}
+
+static long long mpg123_decoder_length(audio_decoder_t *d) {
+    mpg123_decoder_t *m = d->impl;
+    off_t length = mpg123_length(m->mh);
+    return length > 0 ? (long long)length : 0;
+}
+
+mpg123_handle *audio_decoder_mpg123_handle(const audio_decoder_t *d) {
+    if (d->backend != &audio_decoder_mpg123 || !d->impl) return NULL;
+    return ((mpg123_decoder_t *)d->impl)->mh;
+}
+
+const audio_decoder_backend audio_decoder_mpg123 = {
+    .name = "mpg123",
+    .extensions = extensions,
+    .open = mpg123_decoder_open,
+    .read = mpg123_decoder_read,
+    .seek = mpg123_decoder_seek,
+    .tell = mpg123_decoder_tell,
+    .length = mpg123_decoder_length,
+    .close = mpg123_decoder_close,
+};
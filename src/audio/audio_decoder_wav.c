@@ -0,0 +1,107 @@
+#include "audio_decoder.h"
+#include "audio_mmap.h"
+#include "audio_wav.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Frames per read: the player checks for seeks and stops between reads. */
+#define WAV_BLOCK_FRAMES 4096
+
+typedef struct {
+    audio_mmap_t src;
+    size_t data_offset;
+    uint64_t frames;
+    uint64_t pos;
+    size_t frame_bytes;
+    int16_t *copy; /* Only when samples cannot be used in place */
+} wav_decoder_t;
+
+static const char *const extensions[] = { ".wav", ".wave", NULL };
+
+static void wav_decoder_close(audio_decoder_t *d) {
+    wav_decoder_t *w = d->impl;
+    if (!w) return;
+    audio_mmap_close(&w->src);
+    free(w->copy);
+    free(w);
+    d->impl = NULL;
+}
+
+static int wav_decoder_open(audio_decoder_t *d, const char *path) {
+    wav_decoder_t *w = calloc(1, sizeof(*w));
+    if (!w) return -1;
+    d->impl = w;
+
+    uint64_t bytes = 0;
+    if (audio_mmap_open(&w->src, path) != 0 ||
+        audio_wav_parse(w->src.data, w->src.size, &d->rate, &d->channels, &w->data_offset, &bytes) != 0) {
+        wav_decoder_close(d);
+        return -1;
+    }
+    w->frame_bytes = (size_t)d->channels * sizeof(int16_t);
+    w->frames = bytes / w->frame_bytes;
+
+    /* In place needs little-endian samples at an int16_t-aligned address. */
+    int in_place = (w->data_offset % sizeof(int16_t)) == 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    in_place = 0;
+#endif
+    if (!in_place) {
+        w->copy = malloc(WAV_BLOCK_FRAMES * w->frame_bytes);
+        if (!w->copy) {
+            wav_decoder_close(d);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int wav_decoder_read(audio_decoder_t *d, const unsigned char **pcm, size_t *bytes) {
+    wav_decoder_t *w = d->impl;
+    uint64_t left = w->frames - w->pos;
+    size_t frames = left < WAV_BLOCK_FRAMES ? (size_t)left : WAV_BLOCK_FRAMES;
+    if (frames == 0) return AUDIO_DECODER_DONE;
+
+    size_t want = frames * w->frame_bytes;
+    audio_mmap_seek(&w->src, (off_t)(w->data_offset + w->pos * w->frame_bytes), SEEK_SET);
+    const unsigned char *p = audio_mmap_view(&w->src, &want);
+    if (!p || want < frames * w->frame_bytes) return AUDIO_DECODER_ERROR;
+    w->pos += frames;
+
+    if (w->copy) {
+        size_t samples = frames * (size_t)d->channels;
+        for (size_t i = 0; i < samples; i++) w->copy[i] = (int16_t)(uint16_t)(p[2 * i] | p[2 * i + 1] << 8);
+        p = (const unsigned char *)w->copy;
+    }
+    *pcm = p;
+    *bytes = want;
+    return w->pos == w->frames ? AUDIO_DECODER_DONE : AUDIO_DECODER_OK;
+}
+
+static long long wav_decoder_seek(audio_decoder_t *d, long long frame) {
+    wav_decoder_t *w = d->impl;
+    w->pos = (uint64_t)frame < w->frames ? (uint64_t)frame : w->frames;
+    return (long long)w->pos;
+}
+
+static long long wav_decoder_tell(audio_decoder_t *d) {
+    return (long long)((wav_decoder_t *)d->impl)->pos;
+}
+
+static long long wav_decoder_length(audio_decoder_t *d) {
+    return (long long)((wav_decoder_t *)d->impl)->frames;
+}
+
+const audio_decoder_backend audio_decoder_wav = {
+    .name = "wav",
+    .extensions = extensions,
+    .open = wav_decoder_open,
+    .read = wav_decoder_read,
+    .seek = wav_decoder_seek,
+    .tell = wav_decoder_tell,
+    .length = wav_decoder_length,
+    .close = wav_decoder_close,
+};
@@ -0,0 +1,207 @@
+#include "audio_eq.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_EQ_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_EQ_NEON 1
+#endif
+
+/* ISO octave centres. */
+const unsigned audio_eq_band_hz[AUDIO_EQ_BANDS] = {
+    31, 62, 125, 250, 500, 1000, 2000, 4000, 8000, 16000,
+};
+
+/* One octave wide, so neighbouring bands meet around -3 dB of each other. */
+#define BAND_Q 1.41
+
+/* Filter state this small is inaudible; zero it before it goes denormal. */
+#define STATE_FLOOR 1e-12
+
+static void design_band(audio_biquad_t *bq, long rate, unsigned hz, double gain_db) {
+    double a = pow(10.0, gain_db / 40.0);
+    double w0 = 2.0 * M_PI * (double)hz / (double)rate;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2.0 * BAND_Q);
+    double a0 = 1.0 + alpha / a;
+
+    bq->b0 = (1.0 + alpha * a) / a0;
+    bq->b1 = -2.0 * cw / a0;
+    bq->b2 = (1.0 - alpha * a) / a0;
+    bq->a1 = -2.0 * cw / a0;
+    bq->a2 = (1.0 - alpha / a) / a0;
+}
+
+static void design_chain(audio_eq_chain_t *c, long rate, const float *gains_db) {
+    double max_boost = 0.0;
+    c->flat = 1;
+    for (int k = 0; k < AUDIO_EQ_BANDS; k++) {
+        double g = gains_db[k];
+        if (g > AUDIO_EQ_MAX_DB) g = AUDIO_EQ_MAX_DB;
+        if (g < -AUDIO_EQ_MAX_DB) g = -AUDIO_EQ_MAX_DB;
+
+        /* Bands above Nyquist cannot be built; leave them out. */
+        c->on[k] = (fabs(g) >= 0.05 && 2 * (long)audio_eq_band_hz[k] < rate);
+        if (!c->on[k]) continue;
+        design_band(&c->band[k], rate, audio_eq_band_hz[k], g);
+        if (g > max_boost) max_boost = g;
+        c->flat = 0;
+    }
+    c->preamp = pow(10.0, -max_boost / 20.0);
+}
+
+void audio_eq_init(audio_eq_t *eq, long rate) {
+    memset(eq, 0, sizeof(*eq));
+    eq->rate = rate;
+    eq->cur.flat = 1;
+    eq->cur.preamp = 1.0;
+#if defined(AUDIO_EQ_SSE2) || defined(AUDIO_EQ_NEON)
+    eq->simd = 1;
+#endif
+}
+
+void audio_eq_set(audio_eq_t *eq, const float *gains_db) {
+    memcpy(eq->pending_db, gains_db, sizeof(eq->pending_db));
+    eq->pending = 1;
+}
+
+void audio_eq_reset(audio_eq_t *eq) {
+    if (eq->fading) {
+        eq->cur = eq->next;
+        eq->fading = 0;
+    }
+    memset(eq->cur.z, 0, sizeof(eq->cur.z));
+}
+
+int audio_eq_is_flat(const audio_eq_t *eq) {
+    return !eq->fading && !eq->pending && eq->cur.flat;
+}
+
+/* The new chain picks up the running filter history so it starts in tune. */
+static void start_fade(audio_eq_t *eq) {
+    eq->pending = 0;
+    design_chain(&eq->next, eq->rate, eq->pending_db);
+    if (eq->cur.flat && eq->next.flat) return;
+
+    memcpy(eq->next.z, eq->cur.z, sizeof(eq->next.z));
+    eq->fade_pos = 0;
+    eq->fading = 1;
+}
+
+static void finish_fade(audio_eq_t *eq) {
+    eq->cur = eq->next;
+    eq->fading = 0;
+    for (int k = 0; k < AUDIO_EQ_BANDS; k++) {
+        if (!eq->cur.on[k]) memset(eq->cur.z[k], 0, sizeof(eq->cur.z[k]));
+    }
+}
+
+/* One band over interleaved L/R doubles, in place. */
+static void run_band(const audio_biquad_t *bq, double z[2][2], double *buf, size_t frames, int simd) {
+#if defined(AUDIO_EQ_SSE2)
+    if (simd) {
+        const __m128d b0 = _mm_set1_pd(bq->b0), b1 = _mm_set1_pd(bq->b1), b2 = _mm_set1_pd(bq->b2);
+        const __m128d a1 = _mm_set1_pd(bq->a1), a2 = _mm_set1_pd(bq->a2);
+        __m128d z1 = _mm_loadu_pd(z[0]), z2 = _mm_loadu_pd(z[1]);
+        for (size_t i = 0; i < frames; i++) {
+            __m128d x = _mm_loadu_pd(buf + 2 * i);
+            __m128d y = _mm_add_pd(_mm_mul_pd(b0, x), z1);
+            z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), z2);
+            z2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+            _mm_storeu_pd(buf + 2 * i, y);
+        }
+        _mm_storeu_pd(z[0], z1);
+        _mm_storeu_pd(z[1], z2);
+        return;
+    }
+#elif defined(AUDIO_EQ_NEON)
+    if (simd) {
+        const float64x2_t b0 = vdupq_n_f64(bq->b0), b1 = vdupq_n_f64(bq->b1), b2 = vdupq_n_f64(bq->b2);
+        const float64x2_t a1 = vdupq_n_f64(bq->a1), a2 = vdupq_n_f64(bq->a2);
+        float64x2_t z1 = vld1q_f64(z[0]), z2 = vld1q_f64(z[1]);
+        for (size_t i = 0; i < frames; i++) {
+            float64x2_t x = vld1q_f64(buf + 2 * i);
+            float64x2_t y = vfmaq_f64(z1, b0, x);
+            z1 = vfmsq_f64(vfmaq_f64(z2, b1, x), a1, y);
+            z2 = vfmsq_f64(vmulq_f64(b2, x), a2, y);
+            vst1q_f64(buf + 2 * i, y);
+        }
+        vst1q_f64(z[0], z1);
+        vst1q_f64(z[1], z2);
+        return;
+    }
+#endif
+    for (int ch = 0; ch < 2; ch++) {
+        double z1 = z[0][ch], z2 = z[1][ch];
+        for (size_t i = 0; i < frames; i++) {
+            double x = buf[2 * i + ch];
+            double y = bq->b0 * x + z1;
+            z1 = bq->b1 * x - bq->a1 * y + z2;
+            z2 = bq->b2 * x - bq->a2 * y;
+            buf[2 * i + ch] = y;
+        }
+        z[0][ch] = z1;
+        z[1][ch] = z2;
+    }
+}
+
+static void run_chain(audio_eq_chain_t *c, double *buf, size_t frames, int simd) {
+    for (int k = 0; k < AUDIO_EQ_BANDS; k++) {
+        if (!c->on[k]) continue;
+        run_band(&c->band[k], c->z[k], buf, frames, simd);
+        for (int j = 0; j < 4; j++) {
+            double *s = &c->z[k][j / 2][j % 2];
+            if (fabs(*s) < STATE_FLOOR) *s = 0.0;
+        }
+    }
+}
+
+static int16_t to_s16(double v) {
+    long s = lrint(v);
+    if (s > INT16_MAX) return INT16_MAX;
+    if (s < INT16_MIN) return INT16_MIN;
+    return (int16_t)s;
+}
+
+void audio_eq_process(audio_eq_t *eq, const int16_t *in, int16_t *out, size_t frames) {
+    while (frames > 0) {
+        if (!eq->fading && eq->pending) start_fade(eq);
+        if (!eq->fading && eq->cur.flat) {
+            if (out != in) memmove(out, in, frames * 2 * sizeof(int16_t));
+            return;
+        }
+
+        size_t n = frames < AUDIO_EQ_BLOCK_FRAMES ? frames : AUDIO_EQ_BLOCK_FRAMES;
+        if (eq->fading && n > AUDIO_EQ_FADE_FRAMES - eq->fade_pos) n = AUDIO_EQ_FADE_FRAMES - eq->fade_pos;
+
+        double *cur = eq->buf[0];
+        double *next = eq->buf[1];
+        for (size_t i = 0; i < 2 * n; i++) cur[i] = in[i];
+        if (eq->fading) memcpy(next, cur, 2 * n * sizeof(double));
+
+        run_chain(&eq->cur, cur, n, eq->simd);
+        if (eq->fading) {
+            run_chain(&eq->next, next, n, eq->simd);
+            const double step = 1.0 / AUDIO_EQ_FADE_FRAMES;
+            for (size_t i = 0; i < n; i++) {
+                double t = (double)(eq->fade_pos + i + 1) * step;
+                double wc = (1.0 - t) * eq->cur.preamp;
+                double wn = t * eq->next.preamp;
+                out[2 * i] = to_s16(wc * cur[2 * i] + wn * next[2 * i]);
+                out[2 * i + 1] = to_s16(wc * cur[2 * i + 1] + wn * next[2 * i + 1]);
+            }
+            eq->fade_pos += n;
+            if (eq->fade_pos >= AUDIO_EQ_FADE_FRAMES) finish_fade(eq);
+        } else {
+            for (size_t i = 0; i < 2 * n; i++) out[i] = to_s16(cur[i] * eq->cur.preamp);
+        }
+
+        in += 2 * n;
+        out += 2 * n;
+        frames -= n;
+    }
+}
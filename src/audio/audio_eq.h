@@ -0,0 +1,73 @@
+#ifndef AUDIO_EQ_H
+#define AUDIO_EQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * audio_eq.h
+ *
+ * Ten-band graphic/parametric equalizer for interleaved stereo int16.
+ *
+ * Each band is an octave-wide peaking biquad (RBJ cookbook) at an ISO
+ * octave centre, cascaded in transposed direct form II; bands at 0 dB
+ * are skipped. Samples are widened to doubles kept in their interleaved
+ * L/R order, which is exactly the lane order of a two-lane double vector,
+ * so both channels run through each band together. The recursion is
+ * serial in time, so the channels are the only parallelism there is.
+ *
+ * New gains never switch coefficients mid-stream: a second chain starts
+ * from the running state with the new coefficients and the output is
+ * crossfaded to it over AUDIO_EQ_FADE_FRAMES. A preamp of minus the
+ * largest boost keeps boosted bands from clipping before the limiter.
+ */
+
+#define AUDIO_EQ_BANDS 10
+#define AUDIO_EQ_MAX_DB 12
+#define AUDIO_EQ_FADE_FRAMES 2048
+#define AUDIO_EQ_BLOCK_FRAMES 256
+
+extern const unsigned audio_eq_band_hz[AUDIO_EQ_BANDS];
+
+typedef struct
+{
+	double b0, b1, b2, a1, a2;
+} audio_biquad_t;
+
+typedef struct
+{
+	audio_biquad_t band[AUDIO_EQ_BANDS];
+	int on[AUDIO_EQ_BANDS];		/* 0 for bands at 0 dB, which are skipped */
+	double z[AUDIO_EQ_BANDS][2][2]; /* [band][z1, z2][channel] */
+	double preamp;
+	int flat;
+} audio_eq_chain_t;
+
+typedef struct
+{
+	long rate;
+	audio_eq_chain_t cur;
+	audio_eq_chain_t next; /* Fading in while fade_pos < AUDIO_EQ_FADE_FRAMES */
+	size_t fade_pos;
+	int fading;
+	int pending;
+	float pending_db[AUDIO_EQ_BANDS];
+	int simd; /* Use the vector path when the build has one */
+	double buf[2][AUDIO_EQ_BLOCK_FRAMES * 2];
+} audio_eq_t;
+
+void audio_eq_init(audio_eq_t *eq, long rate);
+
+/* Queue new band gains in dB; takes effect at the next process call. */
+void audio_eq_set(audio_eq_t *eq, const float *gains_db);
+
+/* Forget filter history, e.g. after a seek. Finishes any crossfade. */
+void audio_eq_reset(audio_eq_t *eq);
+
+/* 1 if the EQ currently leaves audio untouched. */
+int audio_eq_is_flat(const audio_eq_t *eq);
+
+/* in and out may be the same buffer. */
+void audio_eq_process(audio_eq_t *eq, const int16_t *in, int16_t *out, size_t frames);
+
+#endif
@@ -0,0 +1,170 @@
+#include "audio_fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#define AUDIO_FFT_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_FFT_NEON 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+int audio_fft_init(audio_fft_t *fft, size_t n) {
+    memset(fft, 0, sizeof(*fft));
+    if (n < 8 || (n & (n - 1)) != 0) return -1;
+
+    size_t half = n / 2;
+    fft->n = n;
+    fft->half = half;
+    fft->bitrev = malloc(half * sizeof(unsigned));
+    fft->tw_re = malloc(half * sizeof(float));
+    fft->tw_im = malloc(half * sizeof(float));
+    fft->post_re = malloc(half * sizeof(float));
+    fft->post_im = malloc(half * sizeof(float));
+    fft->work_re = malloc(half * sizeof(float));
+    fft->work_im = malloc(half * sizeof(float));
+    if (!fft->bitrev || !fft->tw_re || !fft->tw_im || !fft->post_re ||
+        !fft->post_im || !fft->work_re || !fft->work_im) {
+        audio_fft_free(fft);
+        return -1;
+    }
+
+    unsigned bits = 0;
+    while (((size_t)1 << bits) < half) bits++;
+    for (size_t i = 0; i < half; i++) {
+        unsigned r = 0;
+        for (unsigned b = 0; b < bits; b++) {
+            if (i & ((size_t)1 << b)) r |= 1u << (bits - 1 - b);
+        }
+        fft->bitrev[i] = r;
+    }
+
+    /* Stage with half-size h needs exp(-2*pi*i*j/(2h)) for j < h. */
+    fft->tw_re[0] = 1.0f;
+    fft->tw_im[0] = 0.0f;
+    for (size_t h = 1; h < half; h <<= 1) {
+        for (size_t j = 0; j < h; j++) {
+            double a = -M_PI * (double)j / (double)h;
+            fft->tw_re[h + j] = (float)cos(a);
+            fft->tw_im[h + j] = (float)sin(a);
+        }
+    }
+
+    for (size_t k = 0; k < half; k++) {
+        double a = -2.0 * M_PI * (double)k / (double)n;
+        fft->post_re[k] = (float)cos(a);
+        fft->post_im[k] = (float)sin(a);
+    }
+
+#if defined(AUDIO_FFT_SSE) || defined(AUDIO_FFT_NEON)
+    fft->simd = 1;
+#endif
+    return 0;
+}
+
+void audio_fft_free(audio_fft_t *fft) {
+    free(fft->bitrev);
+    free(fft->tw_re);
+    free(fft->tw_im);
+    free(fft->post_re);
+    free(fft->post_im);
+    free(fft->work_re);
+    free(fft->work_im);
+    memset(fft, 0, sizeof(*fft));
+}
+
+static void butterflies_scalar(float *re, float *im, const float *wr, const float *wi,
+                               size_t h, size_t j0) {
+    for (size_t j = j0; j < h; j++) {
+        float br = re[j + h], bi = im[j + h];
+        float tr = br * wr[j] - bi * wi[j];
+        float ti = br * wi[j] + bi * wr[j];
+        re[j + h] = re[j] - tr;
+        im[j + h] = im[j] - ti;
+        re[j] += tr;
+        im[j] += ti;
+    }
+}
+
+/* One group of h butterflies; re/im point at the group start. */
+static void butterflies(const audio_fft_t *fft, float *re, float *im, size_t h) {
+    const float *wr = fft->tw_re + h;
+    const float *wi = fft->tw_im + h;
+    size_t j = 0;
+
+    if (fft->simd) {
+#if defined(AUDIO_FFT_SSE)
+        for (; j + 4 <= h; j += 4) {
+            __m128 ar = _mm_loadu_ps(re + j), ai = _mm_loadu_ps(im + j);
+            __m128 br = _mm_loadu_ps(re + j + h), bi = _mm_loadu_ps(im + j + h);
+            __m128 cr = _mm_loadu_ps(wr + j), ci = _mm_loadu_ps(wi + j);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(br, cr), _mm_mul_ps(bi, ci));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(br, ci), _mm_mul_ps(bi, cr));
+            _mm_storeu_ps(re + j + h, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(im + j + h, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(re + j, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(im + j, _mm_add_ps(ai, ti));
+        }
+#elif defined(AUDIO_FFT_NEON)
+        for (; j + 4 <= h; j += 4) {
+            float32x4_t ar = vld1q_f32(re + j), ai = vld1q_f32(im + j);
+            float32x4_t br = vld1q_f32(re + j + h), bi = vld1q_f32(im + j + h);
+            float32x4_t cr = vld1q_f32(wr + j), ci = vld1q_f32(wi + j);
+            float32x4_t tr = vmlsq_f32(vmulq_f32(br, cr), bi, ci);
+            float32x4_t ti = vmlaq_f32(vmulq_f32(br, ci), bi, cr);
+            vst1q_f32(re + j + h, vsubq_f32(ar, tr));
+            vst1q_f32(im + j + h, vsubq_f32(ai, ti));
+            vst1q_f32(re + j, vaddq_f32(ar, tr));
+            vst1q_f32(im + j, vaddq_f32(ai, ti));
+        }
+#endif
+    }
+
+    butterflies_scalar(re, im, wr, wi, h, j);
+}
+
+void audio_fft_power(audio_fft_t *fft, const float *in, float *out_power) {
+    size_t half = fft->half;
+    float *re = fft->work_re;
+    float *im = fft->work_im;
+
+    /* Pack even/odd samples as one complex sequence, in bit-reversed order. */
+    for (size_t i = 0; i < half; i++) {
+        unsigned r = fft->bitrev[i];
+        re[r] = in[2 * i];
+        im[r] = in[2 * i + 1];
+    }
+
+    for (size_t h = 1; h < half; h <<= 1) {
+        for (size_t k = 0; k < half; k += 2 * h) {
+            butterflies(fft, re + k, im + k, h);
+        }
+    }
+
+    /*
+     * Split the packed transform Z into the real spectrum X:
+     *   X[k] = (Z[k] + conj(Z[m])) / 2 - i * w^k * (Z[k] - conj(Z[m])) / 2
+     * with m = half - k and w = exp(-2*pi*i/n).
+     */
+    out_power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    out_power[half] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (size_t k = 1; k < half; k++) {
+        size_t m = half - k;
+        float er = 0.5f * (re[k] + re[m]);
+        float ei = 0.5f * (im[k] - im[m]);
+        float orr = 0.5f * (im[k] + im[m]);
+        float oi = -0.5f * (re[k] - re[m]);
+        float wr = fft->post_re[k];
+        float wi = fft->post_im[k];
+        float xr = er + (orr * wr - oi * wi);
+        float xi = ei + (orr * wi + oi * wr);
+        out_power[k] = xr * xr + xi * xi;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef AUDIO_FFT_H
+#define AUDIO_FFT_H
+
+#include <stddef.h>
+
+/*
+ * audio_fft.h
+ *
+ * Radix-2 real FFT for analysis (not filtering). A real input of n points
+ * is packed into an n/2 point complex transform in split re/im arrays,
+ * which lets the butterflies run four at a time with SSE or NEON.
+ */
+
+typedef struct
+{
+	size_t n;		/* Real input length, power of two */
+	size_t half;	/* Complex transform length, n / 2 */
+	unsigned *bitrev;
+	float *tw_re;	/* Per-stage twiddles: stage h uses [h, 2h) */
+	float *tw_im;
+	float *post_re; /* exp(-2*pi*i*k/n) for the real split */
+	float *post_im;
+	float *work_re;
+	float *work_im;
+	int simd;		/* Use the vector butterflies when compiled in */
+} audio_fft_t;
+
+int audio_fft_init(audio_fft_t *fft, size_t n);
+void audio_fft_free(audio_fft_t *fft);
+
+/*
+ * Power spectrum |X[k]|^2 of n real samples for k = 0 .. n/2.
+ * out_power must hold n/2 + 1 floats. The input is not modified.
+ */
+void audio_fft_power(audio_fft_t *fft, const float *in, float *out_power);
+
+#endif
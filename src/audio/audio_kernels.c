@@ -0,0 +1,206 @@
+#include "audio_kernels.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_KERNELS_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_KERNELS_NEON 1
+#endif
+
+const char *audio_kernels_isa(void) {
+#if defined(AUDIO_KERNELS_SSE2)
+    return "sse2";
+#elif defined(AUDIO_KERNELS_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+uint64_t audio_sumsq_s16_scalar(const int16_t *x, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        int32_t s = x[i];
+        sum += (uint32_t)(s * s);
+    }
+    return sum;
+}
+
+uint64_t audio_sumsq_s16(const int16_t *x, size_t n) {
+    size_t i = 0;
+    uint64_t sum = 0;
+
+#if defined(AUDIO_KERNELS_SSE2)
+    /*
+     * pmaddwd squares and adds sample pairs into 32-bit lanes. Two full
+     * scale samples give exactly 2^31, which only fits unsigned, so lanes
+     * are zero-extended into 64-bit accumulators every step.
+     */
+    __m128i acc = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i sq = _mm_madd_epi16(v, v);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    sum = lanes[0] + lanes[1];
+#elif defined(AUDIO_KERNELS_NEON)
+    int64x2_t acc = vdupq_n_s64(0);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(x + i);
+        int32x4_t lo = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+        int32x4_t hi = vmull_s16(vget_high_s16(v), vget_high_s16(v));
+        acc = vpadalq_s32(acc, lo);
+        acc = vpadalq_s32(acc, hi);
+    }
+    sum = (uint64_t)(vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1));
+#endif
+
+    return sum + audio_sumsq_s16_scalar(x + i, n - i);
+}
+
+int32_t audio_dot_s16_scalar(const int16_t *a, const int16_t *b, size_t n) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += (int32_t)a[i] * b[i];
+    return sum;
+}
+
+int32_t audio_dot_s16(const int16_t *a, const int16_t *b, size_t n) {
+    size_t i = 0;
+    int32_t sum = 0;
+
+#if defined(AUDIO_KERNELS_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(acc);
+#elif defined(AUDIO_KERNELS_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t va = vld1q_s16(a + i);
+        int16x8_t vb = vld1q_s16(b + i);
+        acc = vmlal_s16(acc, vget_low_s16(va), vget_low_s16(vb));
+        acc = vmlal_s16(acc, vget_high_s16(va), vget_high_s16(vb));
+    }
+    sum = vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+#endif
+
+    return sum + audio_dot_s16_scalar(a + i, b + i, n - i);
+}
+
+/*
+ * Rational soft knee: linear up to the knee, then k * x / (x + k) on the
+ * excess, which is monotonic and never quite reaches full scale.
+ */
+static inline int16_t soft_limit(int32_t v) {
+    const int32_t knee = AUDIO_LIMIT_KNEE;
+    const int32_t room = INT16_MAX - knee;
+    int32_t a = v < 0 ? -v : v;
+    if (a <= knee) return (int16_t)v;
+    int32_t over = a - knee;
+    int32_t bent = knee + (int32_t)((int64_t)over * room / (over + room));
+    return (int16_t)(v < 0 ? -bent : bent);
+}
+
+void audio_gain_s16_scalar(const int16_t *in, int16_t *out, size_t n, int gain_q12) {
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = ((int32_t)in[i] * gain_q12 + (1 << 11)) >> 12;
+        out[i] = soft_limit(v);
+    }
+}
+
+void audio_gain_s16(const int16_t *in, int16_t *out, size_t n, int gain_q12) {
+    if (gain_q12 == AUDIO_GAIN_UNITY) {
+        if (in != out) memmove(out, in, n * sizeof(int16_t));
+        return;
+    }
+
+    size_t i = 0;
+
+#if defined(AUDIO_KERNELS_SSE2)
+    /*
+     * mullo/mulhi give the low and high halves of each 16x16 product;
+     * interleaving them rebuilds the 32-bit products. Blocks that stay
+     * under the knee pack straight back to int16, the rest go scalar.
+     */
+    const __m128i g = _mm_set1_epi16((int16_t)gain_q12);
+    const __m128i round = _mm_set1_epi32(1 << 11);
+    const __m128i knee = _mm_set1_epi32(AUDIO_LIMIT_KNEE);
+    const __m128i neg_knee = _mm_set1_epi32(-AUDIO_LIMIT_KNEE);
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i lo = _mm_mullo_epi16(x, g);
+        __m128i hi = _mm_mulhi_epi16(x, g);
+        __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 12);
+        __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 12);
+        __m128i over = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(p0, knee), _mm_cmplt_epi32(p0, neg_knee)),
+                                    _mm_or_si128(_mm_cmpgt_epi32(p1, knee), _mm_cmplt_epi32(p1, neg_knee)));
+        if (_mm_movemask_epi8(over) == 0) {
+            _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(p0, p1));
+        } else {
+            int32_t lanes[8];
+            _mm_storeu_si128((__m128i *)lanes, p0);
+            _mm_storeu_si128((__m128i *)(lanes + 4), p1);
+            for (int k = 0; k < 8; k++) out[i + (size_t)k] = soft_limit(lanes[k]);
+        }
+    }
+#elif defined(AUDIO_KERNELS_NEON)
+    const int16x4_t g = vdup_n_s16((int16_t)gain_q12);
+    const int32x4_t knee = vdupq_n_s32(AUDIO_LIMIT_KNEE);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        int32x4_t p0 = vrshrq_n_s32(vmull_s16(vget_low_s16(x), g), 12);
+        int32x4_t p1 = vrshrq_n_s32(vmull_s16(vget_high_s16(x), g), 12);
+        uint32x4_t over = vorrq_u32(vcgtq_s32(vabsq_s32(p0), knee), vcgtq_s32(vabsq_s32(p1), knee));
+        uint32x2_t folded = vorr_u32(vget_low_u32(over), vget_high_u32(over));
+        if (vget_lane_u64(vreinterpret_u64_u32(folded), 0) == 0) {
+            vst1q_s16(out + i, vcombine_s16(vmovn_s32(p0), vmovn_s32(p1)));
+        } else {
+            int32_t lanes[8];
+            vst1q_s32(lanes, p0);
+            vst1q_s32(lanes + 4, p1);
+            for (int k = 0; k < 8; k++) out[i + (size_t)k] = soft_limit(lanes[k]);
+        }
+    }
+#endif
+
+    audio_gain_s16_scalar(in + i, out + i, n - i, gain_q12);
+}
+
+void audio_mix_s16_scalar(int16_t *acc, const int16_t *in, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = (int32_t)acc[i] + in[i];
+        if (v > INT16_MAX) v = INT16_MAX;
+        if (v < INT16_MIN) v = INT16_MIN;
+        acc[i] = (int16_t)v;
+    }
+}
+
+void audio_mix_s16(int16_t *acc, const int16_t *in, size_t n) {
+    size_t i = 0;
+
+#if defined(AUDIO_KERNELS_SSE2)
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_adds_epi16(a, b));
+    }
+#elif defined(AUDIO_KERNELS_NEON)
+    for (; i + 8 <= n; i += 8) {
+        vst1q_s16(acc + i, vqaddq_s16(vld1q_s16(acc + i), vld1q_s16(in + i)));
+    }
+#endif
+
+    audio_mix_s16_scalar(acc + i, in + i, n - i);
+}
@@ -0,0 +1,44 @@
+#ifndef AUDIO_KERNELS_H
+#define AUDIO_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * audio_kernels.h
+ *
+ * Hot inner loops of the audio path. Each kernel has a portable scalar
+ * version and is vectorized with SSE2 or NEON when the compiler targets
+ * them; the plain name picks the best version built in.
+ */
+
+/* Name of the vector path compiled in ("sse2", "neon" or "scalar"). */
+const char *audio_kernels_isa(void);
+
+/* Sum of x[i]^2 over n interleaved int16 samples, exact in 64 bits. */
+uint64_t audio_sumsq_s16(const int16_t *x, size_t n);
+uint64_t audio_sumsq_s16_scalar(const int16_t *x, size_t n);
+
+/*
+ * Dot product of two int16 vectors in 32 bits. The caller keeps the
+ * result in range, e.g. with Q14 filter taps whose absolute sum is < 2.
+ */
+int32_t audio_dot_s16(const int16_t *a, const int16_t *b, size_t n);
+int32_t audio_dot_s16_scalar(const int16_t *a, const int16_t *b, size_t n);
+
+/*
+ * out = in * gain, gain in Q12 (AUDIO_GAIN_UNITY is 1.0, up to ~8x).
+ * Samples above AUDIO_LIMIT_KNEE are bent by a soft limiter that
+ * approaches full scale instead of clipping. in and out may alias.
+ */
+#define AUDIO_GAIN_UNITY 4096
+#define AUDIO_GAIN_MAX INT16_MAX
+#define AUDIO_LIMIT_KNEE 24576
+void audio_gain_s16(const int16_t *in, int16_t *out, size_t n, int gain_q12);
+void audio_gain_s16_scalar(const int16_t *in, int16_t *out, size_t n, int gain_q12);
+
+/* acc += in with int16 saturation, for summing mixer sources. */
+void audio_mix_s16(int16_t *acc, const int16_t *in, size_t n);
+void audio_mix_s16_scalar(int16_t *acc, const int16_t *in, size_t n);
+
+#endif
@@ -0,0 +1,239 @@
+#include "audio_loudness.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_LOUDNESS_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_LOUDNESS_NEON 1
+#endif
+
+/*
+ * BS.1770 pre-filter parameters, re-derived for any sample rate the same
+ * way libebur128 does, so 44.1 kHz sources are not measured with 48 kHz
+ * coefficients.
+ */
+static void design_k_weighting(audio_loudness_t *m) {
+    double fs = (double)m->rate;
+
+    double f0 = 1681.974450955533;
+    double gain_db = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / fs);
+    double vh = pow(10.0, gain_db / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m->shelf_b[0] = (vh + vb * k / q + k * k) / a0;
+    m->shelf_b[1] = 2.0 * (k * k - vh) / a0;
+    m->shelf_b[2] = (vh - vb * k / q + k * k) / a0;
+    m->shelf_a[0] = 1.0;
+    m->shelf_a[1] = 2.0 * (k * k - 1.0) / a0;
+    m->shelf_a[2] = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / fs);
+    a0 = 1.0 + k / q + k * k;
+    m->hp_b[0] = 1.0;
+    m->hp_b[1] = -2.0;
+    m->hp_b[2] = 1.0;
+    m->hp_a[0] = 1.0;
+    m->hp_a[1] = 2.0 * (k * k - 1.0) / a0;
+    m->hp_a[2] = (1.0 - k / q + k * k) / a0;
+}
+
+/* 4x interpolation filter, Hann-windowed sinc split into phases. */
+static void design_peak_filter(audio_loudness_t *m) {
+    const int n = AUDIO_LOUDNESS_OVERSAMPLE * AUDIO_LOUDNESS_PEAK_TAPS;
+    for (int p = 0; p < AUDIO_LOUDNESS_OVERSAMPLE; p++) {
+        for (int j = 0; j < AUDIO_LOUDNESS_PEAK_TAPS; j++) {
+            int i = j * AUDIO_LOUDNESS_OVERSAMPLE + p;
+            double t = ((double)i - (double)(n - 1) / 2.0) / AUDIO_LOUDNESS_OVERSAMPLE;
+            double sinc = (fabs(t) < 1e-9) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            double w = 0.5 - 0.5 * cos(2.0 * M_PI * ((double)i + 0.5) / (double)n);
+            m->peak_fir[p][j] = (float)(sinc * w);
+        }
+    }
+}
+
+int audio_loudness_init(audio_loudness_t *m, long rate, int channels) {
+    memset(m, 0, sizeof(*m));
+    if (rate <= 0 || channels < 1 || channels > 2) return -1;
+
+    m->rate = rate;
+    m->channels = channels;
+    m->step_len = (size_t)(rate / 10);
+    design_k_weighting(m);
+    design_peak_filter(m);
+
+    m->block_cap = 1024;
+    m->blocks = malloc(m->block_cap * sizeof(double));
+    return m->blocks ? 0 : -1;
+}
+
+void audio_loudness_free(audio_loudness_t *m) {
+    free(m->blocks);
+    memset(m, 0, sizeof(*m));
+}
+
+static int finish_step(audio_loudness_t *m) {
+    double step = m->step_energy;
+    m->step_energy = 0.0;
+    m->step_fill = 0;
+
+    if (m->recent_count == 3) {
+        double block = (m->recent[0] + m->recent[1] + m->recent[2] + step) / (4.0 * (double)m->step_len);
+        if (m->block_count == m->block_cap) {
+            double *grown = realloc(m->blocks, m->block_cap * 2 * sizeof(double));
+            if (!grown) return -1;
+            m->blocks = grown;
+            m->block_cap *= 2;
+        }
+        m->blocks[m->block_count++] = block;
+        m->recent[0] = m->recent[1];
+        m->recent[1] = m->recent[2];
+        m->recent[2] = step;
+    } else {
+        m->recent[m->recent_count++] = step;
+    }
+    return 0;
+}
+
+/* Update the true peak with one frame, oversampled. */
+static void track_peak(audio_loudness_t *m, const float *frame) {
+    for (int c = 0; c < m->channels; c++) {
+        float *h = m->peak_hist[c];
+        memmove(h, h + 1, (AUDIO_LOUDNESS_PEAK_TAPS - 1) * sizeof(float));
+        h[AUDIO_LOUDNESS_PEAK_TAPS - 1] = frame[c];
+
+        for (int p = 0; p < AUDIO_LOUDNESS_OVERSAMPLE; p++) {
+            const float *f = m->peak_fir[p];
+            float acc = 0.0f;
+            for (int j = 0; j < AUDIO_LOUDNESS_PEAK_TAPS; j++) acc += f[j] * h[j];
+            float a = fabsf(acc);
+            if (a > m->peak) m->peak = a;
+        }
+        float a = fabsf(frame[c]);
+        if (a > m->peak) m->peak = a;
+    }
+}
+
+int audio_loudness_add(audio_loudness_t *m, const int16_t *pcm, size_t frames) {
+    const double scale = 1.0 / 32768.0;
+
+#if defined(AUDIO_LOUDNESS_SSE2)
+    /* Lane 0 is the left (or only) channel, lane 1 the right. */
+    const __m128d sb0 = _mm_set1_pd(m->shelf_b[0]), sb1 = _mm_set1_pd(m->shelf_b[1]), sb2 = _mm_set1_pd(m->shelf_b[2]);
+    const __m128d sa1 = _mm_set1_pd(m->shelf_a[1]), sa2 = _mm_set1_pd(m->shelf_a[2]);
+    const __m128d hb0 = _mm_set1_pd(m->hp_b[0]), hb1 = _mm_set1_pd(m->hp_b[1]), hb2 = _mm_set1_pd(m->hp_b[2]);
+    const __m128d ha1 = _mm_set1_pd(m->hp_a[1]), ha2 = _mm_set1_pd(m->hp_a[2]);
+    __m128d s1 = _mm_loadu_pd(m->z[0]), s2 = _mm_loadu_pd(m->z[1]);
+    __m128d h1 = _mm_loadu_pd(m->z[2]), h2 = _mm_loadu_pd(m->z[3]);
+#elif defined(AUDIO_LOUDNESS_NEON)
+    const float64x2_t sb0 = vdupq_n_f64(m->shelf_b[0]), sb1 = vdupq_n_f64(m->shelf_b[1]), sb2 = vdupq_n_f64(m->shelf_b[2]);
+    const float64x2_t sa1 = vdupq_n_f64(m->shelf_a[1]), sa2 = vdupq_n_f64(m->shelf_a[2]);
+    const float64x2_t hb0 = vdupq_n_f64(m->hp_b[0]), hb1 = vdupq_n_f64(m->hp_b[1]), hb2 = vdupq_n_f64(m->hp_b[2]);
+    const float64x2_t ha1 = vdupq_n_f64(m->hp_a[1]), ha2 = vdupq_n_f64(m->hp_a[2]);
+    float64x2_t s1 = vld1q_f64(m->z[0]), s2 = vld1q_f64(m->z[1]);
+    float64x2_t h1 = vld1q_f64(m->z[2]), h2 = vld1q_f64(m->z[3]);
+#endif
+
+    for (size_t i = 0; i < frames; i++) {
+        double x[2];
+        float peak_in[2];
+        x[0] = pcm[i * (size_t)m->channels] * scale;
+        x[1] = (m->channels == 2) ? pcm[i * 2 + 1] * scale : 0.0;
+        peak_in[0] = (float)x[0];
+        peak_in[1] = (float)x[1];
+        track_peak(m, peak_in);
+
+        double y[2];
+#if defined(AUDIO_LOUDNESS_SSE2)
+        /* Transposed direct form II, both channels at once. */
+        __m128d v = _mm_loadu_pd(x);
+        __m128d t = _mm_add_pd(_mm_mul_pd(sb0, v), s1);
+        s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, v), _mm_mul_pd(sa1, t)), s2);
+        s2 = _mm_sub_pd(_mm_mul_pd(sb2, v), _mm_mul_pd(sa2, t));
+        __m128d o = _mm_add_pd(_mm_mul_pd(hb0, t), h1);
+        h1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, t), _mm_mul_pd(ha1, o)), h2);
+        h2 = _mm_sub_pd(_mm_mul_pd(hb2, t), _mm_mul_pd(ha2, o));
+        _mm_storeu_pd(y, _mm_mul_pd(o, o));
+#elif defined(AUDIO_LOUDNESS_NEON)
+        float64x2_t v = vld1q_f64(x);
+        float64x2_t t = vfmaq_f64(s1, sb0, v);
+        s1 = vaddq_f64(vfmsq_f64(vmulq_f64(sb1, v), sa1, t), s2);
+        s2 = vfmsq_f64(vmulq_f64(sb2, v), sa2, t);
+        float64x2_t o = vfmaq_f64(h1, hb0, t);
+        h1 = vaddq_f64(vfmsq_f64(vmulq_f64(hb1, t), ha1, o), h2);
+        h2 = vfmsq_f64(vmulq_f64(hb2, t), ha2, o);
+        vst1q_f64(y, vmulq_f64(o, o));
+#else
+        for (int c = 0; c < 2; c++) {
+            double t = m->shelf_b[0] * x[c] + m->z[0][c];
+            m->z[0][c] = m->shelf_b[1] * x[c] - m->shelf_a[1] * t + m->z[1][c];
+            m->z[1][c] = m->shelf_b[2] * x[c] - m->shelf_a[2] * t;
+            double o = m->hp_b[0] * t + m->z[2][c];
+            m->z[2][c] = m->hp_b[1] * t - m->hp_a[1] * o + m->z[3][c];
+            m->z[3][c] = m->hp_b[2] * t - m->hp_a[2] * o;
+            y[c] = o * o;
+        }
+#endif
+
+        /* Channel weights are 1.0 for left and right. */
+        m->step_energy += y[0] + y[1];
+        if (++m->step_fill == m->step_len && finish_step(m) != 0) return -1;
+    }
+
+#if defined(AUDIO_LOUDNESS_SSE2)
+    _mm_storeu_pd(m->z[0], s1);
+    _mm_storeu_pd(m->z[1], s2);
+    _mm_storeu_pd(m->z[2], h1);
+    _mm_storeu_pd(m->z[3], h2);
+#elif defined(AUDIO_LOUDNESS_NEON)
+    vst1q_f64(m->z[0], s1);
+    vst1q_f64(m->z[1], s2);
+    vst1q_f64(m->z[2], h1);
+    vst1q_f64(m->z[3], h2);
+#endif
+    return 0;
+}
+
+static double energy_to_lufs(double e) {
+    return -0.691 + 10.0 * log10(e);
+}
+
+double audio_loudness_integrated(const audio_loudness_t *m) {
+    /* Absolute gate */
+    const double abs_gate = pow(10.0, (AUDIO_LOUDNESS_SILENT + 0.691) / 10.0);
+    double sum = 0.0;
+    size_t n = 0;
+    for (size_t i = 0; i < m->block_count; i++) {
+        if (m->blocks[i] > abs_gate) {
+            sum += m->blocks[i];
+            n++;
+        }
+    }
+    if (n == 0) return AUDIO_LOUDNESS_SILENT;
+
+    /* Relative gate, 10 LU under the absolute-gated loudness */
+    double rel_gate = (sum / (double)n) * 0.1;
+    double gated = 0.0;
+    size_t kept = 0;
+    for (size_t i = 0; i < m->block_count; i++) {
+        if (m->blocks[i] > abs_gate && m->blocks[i] > rel_gate) {
+            gated += m->blocks[i];
+            kept++;
+        }
+    }
+    if (kept == 0) return AUDIO_LOUDNESS_SILENT;
+    return energy_to_lufs(gated / (double)kept);
+}
+
+double audio_loudness_true_peak_db(const audio_loudness_t *m) {
+    if (m->peak <= 0.0f) return -HUGE_VAL;
+    return 20.0 * log10((double)m->peak);
+}
@@ -0,0 +1,64 @@
+#ifndef AUDIO_LOUDNESS_H
+#define AUDIO_LOUDNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * audio_loudness.h
+ *
+ * EBU R128 / ITU-R BS.1770 loudness meter for offline analysis.
+ *
+ * Samples go through the K-weighting pre-filter (a high shelf and a
+ * high-pass biquad). Both channels run through the filter together, one
+ * per lane of a double vector. Energy is collected in 100 ms steps into
+ * 400 ms blocks, and integrated loudness applies the absolute (-70 LUFS)
+ * and relative (-10 LU) gates. True peak is the largest magnitude of the
+ * signal 4x oversampled.
+ */
+
+#define AUDIO_LOUDNESS_OVERSAMPLE 4
+#define AUDIO_LOUDNESS_PEAK_TAPS 12
+
+/* Returned for silence. */
+#define AUDIO_LOUDNESS_SILENT (-70.0)
+
+typedef struct
+{
+	long rate;
+	int channels; /* 1 or 2 */
+
+	/* K-weighting, two cascaded biquads; state per channel */
+	double shelf_b[3], shelf_a[3];
+	double hp_b[3], hp_a[3];
+	double z[4][2]; /* [shelf z1, shelf z2, hp z1, hp z2][channel] */
+
+	/* 100 ms steps; a block is the last four */
+	size_t step_len;
+	size_t step_fill;
+	double step_energy;
+	double recent[3];
+	size_t recent_count;
+	double *blocks; /* Mean square of each 400 ms block */
+	size_t block_count;
+	size_t block_cap;
+
+	/* True peak */
+	float peak_fir[AUDIO_LOUDNESS_OVERSAMPLE][AUDIO_LOUDNESS_PEAK_TAPS];
+	float peak_hist[2][AUDIO_LOUDNESS_PEAK_TAPS];
+	float peak;
+} audio_loudness_t;
+
+int audio_loudness_init(audio_loudness_t *m, long rate, int channels);
+void audio_loudness_free(audio_loudness_t *m);
+
+/* Interleaved int16 frames. */
+int audio_loudness_add(audio_loudness_t *m, const int16_t *pcm, size_t frames);
+
+/* Gated integrated loudness in LUFS, AUDIO_LOUDNESS_SILENT if nothing passed the gate. */
+double audio_loudness_integrated(const audio_loudness_t *m);
+
+/* True peak in dBTP (0 dB is full scale). */
+double audio_loudness_true_peak_db(const audio_loudness_t *m);
+
+#endif
@@ -0,0 +1,282 @@
+#include "audio_mixer.h"
+#include "audio_kernels.h"
+
+#include <mpg123.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PERIOD_MS (AUDIO_MIXER_PERIOD_FRAMES * 1000 / AUDIO_MIXER_RATE)
+#define RAMP_FRAMES 64
+#define IDLE_POLL_US 10000
+
+/* Who ducks whom: a memo turns the music down, a ringtone everything else. */
+static const unsigned source_ducks[AUDIO_SOURCE_COUNT] = {
+    [AUDIO_SOURCE_MUSIC] = 0,
+    [AUDIO_SOURCE_MEMO] = 1u << AUDIO_SOURCE_MUSIC,
+    [AUDIO_SOURCE_UI] = 0,
+    [AUDIO_SOURCE_RINGTONE] = (1u << AUDIO_SOURCE_MUSIC) | (1u << AUDIO_SOURCE_MEMO) | (1u << AUDIO_SOURCE_UI),
+};
+
+/* Consumer side: skip what the producer asked to drop. */
+static void skip_dropped(audio_mixer_source_t *s) {
+    size_t drop_to = atomic_load_explicit(&s->drop_to, memory_order_acquire);
+    size_t tail = atomic_load(&s->ring.tail);
+    ptrdiff_t behind = (ptrdiff_t)(drop_to - tail);
+    if (behind > 0) audio_ring_consume(&s->ring, (size_t)behind);
+}
+
+/* Copy up to frames of a source into out, across the ring wrap. */
+static size_t take_frames(audio_mixer_source_t *s, int16_t *out, size_t frames) {
+    size_t want = frames * AUDIO_MIXER_FRAME_BYTES;
+    size_t readable = audio_ring_readable(&s->ring);
+    if (want > readable) want = readable - readable % AUDIO_MIXER_FRAME_BYTES;
+
+    size_t done = 0;
+    while (done < want) {
+        size_t run = 0;
+        const unsigned char *p = audio_ring_peek(&s->ring, &run);
+        if (run > want - done) run = want - done;
+        memcpy((unsigned char *)out + done, p, run);
+        audio_ring_consume(&s->ring, run);
+        done += run;
+    }
+    return done / AUDIO_MIXER_FRAME_BYTES;
+}
+
+/*
+ * Copy up to frames of the source's clip. The clip stays marked in use
+ * from the period that picks it up until the one that finishes it, so
+ * its owner knows when it may free it.
+ */
+static size_t take_clip(audio_mixer_t *m, audio_mixer_source_t *s, int16_t *out, size_t frames) {
+    pthread_mutex_lock(&m->clip_lock);
+    if (s->clip_gen != s->clip_seen) {
+        s->clip_seen = s->clip_gen;
+        s->clip_playing = s->clip;
+        s->clip_pos = 0;
+    }
+    s->clip_in_use = s->clip_playing;
+    pthread_mutex_unlock(&m->clip_lock);
+
+    const audio_clip_t *clip = s->clip_playing;
+    if (!clip) return 0;
+
+    size_t done = 0;
+    while (done < frames && s->clip_pos < clip->frames) {
+        size_t run = clip->frames - s->clip_pos;
+        if (run > frames - done) run = frames - done;
+        memcpy(out + done * AUDIO_MIXER_CHANNELS, clip->pcm + s->clip_pos * AUDIO_MIXER_CHANNELS,
+               run * AUDIO_MIXER_FRAME_BYTES);
+        s->clip_pos += run;
+        done += run;
+        if (s->clip_pos == clip->frames && clip->loop) s->clip_pos = 0;
+    }
+
+    if (s->clip_pos == clip->frames) {
+        pthread_mutex_lock(&m->clip_lock);
+        if (s->clip_gen == s->clip_seen) s->clip = NULL;
+        s->clip_playing = NULL;
+        s->clip_in_use = NULL;
+        pthread_mutex_unlock(&m->clip_lock);
+    }
+    return done;
+}
+
+/* Gain ramps a quarter of the way to target per RAMP_FRAMES, like the player's. */
+static void apply_ramped(audio_mixer_source_t *s, int16_t *pcm, size_t frames, int target) {
+    for (size_t off = 0; off < frames; off += RAMP_FRAMES) {
+        if (s->gain != target) {
+            int step = (target - s->gain) / 4;
+            if (step == 0) step = (target > s->gain) ? 1 : -1;
+            s->gain += step;
+        }
+        size_t len = (frames - off < RAMP_FRAMES) ? frames - off : RAMP_FRAMES;
+        audio_gain_s16(pcm + off * AUDIO_MIXER_CHANNELS, pcm + off * AUDIO_MIXER_CHANNELS,
+                       len * AUDIO_MIXER_CHANNELS, s->gain);
+    }
+}
+
+/* Mix one period; returns 1 if any source had audio. */
+static int mix_period(audio_mixer_t *m) {
+    unsigned ducked = 0;
+    for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) {
+        if (m->src[i].quiet_ms < AUDIO_MIXER_DUCK_HOLD_MS) ducked |= m->src[i].ducks;
+    }
+
+    memset(m->mix, 0, sizeof(m->mix));
+    int heard = 0;
+    for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) {
+        audio_mixer_source_t *s = &m->src[i];
+        skip_dropped(s);
+
+        size_t frames = 0;
+        if (!atomic_load(&s->paused)) {
+            frames = take_clip(m, s, m->scratch, AUDIO_MIXER_PERIOD_FRAMES);
+            if (frames == 0) frames = take_frames(s, m->scratch, AUDIO_MIXER_PERIOD_FRAMES);
+        }
+        if (frames == 0) {
+            if (s->quiet_ms < AUDIO_MIXER_IDLE_MS) s->quiet_ms += PERIOD_MS;
+            continue;
+        }
+
+        long target = atomic_load(&s->gain_q12);
+        if (ducked & (1u << i)) target = target * AUDIO_MIXER_DUCK_Q12 / AUDIO_GAIN_UNITY;
+        if (s->gain < 0) s->gain = (int)target;
+        apply_ramped(s, m->scratch, frames, (int)target);
+        audio_mix_s16(m->mix, m->scratch, frames * AUDIO_MIXER_CHANNELS);
+        s->quiet_ms = 0;
+        heard = 1;
+    }
+    return heard;
+}
+
+static int any_pending(audio_mixer_t *m) {
+    for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) {
+        audio_mixer_source_t *s = &m->src[i];
+        skip_dropped(s);
+        if (atomic_load(&s->paused)) continue;
+        pthread_mutex_lock(&m->clip_lock);
+        int clip = (s->clip != NULL);
+        pthread_mutex_unlock(&m->clip_lock);
+        if (clip || audio_ring_readable(&s->ring) >= AUDIO_MIXER_FRAME_BYTES) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Mixer thread: writes a period at a time, silence included, so the
+ * stream stays continuous while anything is playing. The sink paces it.
+ */
+static void *mixer_thread_fn(void *arg) {
+    audio_mixer_t *m = arg;
+    unsigned idle_ms = AUDIO_MIXER_IDLE_MS; /* Nothing to play yet */
+    int paused = 0;
+
+    while (!atomic_load(&m->quit)) {
+        if (paused) {
+            if (!any_pending(m)) {
+                usleep(IDLE_POLL_US);
+                continue;
+            }
+            audio_sink_continue(&m->sink);
+            paused = 0;
+        }
+
+        if (mix_period(m)) {
+            idle_ms = 0;
+        } else if ((idle_ms += PERIOD_MS) >= AUDIO_MIXER_IDLE_MS) {
+            audio_sink_pause(&m->sink);
+            atomic_store(&m->sink_latency, 0);
+            paused = 1;
+            continue;
+        }
+
+        audio_sink_play(&m->sink, m->mix, sizeof(m->mix));
+        size_t latency = audio_sink_buffered(&m->sink) + m->device_buffer_bytes;
+        atomic_store(&m->sink_latency, latency);
+    }
+    return NULL;
+}
+
+int audio_mixer_open(audio_mixer_t *m, audio_sink_kind kind, const char *path, double device_buffer_sec) {
+    memset(m, 0, sizeof(*m));
+    pthread_mutex_init(&m->clip_lock, NULL);
+    for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) {
+        audio_mixer_source_t *s = &m->src[i];
+        if (audio_ring_init(&s->ring, AUDIO_MIXER_SOURCE_FRAMES * AUDIO_MIXER_FRAME_BYTES) != 0) {
+            for (int j = 0; j < i; j++) audio_ring_free(&m->src[j].ring);
+            return -1;
+        }
+        atomic_store(&s->gain_q12, AUDIO_GAIN_UNITY);
+        s->ducks = source_ducks[i];
+        s->gain = -1;
+        s->quiet_ms = AUDIO_MIXER_IDLE_MS;
+    }
+
+    if (audio_sink_open(&m->sink, kind, path, 1, device_buffer_sec) != 0 ||
+        audio_sink_start(&m->sink, AUDIO_MIXER_RATE, AUDIO_MIXER_CHANNELS, MPG123_ENC_SIGNED_16) != 0) {
+        audio_sink_close(&m->sink, 0);
+        for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) audio_ring_free(&m->src[i].ring);
+        return -1;
+    }
+    /* Paced sinks already count their whole lead in audio_sink_buffered(). */
+    if (kind == AUDIO_SINK_DEVICE) {
+        m->device_buffer_bytes = (size_t)(AUDIO_MIXER_RATE * device_buffer_sec) * AUDIO_MIXER_FRAME_BYTES;
+    }
+
+    atomic_store(&m->quit, 0);
+    if (pthread_create(&m->thread, NULL, mixer_thread_fn, m) != 0) {
+        audio_mixer_close(m);
+        return -1;
+    }
+    m->running = 1;
+    return 0;
+}
+
+void audio_mixer_close(audio_mixer_t *m) {
+    atomic_store(&m->quit, 1);
+    if (m->running) {
+        pthread_join(m->thread, NULL);
+        m->running = 0;
+    }
+    audio_sink_close(&m->sink, 1);
+    for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) audio_ring_free(&m->src[i].ring);
+    pthread_mutex_destroy(&m->clip_lock);
+}
+
+size_t audio_mixer_writable(audio_mixer_t *m, audio_source_id id) {
+    size_t bytes = audio_ring_writable(&m->src[id].ring);
+    return bytes - bytes % AUDIO_MIXER_FRAME_BYTES;
+}
+
+size_t audio_mixer_write(audio_mixer_t *m, audio_source_id id, const void *pcm, size_t bytes) {
+    size_t room = audio_mixer_writable(m, id);
+    if (bytes > room) bytes = room;
+    bytes -= bytes % AUDIO_MIXER_FRAME_BYTES;
+    return audio_ring_write(&m->src[id].ring, pcm, bytes);
+}
+
+size_t audio_mixer_queued(audio_mixer_t *m, audio_source_id id) {
+    audio_mixer_source_t *s = &m->src[id];
+    size_t head = atomic_load(&s->ring.head);
+    size_t tail = atomic_load(&s->ring.tail);
+    size_t drop_to = atomic_load(&s->drop_to);
+    if ((ptrdiff_t)(drop_to - tail) > 0) tail = drop_to;
+    return head - tail;
+}
+
+size_t audio_mixer_latency(audio_mixer_t *m, audio_source_id id) {
+    return audio_mixer_queued(m, id) + atomic_load(&m->sink_latency);
+}
+
+void audio_mixer_drop(audio_mixer_t *m, audio_source_id id) {
+    audio_mixer_source_t *s = &m->src[id];
+    atomic_store_explicit(&s->drop_to, atomic_load(&s->ring.head), memory_order_release);
+}
+
+void audio_mixer_pause(audio_mixer_t *m, audio_source_id id, int paused) {
+    atomic_store(&m->src[id].paused, paused ? 1 : 0);
+}
+
+void audio_mixer_play_clip(audio_mixer_t *m, audio_source_id id, const audio_clip_t *clip) {
+    pthread_mutex_lock(&m->clip_lock);
+    m->src[id].clip = clip;
+    m->src[id].clip_gen++;
+    pthread_mutex_unlock(&m->clip_lock);
+}
+
+int audio_mixer_clip_in_use(audio_mixer_t *m, const audio_clip_t *clip) {
+    int in_use = 0;
+    pthread_mutex_lock(&m->clip_lock);
+    for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) {
+        if (m->src[i].clip == clip || m->src[i].clip_in_use == clip) in_use = 1;
+    }
+    pthread_mutex_unlock(&m->clip_lock);
+    return in_use;
+}
+
+void audio_mixer_set_gain(audio_mixer_t *m, audio_source_id id, int gain_q12) {
+    if (gain_q12 < 0) gain_q12 = 0;
+    if (gain_q12 > AUDIO_GAIN_MAX) gain_q12 = AUDIO_GAIN_MAX;
+    atomic_store(&m->src[id].gain_q12, gain_q12);
+}
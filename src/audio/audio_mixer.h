@@ -0,0 +1,125 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include "audio_ring.h"
+#include "audio_sink.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * audio_mixer.h
+ *
+ * One output stream shared by everything that makes sound. The mixer
+ * opens the sink once, in a fixed format, and keeps it open; each source
+ * (music, memo playback, UI sounds, ringtone) feeds its own SPSC ring.
+ *
+ * The mixer thread pulls one period from every source that has audio,
+ * applies the source gain (ramped, with the soft limiter) and sums the
+ * sources with saturating adds. A source that ducks others (a memo over
+ * music, a ringtone over both) pulls their gain down to
+ * AUDIO_MIXER_DUCK_Q12 while it is heard and for DUCK_HOLD_MS after, so
+ * short gaps do not make the music pump. After IDLE_MS of silence the
+ * sink is paused, not closed.
+ *
+ * Producers never block in the mixer: they ask how much fits and write
+ * that much, so they can keep watching for their own stop and seek.
+ *
+ * A source can instead play a clip: PCM already in memory in the mixer
+ * format, read in place by the mixer thread. Starting one is a pointer
+ * store, with no producer thread, decode or copy in between.
+ */
+
+#define AUDIO_MIXER_RATE 44100
+#define AUDIO_MIXER_CHANNELS 2
+#define AUDIO_MIXER_FRAME_BYTES (AUDIO_MIXER_CHANNELS * (int)sizeof(int16_t))
+#define AUDIO_MIXER_PERIOD_FRAMES 1024
+#define AUDIO_MIXER_SOURCE_FRAMES 8192 /* Per-source ring, ~190 ms */
+#define AUDIO_MIXER_DUCK_Q12 820	   /* About -14 dB */
+#define AUDIO_MIXER_DUCK_HOLD_MS 300
+#define AUDIO_MIXER_IDLE_MS 2000
+
+typedef enum
+{
+	AUDIO_SOURCE_MUSIC = 0,
+	AUDIO_SOURCE_MEMO,
+	AUDIO_SOURCE_UI,
+	AUDIO_SOURCE_RINGTONE,
+	AUDIO_SOURCE_COUNT
+} audio_source_id;
+
+typedef struct
+{
+	const int16_t *pcm; /* Mixer format */
+	size_t frames;
+	int loop;
+} audio_clip_t;
+
+typedef struct
+{
+	audio_ring_t ring;
+	const audio_clip_t *clip;		 /* Requested clip, NULL for none; clip_lock */
+	unsigned clip_gen;				 /* Bumped per request; clip_lock */
+	const audio_clip_t *clip_in_use; /* What the mixer is reading; clip_lock */
+	atomic_size_t drop_to; /* Everything written before this is skipped */
+	atomic_int gain_q12;
+	atomic_int paused;
+	unsigned ducks; /* Mask of sources turned down while this one is heard */
+
+	/* Mixer thread only */
+	int gain;
+	unsigned quiet_ms; /* Since this source last had audio */
+	unsigned clip_seen;
+	const audio_clip_t *clip_playing;
+	size_t clip_pos;
+} audio_mixer_source_t;
+
+typedef struct
+{
+	audio_sink_t sink;
+	size_t device_buffer_bytes;
+	audio_mixer_source_t src[AUDIO_SOURCE_COUNT];
+	atomic_size_t sink_latency; /* Mixed bytes not yet heard */
+	pthread_mutex_t clip_lock;
+
+	pthread_t thread;
+	int running;
+	atomic_int quit;
+	int16_t mix[AUDIO_MIXER_PERIOD_FRAMES * AUDIO_MIXER_CHANNELS];
+	int16_t scratch[AUDIO_MIXER_PERIOD_FRAMES * AUDIO_MIXER_CHANNELS];
+} audio_mixer_t;
+
+/* path only applies to WAV; NULL and WAV sinks are paced to real time. */
+int audio_mixer_open(audio_mixer_t *m, audio_sink_kind kind, const char *path, double device_buffer_sec);
+void audio_mixer_close(audio_mixer_t *m);
+
+/* Producer side, one producer per source. Byte counts are whole frames. */
+size_t audio_mixer_writable(audio_mixer_t *m, audio_source_id id);
+size_t audio_mixer_write(audio_mixer_t *m, audio_source_id id, const void *pcm, size_t bytes);
+
+/* Bytes of this source written but not yet mixed. */
+size_t audio_mixer_queued(audio_mixer_t *m, audio_source_id id);
+
+/* Bytes of this source written but not yet heard. */
+size_t audio_mixer_latency(audio_mixer_t *m, audio_source_id id);
+
+/* Discard everything the source has written so far. */
+void audio_mixer_drop(audio_mixer_t *m, audio_source_id id);
+
+/* A paused source keeps its queued audio and resumes where it stopped. */
+void audio_mixer_pause(audio_mixer_t *m, audio_source_id id, int paused);
+
+/*
+ * Play a clip on a source from its start, replacing any clip there; NULL
+ * stops. The clip must stay valid until audio_mixer_clip_in_use() says
+ * the mixer has let go of it.
+ */
+void audio_mixer_play_clip(audio_mixer_t *m, audio_source_id id, const audio_clip_t *clip);
+int audio_mixer_clip_in_use(audio_mixer_t *m, const audio_clip_t *clip);
+
+/* Q12 gain up to AUDIO_GAIN_MAX, ramped by the mixer. */
+void audio_mixer_set_gain(audio_mixer_t *m, audio_source_id id, int gain_q12);
+
+#endif
@@ -0,0 +1,118 @@
+#include "audio_mmap.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* How far ahead of the cursor the kernel is asked to read. */
+#define READAHEAD_WINDOW (512u * 1024u)
+
+static void advise_ahead(audio_mmap_t *m) {
+    /* A seek may leave the cursor past the end, like lseek; nothing to read there. */
+    if (m->pos >= m->size || m->advised_to >= m->size || m->pos + READAHEAD_WINDOW / 2 < m->advised_to) return;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = m->pos & ~(page - 1);
+    size_t end = m->pos + READAHEAD_WINDOW;
+    if (end > m->size) end = m->size;
+    madvise(m->data + start, end - start, MADV_WILLNEED);
+    m->advised_to = end;
+}
+
+int audio_mmap_open(audio_mmap_t *m, const char *path) {
+    memset(m, 0, sizeof(*m));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* The mapping keeps the file alive */
+    if (data == MAP_FAILED) return -1;
+
+    m->data = data;
+    m->size = (size_t)st.st_size;
+    madvise(m->data, m->size, MADV_SEQUENTIAL);
+    advise_ahead(m);
+    return 0;
+}
+
+void audio_mmap_close(audio_mmap_t *m) {
+    if (m->data) munmap(m->data, m->size);
+    memset(m, 0, sizeof(*m));
+}
+
+ssize_t audio_mmap_read(void *handle, void *dst, size_t bytes) {
+    audio_mmap_t *m = handle;
+    if (m->pos >= m->size) return 0;
+
+    size_t left = m->size - m->pos;
+    if (bytes > left) bytes = left;
+    memcpy(dst, m->data + m->pos, bytes);
+    m->pos += bytes;
+    advise_ahead(m);
+    return (ssize_t)bytes;
+}
+
+const unsigned char *audio_mmap_view(audio_mmap_t *m, size_t *bytes) {
+    if (m->pos >= m->size) {
+        *bytes = 0;
+        return NULL;
+    }
+
+    size_t left = m->size - m->pos;
+    if (*bytes > left) *bytes = left;
+    const unsigned char *p = m->data + m->pos;
+    m->pos += *bytes;
+    advise_ahead(m);
+    return p;
+}
+
+off_t audio_mmap_seek(void *handle, off_t offset, int whence) {
+    audio_mmap_t *m = handle;
+    off_t base = 0;
+    if (whence == SEEK_CUR) base = (off_t)m->pos;
+    else if (whence == SEEK_END) base = (off_t)m->size;
+    else if (whence != SEEK_SET) return -1;
+
+    off_t target = base + offset;
+    if (target < 0) return -1;
+
+    /* A jump invalidates the window; restart readahead from the new cursor. */
+    if ((size_t)target != m->pos) {
+        m->pos = (size_t)target;
+        m->advised_to = 0;
+        advise_ahead(m);
+    }
+    return target;
+}
+
+size_t audio_mmap_warm(const char *path, size_t bytes, const atomic_int *cancel) {
+    audio_mmap_t m;
+    if (audio_mmap_open(&m, path) != 0) return 0;
+    if (bytes > m.size) bytes = m.size;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    volatile unsigned char sink = 0;
+    size_t done = 0;
+    for (; done < bytes; done += page) {
+        if (cancel && atomic_load_explicit(cancel, memory_order_relaxed)) break;
+        sink ^= m.data[done];
+    }
+    (void)sink;
+
+    audio_mmap_close(&m);
+    return done < bytes ? done : bytes;
+}
@@ -0,0 +1,44 @@
+#ifndef AUDIO_MMAP_H
+#define AUDIO_MMAP_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * audio_mmap.h
+ *
+ * Read-only memory mapping of a media file, with a cursor so it can stand
+ * in for a file descriptor behind a decoder's read/seek callbacks.
+ *
+ * Reads are memcpy from the mapping. The kernel is told the access is
+ * sequential and is asked to page in a window ahead of the cursor, so on
+ * slow storage the decoder rarely faults on a page that is not resident.
+ */
+
+typedef struct
+{
+	unsigned char *data;
+	size_t size;
+	size_t pos;
+	size_t advised_to; /* End of the last readahead window requested */
+} audio_mmap_t;
+
+int audio_mmap_open(audio_mmap_t *m, const char *path);
+void audio_mmap_close(audio_mmap_t *m);
+
+/* Decoder callbacks; handle is an audio_mmap_t. Same contract as read/lseek. */
+ssize_t audio_mmap_read(void *handle, void *dst, size_t bytes);
+off_t audio_mmap_seek(void *handle, off_t offset, int whence);
+
+/* Zero-copy read: the next *bytes at the cursor (fewer at the end), or NULL. */
+const unsigned char *audio_mmap_view(audio_mmap_t *m, size_t *bytes);
+
+/*
+ * Pull the first bytes of path into the page cache by touching every page.
+ * Blocking by design; run it off the audio threads. Gives up early when
+ * cancel becomes nonzero. Returns the bytes made resident.
+ */
+size_t audio_mmap_warm(const char *path, size_t bytes, const atomic_int *cancel);
+
+#endif
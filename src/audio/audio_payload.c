@@ -0,0 +1,176 @@
+#include "audio_payload.h"
+#include "audio_mmap.h"
+
+#include <string.h>
+
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3 1609587929392839161ULL
+#define PRIME4 9650029242287828579ULL
+#define PRIME5 2870177450012600261ULL
+
+#define ID3V1_BYTES 128
+#define APE_FOOTER_BYTES 32
+#define LYRICS3_TRAILER_BYTES 15 /* Six size digits and "LYRICS200" */
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t load64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t load32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t le32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    return rotl(acc, 31) * PRIME1;
+}
+
+static uint64_t merge64(uint64_t acc, uint64_t lane) {
+    acc ^= round64(0, lane);
+    return acc * PRIME1 + PRIME4;
+}
+
+/* ID3v2 header or footer size field: four 7-bit bytes. */
+static int syncsafe(const unsigned char *p, uint32_t *out) {
+    if ((p[0] | p[1] | p[2] | p[3]) & 0x80) return -1;
+    *out = (uint32_t)p[0] << 21 | (uint32_t)p[1] << 14 | (uint32_t)p[2] << 7 | p[3];
+    return 0;
+}
+
+/* Bytes of an ID3v2 tag starting at p ("ID3") or ending at p + 10 ("3DI"), or 0. */
+static size_t id3v2_bytes(const unsigned char *p, const char *magic) {
+    uint32_t size;
+    if (memcmp(p, magic, 3) != 0 || p[3] == 0xFF || p[4] == 0xFF || syncsafe(p + 6, &size) != 0) return 0;
+    int footer = magic[0] == '3' || (p[5] & 0x10);
+    return 10 + (size_t)size + (footer ? 10 : 0);
+}
+
+/* Bytes of one tag ending at data + end, or 0. */
+static size_t trailing_tag(const unsigned char *data, size_t start, size_t end) {
+    size_t avail = end - start;
+    if (avail >= ID3V1_BYTES && memcmp(data + end - ID3V1_BYTES, "TAG", 3) == 0) return ID3V1_BYTES;
+    if (avail >= APE_FOOTER_BYTES && memcmp(data + end - APE_FOOTER_BYTES, "APETAGEX", 8) == 0) {
+        const unsigned char *footer = data + end - APE_FOOTER_BYTES;
+        size_t bytes = le32(footer + 12) + ((le32(footer + 20) & 0x80000000u) ? APE_FOOTER_BYTES : 0);
+        return bytes >= APE_FOOTER_BYTES && bytes <= avail ? bytes : 0;
+    }
+    if (avail >= LYRICS3_TRAILER_BYTES && memcmp(data + end - 9, "LYRICS200", 9) == 0) {
+        size_t bytes = 0;
+        for (const unsigned char *d = data + end - LYRICS3_TRAILER_BYTES; d < data + end - 9; d++) {
+            if (*d < '0' || *d > '9') return 0;
+            bytes = bytes * 10 + (size_t)(*d - '0');
+        }
+        bytes += LYRICS3_TRAILER_BYTES;
+        return bytes <= avail ? bytes : 0;
+    }
+    if (avail >= 10) {
+        size_t bytes = id3v2_bytes(data + end - 10, "3DI");
+        return bytes <= avail ? bytes : 0;
+    }
+    return 0;
+}
+
+void audio_payload_bounds(const unsigned char *data, size_t size, size_t *start, size_t *end) {
+    size_t s = 0;
+    size_t e = size;
+    while (e - s >= 10) {
+        size_t bytes = id3v2_bytes(data + s, "ID3");
+        if (bytes == 0 || bytes > e - s) break;
+        s += bytes;
+    }
+    for (size_t bytes; e > s && (bytes = trailing_tag(data, s, e)) != 0;) e -= bytes;
+    *start = s;
+    *end = e;
+}
+
+void audio_hash_init(audio_hash_t *h) {
+    h->lane[0] = PRIME1 + PRIME2;
+    h->lane[1] = PRIME2;
+    h->lane[2] = 0;
+    h->lane[3] = 0 - PRIME1;
+    h->total = 0;
+}
+
+void audio_hash_update(audio_hash_t *h, const unsigned char *data, size_t bytes) {
+    uint64_t v0 = h->lane[0], v1 = h->lane[1], v2 = h->lane[2], v3 = h->lane[3];
+    for (size_t i = 0; i + AUDIO_PAYLOAD_STRIPE <= bytes; i += AUDIO_PAYLOAD_STRIPE) {
+        v0 = round64(v0, load64(data + i));
+        v1 = round64(v1, load64(data + i + 8));
+        v2 = round64(v2, load64(data + i + 16));
+        v3 = round64(v3, load64(data + i + 24));
+    }
+    h->lane[0] = v0;
+    h->lane[1] = v1;
+    h->lane[2] = v2;
+    h->lane[3] = v3;
+    h->total += bytes - bytes % AUDIO_PAYLOAD_STRIPE;
+}
+
+uint64_t audio_hash_final(audio_hash_t *h, const unsigned char *tail, size_t bytes) {
+    uint64_t acc;
+    if (h->total >= AUDIO_PAYLOAD_STRIPE) {
+        acc = rotl(h->lane[0], 1) + rotl(h->lane[1], 7) + rotl(h->lane[2], 12) + rotl(h->lane[3], 18);
+        for (int i = 0; i < 4; i++) acc = merge64(acc, h->lane[i]);
+    } else {
+        acc = h->lane[2] + PRIME5;
+    }
+    acc += h->total + bytes;
+
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) acc = rotl(acc ^ round64(0, load64(tail + i)), 27) * PRIME1 + PRIME4;
+    if (i + 4 <= bytes) {
+        acc = rotl(acc ^ (uint64_t)load32(tail + i) * PRIME1, 23) * PRIME2 + PRIME3;
+        i += 4;
+    }
+    for (; i < bytes; i++) acc = rotl(acc ^ tail[i] * PRIME5, 11) * PRIME1;
+
+    acc ^= acc >> 33;
+    acc *= PRIME2;
+    acc ^= acc >> 29;
+    acc *= PRIME3;
+    acc ^= acc >> 32;
+    return acc ? acc : 1;
+}
+
+int audio_payload_hash(const char *path, size_t slice, void (*pace)(void *ctx), void *ctx,
+                       const atomic_int *cancel, uint64_t *out, uint64_t *payload) {
+    audio_mmap_t m;
+    if (audio_mmap_open(&m, path) != 0) return -1;
+
+    size_t start, end;
+    audio_payload_bounds(m.data, m.size, &start, &end);
+    slice -= slice % AUDIO_PAYLOAD_STRIPE;
+    if (slice == 0) slice = AUDIO_PAYLOAD_STRIPE;
+
+    audio_hash_t h;
+    audio_hash_init(&h);
+    size_t pos = start;
+    size_t body_end = end - (end - start) % AUDIO_PAYLOAD_STRIPE;
+    while (pos < body_end) {
+        if (cancel && atomic_load(cancel)) {
+            audio_mmap_close(&m);
+            return -1;
+        }
+        size_t bytes = body_end - pos < slice ? body_end - pos : slice;
+        audio_hash_update(&h, m.data + pos, bytes);
+        pos += bytes;
+        if (pace && pos < body_end) pace(ctx);
+    }
+    *out = audio_hash_final(&h, m.data + body_end, end - body_end);
+    if (payload) *payload = end - start;
+    audio_mmap_close(&m);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef AUDIO_PAYLOAD_H
+#define AUDIO_PAYLOAD_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * audio_payload.h
+ *
+ * Content hash of a media file's audio, with the tag regions cut off, so
+ * two copies of a song hash the same after one of them was re-tagged.
+ *
+ * Tags skipped: ID3v2 at the front (several, with or without footer),
+ * and any stack of ID3v1, APEv2, Lyrics3v2 and appended ID3v2 at the end.
+ *
+ * The hash is XXH64-style: four 64-bit lanes over 32-byte stripes, about
+ * memory speed. It identifies files, it is not a defence against anyone
+ * building collisions. Values depend on byte order and are meant for a
+ * cache on the same device.
+ */
+
+#define AUDIO_PAYLOAD_STRIPE 32
+
+typedef struct
+{
+	uint64_t lane[4];
+	uint64_t total;
+} audio_hash_t;
+
+/* The byte range [*start, *end) of data holding no tags. */
+void audio_payload_bounds(const unsigned char *data, size_t size, size_t *start, size_t *end);
+
+void audio_hash_init(audio_hash_t *h);
+/* bytes must be a multiple of AUDIO_PAYLOAD_STRIPE; the rest goes to final. */
+void audio_hash_update(audio_hash_t *h, const unsigned char *data, size_t bytes);
+uint64_t audio_hash_final(audio_hash_t *h, const unsigned char *tail, size_t bytes);
+
+/*
+ * Hash the payload of path through a read-only mapping, slice bytes at a
+ * time; pace (if set) runs between slices and may sleep. Stops early when
+ * cancel becomes nonzero. Returns -1 on error or cancel, else 0 and the
+ * hash in *out (never 0) and the payload length in *payload, if set.
+ */
+int audio_payload_hash(const char *path, size_t slice, void (*pace)(void *ctx), void *ctx,
+                       const atomic_int *cancel, uint64_t *out, uint64_t *payload);
+
+#endif
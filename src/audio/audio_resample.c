@@ -0,0 +1,222 @@
+#include "audio_resample.h"
+#include "audio_kernels.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HALF_TAPS (AUDIO_RESAMPLE_TAPS / 2)
+
+/* Input frames buffered per channel between filter passes. */
+#define HIST_BLOCK 4096
+
+/* Passband edge as a fraction of the lower Nyquist, and window shape. */
+#define CUTOFF 0.95
+#define KAISER_BETA 7.0
+
+static long gcd_long(long a, long b) {
+    while (b != 0) {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+/*
+ * Phase p evaluates the continuous filter at input time pos + p/up, so tap
+ * j (input pos - HALF_TAPS + 1 + j) sits at distance HALF_TAPS - 1 - j + p/up.
+ * Each phase is normalized to exactly unity gain at DC after rounding.
+ */
+static void design_filter(audio_resampler_t *rs) {
+    double ratio = (double)rs->up / (double)rs->down;
+    double c = CUTOFF * (ratio < 1.0 ? ratio : 1.0);
+    double norm = bessel_i0(KAISER_BETA);
+    double h[AUDIO_RESAMPLE_TAPS];
+
+    for (unsigned p = 0; p < rs->up; p++) {
+        double sum = 0.0;
+        for (int j = 0; j < AUDIO_RESAMPLE_TAPS; j++) {
+            double d = (double)(HALF_TAPS - 1 - j) + (double)p / (double)rs->up;
+            double x = c * d;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = d / (double)HALF_TAPS;
+            double w = (fabs(r) >= 1.0) ? 0.0 : bessel_i0(KAISER_BETA * sqrt(1.0 - r * r)) / norm;
+            h[j] = sinc * w;
+            sum += h[j];
+        }
+
+        int16_t *row = rs->coeffs + (size_t)p * AUDIO_RESAMPLE_TAPS;
+        int total = 0;
+        int peak = 0;
+        for (int j = 0; j < AUDIO_RESAMPLE_TAPS; j++) {
+            row[j] = (int16_t)lrint(h[j] / sum * 16384.0);
+            total += row[j];
+            if (abs(row[j]) > abs(row[peak])) peak = j;
+        }
+        row[peak] = (int16_t)(row[peak] + (16384 - total));
+    }
+}
+
+int audio_resampler_init(audio_resampler_t *rs, long in_rate, int in_channels, long out_rate, int out_channels) {
+    memset(rs, 0, sizeof(*rs));
+    if (in_rate <= 0 || out_rate <= 0) return -1;
+    if (in_channels < 1 || in_channels > AUDIO_RESAMPLE_MAX_CHANNELS) return -1;
+    if (out_channels < 1 || out_channels > AUDIO_RESAMPLE_MAX_CHANNELS) return -1;
+
+    long g = gcd_long(in_rate, out_rate);
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->in_channels = in_channels;
+    rs->out_channels = out_channels;
+    rs->up = (unsigned)(out_rate / g);
+    rs->down = (unsigned)(in_rate / g);
+    rs->passthrough = (in_rate == out_rate);
+    rs->simd = 1;
+    if (rs->passthrough) return 0;
+    if (rs->up > AUDIO_RESAMPLE_MAX_PHASES) return -1;
+
+    rs->coeffs = malloc((size_t)rs->up * AUDIO_RESAMPLE_TAPS * sizeof(int16_t));
+    if (!rs->coeffs) return -1;
+    design_filter(rs);
+
+    rs->hist_cap = HIST_BLOCK + AUDIO_RESAMPLE_TAPS;
+    for (int c = 0; c < out_channels; c++) {
+        rs->hist[c] = malloc(rs->hist_cap * sizeof(int16_t));
+        if (!rs->hist[c]) {
+            audio_resampler_free(rs);
+            return -1;
+        }
+    }
+    audio_resampler_reset(rs);
+    return 0;
+}
+
+void audio_resampler_free(audio_resampler_t *rs) {
+    free(rs->coeffs);
+    for (int c = 0; c < AUDIO_RESAMPLE_MAX_CHANNELS; c++) free(rs->hist[c]);
+    memset(rs, 0, sizeof(*rs));
+}
+
+/* The first output lines up with the first input; the taps before it see silence. */
+void audio_resampler_reset(audio_resampler_t *rs) {
+    if (rs->passthrough) return;
+    for (int c = 0; c < rs->out_channels; c++) memset(rs->hist[c], 0, (HALF_TAPS - 1) * sizeof(int16_t));
+    rs->hist_fill = HALF_TAPS - 1;
+    rs->pos = HALF_TAPS - 1;
+    rs->phase = 0;
+}
+
+size_t audio_resampler_max_out(const audio_resampler_t *rs, size_t in_frames) {
+    if (rs->passthrough) return in_frames;
+    return (in_frames + AUDIO_RESAMPLE_TAPS) * rs->up / rs->down + 2;
+}
+
+static inline int16_t clamp_s16(int32_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+/* Channel map one interleaved frame into dst (out_channels samples). */
+static inline void map_frame(const audio_resampler_t *rs, const int16_t *in, int16_t *dst) {
+    if (rs->in_channels == rs->out_channels) {
+        for (int c = 0; c < rs->out_channels; c++) dst[c] = in[c];
+    } else if (rs->in_channels == 1) {
+        dst[0] = dst[1] = in[0];
+    } else {
+        dst[0] = (int16_t)(((int32_t)in[0] + in[1]) >> 1);
+    }
+}
+
+/* Append up to frames of input (NULL means silence); returns frames taken. */
+static size_t feed(audio_resampler_t *rs, const int16_t *in, size_t frames) {
+    size_t room = rs->hist_cap - rs->hist_fill;
+    if (frames > room) frames = room;
+
+    for (size_t i = 0; i < frames; i++) {
+        int16_t mapped[AUDIO_RESAMPLE_MAX_CHANNELS] = {0, 0};
+        if (in) map_frame(rs, in + i * (size_t)rs->in_channels, mapped);
+        for (int c = 0; c < rs->out_channels; c++) rs->hist[c][rs->hist_fill + i] = mapped[c];
+    }
+    rs->hist_fill += frames;
+    return frames;
+}
+
+/* Produce every output whose taps are all buffered, then drop spent input. */
+static size_t drain(audio_resampler_t *rs, int16_t *out) {
+    size_t produced = 0;
+    int32_t (*dot)(const int16_t *, const int16_t *, size_t) = rs->simd ? audio_dot_s16 : audio_dot_s16_scalar;
+
+    while (rs->pos + HALF_TAPS < rs->hist_fill) {
+        const int16_t *taps = rs->coeffs + (size_t)rs->phase * AUDIO_RESAMPLE_TAPS;
+        size_t start = rs->pos + 1 - HALF_TAPS;
+        for (int c = 0; c < rs->out_channels; c++) {
+            int32_t acc = dot(rs->hist[c] + start, taps, AUDIO_RESAMPLE_TAPS);
+            out[produced * (size_t)rs->out_channels + (size_t)c] = clamp_s16((acc + (1 << 13)) >> 14);
+        }
+        produced++;
+
+        rs->phase += rs->down;
+        rs->pos += rs->phase / rs->up;
+        rs->phase %= rs->up;
+    }
+
+    size_t keep_from = rs->pos + 1 - HALF_TAPS;
+    if (keep_from > rs->hist_fill) keep_from = rs->hist_fill;
+    if (keep_from > 0) {
+        for (int c = 0; c < rs->out_channels; c++) {
+            memmove(rs->hist[c], rs->hist[c] + keep_from, (rs->hist_fill - keep_from) * sizeof(int16_t));
+        }
+        rs->hist_fill -= keep_from;
+        rs->pos -= keep_from;
+    }
+    return produced;
+}
+
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_frames, int16_t *out) {
+    if (rs->passthrough) {
+        if (rs->in_channels == rs->out_channels) {
+            memcpy(out, in, in_frames * (size_t)rs->in_channels * sizeof(int16_t));
+        } else {
+            for (size_t i = 0; i < in_frames; i++) {
+                map_frame(rs, in + i * (size_t)rs->in_channels, out + i * (size_t)rs->out_channels);
+            }
+        }
+        return in_frames;
+    }
+
+    size_t produced = 0;
+    while (in_frames > 0) {
+        size_t taken = feed(rs, in, in_frames);
+        in += taken * (size_t)rs->in_channels;
+        in_frames -= taken;
+        produced += drain(rs, out + produced * (size_t)rs->out_channels);
+    }
+    return produced;
+}
+
+size_t audio_resampler_flush(audio_resampler_t *rs, int16_t *out) {
+    if (rs->passthrough) return 0;
+
+    size_t produced = 0;
+    size_t pending = HALF_TAPS;
+    while (pending > 0) {
+        size_t taken = feed(rs, NULL, pending);
+        pending -= taken;
+        produced += drain(rs, out + produced * (size_t)rs->out_channels);
+    }
+    audio_resampler_reset(rs);
+    return produced;
+}
@@ -0,0 +1,58 @@
+#ifndef AUDIO_RESAMPLE_H
+#define AUDIO_RESAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * audio_resample.h
+ *
+ * Streaming int16 sample rate and channel converter. The output device is
+ * kept on one format, and every source is brought to it here.
+ *
+ * Rates are related by a reduced fraction up/down, and a windowed-sinc
+ * filter is stored as one set of Q14 taps per output phase, so each output
+ * sample is a single int16 dot product (audio_dot_s16). State carries over
+ * between calls, so consecutive tracks at the same rate join without a gap
+ * or click.
+ */
+
+#define AUDIO_RESAMPLE_TAPS 64
+#define AUDIO_RESAMPLE_MAX_PHASES 1024
+#define AUDIO_RESAMPLE_MAX_CHANNELS 2
+
+typedef struct
+{
+	long in_rate;
+	long out_rate;
+	int in_channels;
+	int out_channels;
+	unsigned up;	 /* out_rate / gcd */
+	unsigned down;	 /* in_rate / gcd */
+	int passthrough; /* Same rate: channel mapping only */
+	int16_t *coeffs; /* up phases of AUDIO_RESAMPLE_TAPS, Q14 */
+	int16_t *hist[AUDIO_RESAMPLE_MAX_CHANNELS];
+	size_t hist_cap;
+	size_t hist_fill;
+	size_t pos;		 /* Input index of the next output, within hist */
+	unsigned phase;	 /* Fractional part of pos, in 1/up steps */
+	int simd;		 /* Use the vector dot product when compiled in */
+} audio_resampler_t;
+
+/* Channels are 1 or 2. Fails for rate pairs needing more than MAX_PHASES. */
+int audio_resampler_init(audio_resampler_t *rs, long in_rate, int in_channels, long out_rate, int out_channels);
+void audio_resampler_free(audio_resampler_t *rs);
+
+/* Forget buffered input, e.g. after a seek. */
+void audio_resampler_reset(audio_resampler_t *rs);
+
+/* Upper bound on frames produced by converting in_frames (or by a flush). */
+size_t audio_resampler_max_out(const audio_resampler_t *rs, size_t in_frames);
+
+/* Interleaved in, interleaved out. Returns frames written to out. */
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_frames, int16_t *out);
+
+/* Emit the input still held back by the filter, e.g. before a rate change. */
+size_t audio_resampler_flush(audio_resampler_t *rs, int16_t *out);
+
+#endif
@@ -0,0 +1,74 @@
+#include "audio_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int audio_ring_init(audio_ring_t *ring, size_t min_bytes) {
+    size_t capacity = 1024;
+    while (capacity < min_bytes) capacity <<= 1;
+
+    ring->data = malloc(capacity);
+    if (!ring->data) return -1;
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 0;
+}
+
+void audio_ring_free(audio_ring_t *ring) {
+    free(ring->data);
+    ring->data = NULL;
+    ring->capacity = 0;
+    ring->mask = 0;
+}
+
+/* Only valid while neither thread is touching the ring. */
+void audio_ring_reset(audio_ring_t *ring) {
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+}
+
+size_t audio_ring_readable(audio_ring_t *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+size_t audio_ring_writable(audio_ring_t *ring) {
+    return ring->capacity - audio_ring_readable(ring);
+}
+
+size_t audio_ring_write(audio_ring_t *ring, const void *src, size_t bytes) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t space = ring->capacity - (head - tail);
+    if (bytes > space) bytes = space;
+    if (bytes == 0) return 0;
+
+    size_t offset = head & ring->mask;
+    size_t first = ring->capacity - offset;
+    if (first > bytes) first = bytes;
+    memcpy(ring->data + offset, src, first);
+    memcpy(ring->data, (const unsigned char *)src + first, bytes - first);
+
+    atomic_store_explicit(&ring->head, head + bytes, memory_order_release);
+    return bytes;
+}
+
+const unsigned char *audio_ring_peek(audio_ring_t *ring, size_t *contiguous) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t avail = head - tail;
+
+    size_t offset = tail & ring->mask;
+    size_t run = ring->capacity - offset;
+    if (run > avail) run = avail;
+    if (contiguous) *contiguous = run;
+    return ring->data + offset;
+}
+
+void audio_ring_consume(audio_ring_t *ring, size_t bytes) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + bytes, memory_order_release);
+}
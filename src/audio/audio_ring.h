@@ -0,0 +1,41 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * audio_ring.h
+ *
+ * Single-producer/single-consumer byte ring for PCM.
+ * The decoder thread is the only writer and the output thread the only
+ * reader, so head and tail are plain atomics and neither side ever locks.
+ *
+ * head/tail count bytes since the last reset and are allowed to wrap;
+ * only their difference is meaningful.
+ */
+
+typedef struct
+{
+	unsigned char *data;
+	size_t capacity; /* Power of two, in bytes */
+	size_t mask;
+	atomic_size_t head; /* Bytes written (producer owned) */
+	atomic_size_t tail; /* Bytes consumed (consumer owned) */
+} audio_ring_t;
+
+int audio_ring_init(audio_ring_t *ring, size_t min_bytes);
+void audio_ring_free(audio_ring_t *ring);
+void audio_ring_reset(audio_ring_t *ring);
+
+size_t audio_ring_readable(audio_ring_t *ring);
+size_t audio_ring_writable(audio_ring_t *ring);
+
+/* Producer side. Copies as much as fits and returns the byte count. */
+size_t audio_ring_write(audio_ring_t *ring, const void *src, size_t bytes);
+
+/* Consumer side. Peek returns the contiguous readable run without copying. */
+const unsigned char *audio_ring_peek(audio_ring_t *ring, size_t *contiguous);
+void audio_ring_consume(audio_ring_t *ring, size_t bytes);
+
+#endif
@@ -0,0 +1,44 @@
+#include "audio_seqlock.h"
+
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+void audio_seqlock_init(audio_seqlock_t *sl) {
+    atomic_init(&sl->seq, 0);
+    for (size_t i = 0; i < AUDIO_SEQLOCK_MAX_VALUES; i++) atomic_init(&sl->words[i], 0);
+}
+
+void audio_seqlock_write(audio_seqlock_t *sl, const float *values, size_t count) {
+    if (count > AUDIO_SEQLOCK_MAX_VALUES) count = AUDIO_SEQLOCK_MAX_VALUES;
+
+    unsigned seq = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+    atomic_store_explicit(&sl->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t bits;
+        memcpy(&bits, &values[i], sizeof(bits));
+        atomic_store_explicit(&sl->words[i], bits, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&sl->seq, seq + 2, memory_order_release);
+}
+
+size_t audio_seqlock_read(audio_seqlock_t *sl, float *out, size_t count) {
+    if (count > AUDIO_SEQLOCK_MAX_VALUES) count = AUDIO_SEQLOCK_MAX_VALUES;
+
+    for (unsigned attempt = 0;; attempt++) {
+        unsigned before = atomic_load_explicit(&sl->seq, memory_order_acquire);
+        if ((before & 1u) == 0) {
+            for (size_t i = 0; i < count; i++) {
+                uint32_t bits = atomic_load_explicit(&sl->words[i], memory_order_relaxed);
+                memcpy(&out[i], &bits, sizeof(bits));
+            }
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&sl->seq, memory_order_relaxed) == before) return count;
+        }
+        /* Writer was preempted mid-update; give it the CPU. */
+        if (attempt >= 8) sched_yield();
+    }
+}
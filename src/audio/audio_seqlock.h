@@ -0,0 +1,27 @@
+#ifndef AUDIO_SEQLOCK_H
+#define AUDIO_SEQLOCK_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * audio_seqlock.h
+ *
+ * Publishes a small float array from one writer (an audio thread) to any
+ * number of readers (the UI). The writer never waits; a reader that
+ * overlaps a write simply retries.
+ */
+
+#define AUDIO_SEQLOCK_MAX_VALUES 64
+
+typedef struct
+{
+	atomic_uint seq;
+	atomic_uint words[AUDIO_SEQLOCK_MAX_VALUES]; /* float bit patterns */
+} audio_seqlock_t;
+
+void audio_seqlock_init(audio_seqlock_t *sl);
+void audio_seqlock_write(audio_seqlock_t *sl, const float *values, size_t count);
+size_t audio_seqlock_read(audio_seqlock_t *sl, float *out, size_t count);
+
+#endif
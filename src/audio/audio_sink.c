@@ -0,0 +1,200 @@
+#include "audio_sink.h"
+
+#include <mpg123.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Paced sinks may run this far ahead of the clock, like a device buffer. */
+#define PACED_LEAD_SEC 0.05
+
+#define WAV_HEADER_BYTES 44
+
+static double seconds_between(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void put_le16(unsigned char *p, unsigned v) {
+    p[0] = (unsigned char)(v & 0xff);
+    p[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+static void put_le32(unsigned char *p, uint32_t v) {
+    put_le16(p, v & 0xffff);
+    put_le16(p + 2, v >> 16);
+}
+
+static int wav_write_header(audio_sink_t *sink) {
+    unsigned char h[WAV_HEADER_BYTES];
+    uint64_t data = sink->wav_data_bytes;
+    if (data > 0xffffffffu - 36) data = 0xffffffffu - 36;
+    unsigned block_align = (unsigned)sink->channels * 2u;
+
+    memcpy(h, "RIFF", 4);
+    put_le32(h + 4, (uint32_t)(36 + data));
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le32(h + 16, 16);
+    put_le16(h + 20, 1); /* PCM */
+    put_le16(h + 22, (unsigned)sink->channels);
+    put_le32(h + 24, (uint32_t)sink->rate);
+    put_le32(h + 28, (uint32_t)sink->rate * block_align);
+    put_le16(h + 32, block_align);
+    put_le16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    put_le32(h + 40, (uint32_t)data);
+
+    if (fseek(sink->wav, 0, SEEK_SET) != 0) return -1;
+    return fwrite(h, sizeof(h), 1, sink->wav) == 1 ? 0 : -1;
+}
+
+/* Seconds of audio accepted beyond what the clock says has played. */
+static double paced_ahead(audio_sink_t *sink) {
+    if (!sink->paced || sink->bytes_per_sec == 0) return 0.0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const struct timespec *ref = sink->paused ? &sink->paused_at : &now;
+    double played = seconds_between(&sink->clock_start, ref);
+    double queued = (double)sink->clock_bytes / (double)sink->bytes_per_sec;
+    return queued > played ? queued - played : 0.0;
+}
+
+static void paced_reset(audio_sink_t *sink) {
+    clock_gettime(CLOCK_MONOTONIC, &sink->clock_start);
+    sink->clock_bytes = 0;
+}
+
+int audio_sink_open(audio_sink_t *sink, audio_sink_kind kind, const char *path, int paced, double device_buffer_sec) {
+    memset(sink, 0, sizeof(*sink));
+    sink->kind = kind;
+    sink->paced = paced;
+
+    if (kind == AUDIO_SINK_DEVICE) {
+        sink->ao = out123_new();
+        if (!sink->ao) return -1;
+        if (device_buffer_sec > 0.0) out123_param(sink->ao, OUT123_DEVICEBUFFER, 0, device_buffer_sec, NULL);
+        if (out123_open(sink->ao, NULL, NULL) != 0) {
+            out123_del(sink->ao);
+            sink->ao = NULL;
+            return -1;
+        }
+        return 0;
+    }
+
+    if (kind == AUDIO_SINK_WAV) {
+        if (!path || path[0] == '\0') return -1;
+        sink->wav = fopen(path, "wb");
+        if (!sink->wav) return -1;
+    }
+    return 0;
+}
+
+void audio_sink_close(audio_sink_t *sink, int drain) {
+    if (sink->ao) {
+        if (drain) out123_drain(sink->ao);
+        else out123_drop(sink->ao);
+        out123_close(sink->ao);
+        out123_del(sink->ao);
+    }
+    if (sink->wav) {
+        if (sink->started) wav_write_header(sink);
+        fclose(sink->wav);
+    }
+    memset(sink, 0, sizeof(*sink));
+}
+
+int audio_sink_start(audio_sink_t *sink, long rate, int channels, int encoding) {
+    if (sink->kind == AUDIO_SINK_DEVICE) {
+        if (sink->started) {
+            out123_drain(sink->ao);
+            out123_stop(sink->ao);
+        }
+        if (out123_start(sink->ao, rate, channels, encoding) != 0) return -1;
+    } else if (sink->kind == AUDIO_SINK_WAV) {
+        if (encoding != MPG123_ENC_SIGNED_16) return -1;
+        if (sink->started) {
+            if (rate != sink->rate || channels != sink->channels) return -1;
+        } else {
+            sink->rate = rate;
+            sink->channels = channels;
+            if (wav_write_header(sink) != 0) return -1;
+        }
+    }
+
+    if (sink->started && sink->kind != AUDIO_SINK_DEVICE) audio_sink_drain(sink);
+    sink->rate = rate;
+    sink->channels = channels;
+    sink->encoding = encoding;
+    sink->bytes_per_sec = (size_t)rate * (size_t)channels * (size_t)out123_encsize(encoding);
+    sink->started = 1;
+    paced_reset(sink);
+    return 0;
+}
+
+size_t audio_sink_play(audio_sink_t *sink, const void *pcm, size_t bytes) {
+    if (sink->kind == AUDIO_SINK_DEVICE) return out123_play(sink->ao, (void *)pcm, bytes);
+
+    if (sink->kind == AUDIO_SINK_WAV) {
+        bytes = fwrite(pcm, 1, bytes, sink->wav);
+        sink->wav_data_bytes += bytes;
+    }
+
+    if (sink->paced) {
+        double ahead = paced_ahead(sink);
+        if (ahead > PACED_LEAD_SEC) usleep((useconds_t)((ahead - PACED_LEAD_SEC) * 1e6));
+        /* Came back late (or idle): restart the clock instead of bursting to catch up. */
+        if (ahead <= 0.0) paced_reset(sink);
+        sink->clock_bytes += bytes;
+    }
+    return bytes;
+}
+
+size_t audio_sink_buffered(audio_sink_t *sink) {
+    if (sink->kind == AUDIO_SINK_DEVICE) return out123_buffered(sink->ao);
+    return (size_t)(paced_ahead(sink) * (double)sink->bytes_per_sec);
+}
+
+void audio_sink_pause(audio_sink_t *sink) {
+    if (sink->kind == AUDIO_SINK_DEVICE) {
+        out123_pause(sink->ao);
+        return;
+    }
+    if (!sink->paused) {
+        clock_gettime(CLOCK_MONOTONIC, &sink->paused_at);
+        sink->paused = 1;
+    }
+}
+
+void audio_sink_continue(audio_sink_t *sink) {
+    if (sink->kind == AUDIO_SINK_DEVICE) {
+        out123_continue(sink->ao);
+        return;
+    }
+    if (sink->paused) {
+        /* Shift the clock by the time spent paused. */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double gap = seconds_between(&sink->paused_at, &now);
+        long long ns = (long long)sink->clock_start.tv_nsec + (long long)(gap * 1e9);
+        sink->clock_start.tv_sec += (time_t)(ns / 1000000000LL);
+        sink->clock_start.tv_nsec = (long)(ns % 1000000000LL);
+        sink->paused = 0;
+    }
+}
+
+void audio_sink_drop(audio_sink_t *sink) {
+    if (sink->kind == AUDIO_SINK_DEVICE) {
+        out123_drop(sink->ao);
+        return;
+    }
+    paced_reset(sink);
+}
+
+void audio_sink_drain(audio_sink_t *sink) {
+    if (sink->kind == AUDIO_SINK_DEVICE) {
+        out123_drain(sink->ao);
+        return;
+    }
+    if (sink->wav) fflush(sink->wav);
+    double ahead = paced_ahead(sink);
+    if (ahead > 0.0) usleep((useconds_t)(ahead * 1e6));
+    paced_reset(sink);
+}
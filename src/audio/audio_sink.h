@@ -0,0 +1,64 @@
+#ifndef AUDIO_SINK_H
+#define AUDIO_SINK_H
+
+#include <out123.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * audio_sink.h
+ *
+ * Where decoded PCM ends up. The output thread talks to a sink instead of
+ * out123 directly so playback can run without audio hardware:
+ *
+ *   DEVICE  the default out123 driver (what the user hears)
+ *   NULL    discards samples
+ *   WAV     writes a 16-bit PCM WAV file
+ *
+ * NULL and WAV can be paced: they then consume samples no faster than real
+ * time and report a small buffer like a device would, so positions and
+ * track changes behave as in normal playback. Unpaced they run flat out,
+ * which is what benchmarks and offline renders want.
+ */
+
+typedef enum
+{
+	AUDIO_SINK_DEVICE = 0,
+	AUDIO_SINK_NULL,
+	AUDIO_SINK_WAV
+} audio_sink_kind;
+
+typedef struct
+{
+	audio_sink_kind kind;
+	int paced;
+	out123_handle *ao;
+	FILE *wav;
+	uint64_t wav_data_bytes;
+	long rate;
+	int channels;
+	int encoding;
+	size_t bytes_per_sec;
+	int started;
+	/* Pacing clock for NULL/WAV */
+	struct timespec clock_start;
+	uint64_t clock_bytes;
+	int paused;
+	struct timespec paused_at;
+} audio_sink_t;
+
+/* device_buffer_sec only applies to DEVICE; path only to WAV. */
+int audio_sink_open(audio_sink_t *sink, audio_sink_kind kind, const char *path, int paced, double device_buffer_sec);
+void audio_sink_close(audio_sink_t *sink, int drain);
+
+/* A WAV file holds one format: a start with a different one fails. */
+int audio_sink_start(audio_sink_t *sink, long rate, int channels, int encoding);
+size_t audio_sink_play(audio_sink_t *sink, const void *pcm, size_t bytes);
+size_t audio_sink_buffered(audio_sink_t *sink);
+void audio_sink_pause(audio_sink_t *sink);
+void audio_sink_continue(audio_sink_t *sink);
+void audio_sink_drop(audio_sink_t *sink);
+void audio_sink_drain(audio_sink_t *sink);
+
+#endif
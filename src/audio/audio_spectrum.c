@@ -0,0 +1,163 @@
+#include "audio_spectrum.h"
+#include "audio_kernels.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SPECTRUM_LOW_HZ 40.0
+#define SPECTRUM_HIGH_HZ 16000.0
+#define SPECTRUM_FLOOR_DB -60.0f
+#define SPECTRUM_ATTACK 0.6f
+#define SPECTRUM_DECAY 0.12f
+
+int audio_spectrum_init(audio_spectrum_t *sp, size_t bands) {
+    memset(sp, 0, sizeof(*sp));
+    if (bands == 0 || bands > AUDIO_SPECTRUM_MAX_BANDS) return -1;
+    if (audio_fft_init(&sp->fft, AUDIO_SPECTRUM_FFT) != 0) return -1;
+
+    sp->bands = bands;
+    for (size_t i = 0; i < AUDIO_SPECTRUM_FFT; i++) {
+        sp->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * (double)i / (double)(AUDIO_SPECTRUM_FFT - 1)));
+    }
+    atomic_init(&sp->tap_written, 0);
+    atomic_init(&sp->tap_heard, 0);
+    atomic_init(&sp->rate, 44100);
+    atomic_init(&sp->cost_us_last, 0);
+    atomic_init(&sp->cost_us_avg, 0);
+    atomic_init(&sp->cost_us_max, 0);
+    audio_seqlock_init(&sp->published);
+    return 0;
+}
+
+void audio_spectrum_free(audio_spectrum_t *sp) {
+    audio_fft_free(&sp->fft);
+}
+
+void audio_spectrum_reset(audio_spectrum_t *sp) {
+    for (size_t b = 0; b < sp->bands; b++) sp->level[b] = 0.0f;
+    atomic_store(&sp->tap_written, 0);
+    atomic_store(&sp->tap_heard, 0);
+    audio_seqlock_write(&sp->published, sp->level, sp->bands);
+}
+
+void audio_spectrum_set_rate(audio_spectrum_t *sp, long rate) {
+    if (rate > 0) atomic_store(&sp->rate, rate);
+}
+
+void audio_spectrum_push(audio_spectrum_t *sp, const int16_t *pcm, size_t frames, int channels) {
+    if (!pcm || channels < 1) return;
+
+    size_t written = atomic_load_explicit(&sp->tap_written, memory_order_relaxed);
+    for (size_t f = 0; f < frames; f++) {
+        int32_t s = pcm[f * (size_t)channels];
+        if (channels > 1) s = (s + pcm[f * (size_t)channels + 1]) >> 1;
+        sp->tap[(written + f) & (AUDIO_SPECTRUM_TAP - 1)] = (int16_t)s;
+    }
+    atomic_store_explicit(&sp->tap_written, written + frames, memory_order_release);
+}
+
+void audio_spectrum_set_latency(audio_spectrum_t *sp, size_t frames) {
+    size_t written = atomic_load_explicit(&sp->tap_written, memory_order_relaxed);
+    if (frames > AUDIO_SPECTRUM_TAP - AUDIO_SPECTRUM_FFT) frames = AUDIO_SPECTRUM_TAP - AUDIO_SPECTRUM_FFT;
+    atomic_store_explicit(&sp->tap_heard, written > frames ? written - frames : 0, memory_order_release);
+}
+
+/* Log-spaced band edges as FFT bin ranges, at least one bin wide. */
+static void compute_bands(audio_spectrum_t *sp, long rate) {
+    double nyquist = (double)rate / 2.0;
+    double high = (SPECTRUM_HIGH_HZ < nyquist) ? SPECTRUM_HIGH_HZ : nyquist;
+    double bin_hz = (double)rate / (double)AUDIO_SPECTRUM_FFT;
+    unsigned last_bin = AUDIO_SPECTRUM_FFT / 2;
+    unsigned prev_hi = 0;
+
+    for (size_t b = 0; b < sp->bands; b++) {
+        double f_lo = SPECTRUM_LOW_HZ * pow(high / SPECTRUM_LOW_HZ, (double)b / (double)sp->bands);
+        double f_hi = SPECTRUM_LOW_HZ * pow(high / SPECTRUM_LOW_HZ, (double)(b + 1) / (double)sp->bands);
+        unsigned lo = (unsigned)(f_lo / bin_hz + 0.5);
+        unsigned hi = (unsigned)(f_hi / bin_hz + 0.5);
+        if (lo < 1) lo = 1;
+        if (lo < prev_hi) lo = prev_hi;
+        if (hi <= lo) hi = lo + 1;
+        if (hi > last_bin) hi = last_bin;
+        if (lo >= hi) lo = hi - 1;
+        sp->band_lo[b] = lo;
+        sp->band_hi[b] = hi;
+        prev_hi = hi;
+    }
+    sp->band_rate = rate;
+}
+
+/* Copy the FFT-size samples ending at the heard position; 0 if not enough yet. */
+static int snapshot_tap(audio_spectrum_t *sp) {
+    size_t heard = atomic_load_explicit(&sp->tap_heard, memory_order_acquire);
+    if (heard < AUDIO_SPECTRUM_FFT) return 0;
+
+    size_t start = heard - AUDIO_SPECTRUM_FFT;
+    for (size_t i = 0; i < AUDIO_SPECTRUM_FFT; i++) {
+        sp->scratch[i] = sp->tap[(start + i) & (AUDIO_SPECTRUM_TAP - 1)];
+    }
+
+    /* If the writer lapped the slots we copied, the frame is torn. */
+    atomic_thread_fence(memory_order_acquire);
+    size_t after = atomic_load_explicit(&sp->tap_written, memory_order_relaxed);
+    return (after - start) <= AUDIO_SPECTRUM_TAP;
+}
+
+static void smooth_towards(audio_spectrum_t *sp, const float *target) {
+    for (size_t b = 0; b < sp->bands; b++) {
+        float k = (target[b] > sp->level[b]) ? SPECTRUM_ATTACK : SPECTRUM_DECAY;
+        sp->level[b] += (target[b] - sp->level[b]) * k;
+    }
+}
+
+void audio_spectrum_process(audio_spectrum_t *sp) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    float target[AUDIO_SPECTRUM_MAX_BANDS] = {0};
+    long rate = atomic_load(&sp->rate);
+    if (rate != sp->band_rate) compute_bands(sp, rate);
+
+    /* Digital silence or no data: let the bars fall without an FFT. */
+    if (snapshot_tap(sp) && audio_sumsq_s16(sp->scratch, AUDIO_SPECTRUM_FFT) >= AUDIO_SPECTRUM_FFT) {
+        for (size_t i = 0; i < AUDIO_SPECTRUM_FFT; i++) {
+            sp->frame[i] = (float)sp->scratch[i] * (1.0f / 32768.0f) * sp->window[i];
+        }
+        audio_fft_power(&sp->fft, sp->frame, sp->power);
+
+        /* A full-scale sine through a Hann window peaks at |X| = n/4. */
+        const float ref = (float)(AUDIO_SPECTRUM_FFT / 4) * (float)(AUDIO_SPECTRUM_FFT / 4);
+        for (size_t b = 0; b < sp->bands; b++) {
+            float sum = 0.0f;
+            for (unsigned k = sp->band_lo[b]; k < sp->band_hi[b]; k++) sum += sp->power[k];
+            float db = 10.0f * log10f(sum / ref + 1e-12f);
+            float v = (db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB;
+            if (v < 0.0f) v = 0.0f;
+            if (v > 1.0f) v = 1.0f;
+            target[b] = v;
+        }
+    }
+
+    smooth_towards(sp, target);
+    audio_seqlock_write(&sp->published, sp->level, sp->bands);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    long long us = (long long)(t1.tv_sec - t0.tv_sec) * 1000000LL + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    unsigned cost = us < 0 ? 0u : (unsigned)us;
+    unsigned avg = atomic_load_explicit(&sp->cost_us_avg, memory_order_relaxed);
+    atomic_store_explicit(&sp->cost_us_avg, avg == 0 ? cost : (avg * 7 + cost) / 8, memory_order_relaxed);
+    atomic_store_explicit(&sp->cost_us_last, cost, memory_order_relaxed);
+    if (cost > atomic_load_explicit(&sp->cost_us_max, memory_order_relaxed)) {
+        atomic_store_explicit(&sp->cost_us_max, cost, memory_order_relaxed);
+    }
+}
+
+size_t audio_spectrum_read(audio_spectrum_t *sp, float *out, size_t max_bands) {
+    size_t count = (max_bands < sp->bands) ? max_bands : sp->bands;
+    return audio_seqlock_read(&sp->published, out, count);
+}
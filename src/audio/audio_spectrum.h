@@ -0,0 +1,81 @@
+#ifndef AUDIO_SPECTRUM_H
+#define AUDIO_SPECTRUM_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio_fft.h"
+#include "audio_seqlock.h"
+
+/*
+ * audio_spectrum.h
+ *
+ * Spectrum analyzer for the now-playing bars.
+ *
+ * The output thread pushes what it plays into a mono history tap. An
+ * analysis thread calls audio_spectrum_process() at display rate: it
+ * windows the AUDIO_SPECTRUM_FFT samples ending at the one being heard,
+ * runs a real FFT, sums the power into log-spaced bands and applies
+ * attack/decay smoothing. The result is published through a seqlock for
+ * the UI.
+ *
+ * Tap positions count frames since the reset. Samples reach the tap as
+ * they are handed to the mixer, a few hundred ms before the speaker; the
+ * output thread reports that latency after each write, so the tap doubles
+ * as the delay line and the bars show what is audible, not what is queued.
+ *
+ * Work per call is one fixed-size FFT, independent of the decode block
+ * size, so the CPU cost is bounded by the call rate.
+ */
+
+#define AUDIO_SPECTRUM_FFT 2048
+#define AUDIO_SPECTRUM_TAP 32768 /* Latency compensated up to TAP - FFT frames, ~700 ms */
+#define AUDIO_SPECTRUM_MAX_BANDS 32
+
+typedef struct
+{
+	audio_fft_t fft;
+	size_t bands;
+
+	/* Analysis thread state */
+	float window[AUDIO_SPECTRUM_FFT];
+	float frame[AUDIO_SPECTRUM_FFT];
+	int16_t scratch[AUDIO_SPECTRUM_FFT];
+	float power[AUDIO_SPECTRUM_FFT / 2 + 1];
+	unsigned band_lo[AUDIO_SPECTRUM_MAX_BANDS];
+	unsigned band_hi[AUDIO_SPECTRUM_MAX_BANDS];
+	long band_rate;
+	float level[AUDIO_SPECTRUM_MAX_BANDS];
+
+	/* Output thread writes, analysis thread reads */
+	int16_t tap[AUDIO_SPECTRUM_TAP];
+	atomic_size_t tap_written;
+	atomic_size_t tap_heard; /* Tap position reaching the speaker now */
+	atomic_long rate;
+
+	/* Published to the UI */
+	audio_seqlock_t published;
+	atomic_uint cost_us_last;
+	atomic_uint cost_us_avg;
+	atomic_uint cost_us_max;
+} audio_spectrum_t;
+
+int audio_spectrum_init(audio_spectrum_t *sp, size_t bands);
+void audio_spectrum_free(audio_spectrum_t *sp);
+
+/* Zero the bars. Only while no analysis thread is running. */
+void audio_spectrum_reset(audio_spectrum_t *sp);
+
+void audio_spectrum_set_rate(audio_spectrum_t *sp, long rate);
+void audio_spectrum_push(audio_spectrum_t *sp, const int16_t *pcm, size_t frames, int channels);
+
+/* Frames pushed but not yet heard; output thread, after each write. */
+void audio_spectrum_set_latency(audio_spectrum_t *sp, size_t frames);
+
+void audio_spectrum_process(audio_spectrum_t *sp);
+
+/* Band levels in 0..1, lowest band first. */
+size_t audio_spectrum_read(audio_spectrum_t *sp, float *out, size_t max_bands);
+
+#endif
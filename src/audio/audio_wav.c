@@ -0,0 +1,117 @@
+#include "audio_wav.h"
+
+#include <string.h>
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint32_t le32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t le16(const unsigned char *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+/* A 16-byte fmt chunk body this reader can play. */
+static int read_fmt(const unsigned char *fmt, long *rate, int *channels) {
+    uint16_t tag = le16(fmt);
+    *channels = le16(fmt + 2);
+    *rate = (long)le32(fmt + 4);
+    uint16_t bits = le16(fmt + 14);
+    if ((tag != WAVE_FORMAT_PCM && tag != WAVE_FORMAT_EXTENSIBLE) || bits != 16 ||
+        *channels < 1 || *channels > 2 || *rate <= 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int audio_wav_open(audio_wav_t *w, const char *path) {
+    memset(w, 0, sizeof(*w));
+    w->f = fopen(path, "rb");
+    if (!w->f) return -1;
+
+    unsigned char riff[12];
+    if (fread(riff, sizeof(riff), 1, w->f) != 1 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        audio_wav_close(w);
+        return -1;
+    }
+
+    int have_fmt = 0;
+    unsigned char chunk[8];
+    while (fread(chunk, sizeof(chunk), 1, w->f) == 1) {
+        uint32_t size = le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            unsigned char fmt[16];
+            if (fread(fmt, sizeof(fmt), 1, w->f) != 1 || read_fmt(fmt, &w->rate, &w->channels) != 0) break;
+            have_fmt = 1;
+            size -= 16;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) break;
+            w->data_bytes = size;
+            w->data_left = size;
+            return 0;
+        }
+
+        /* Chunks are padded to an even size. */
+        if (fseek(w->f, (long)size + (long)(size & 1u), SEEK_CUR) != 0) break;
+    }
+
+    audio_wav_close(w);
+    return -1;
+}
+
+void audio_wav_close(audio_wav_t *w) {
+    if (w->f) fclose(w->f);
+    memset(w, 0, sizeof(*w));
+}
+
+size_t audio_wav_read(audio_wav_t *w, int16_t *out, size_t frames) {
+    size_t frame_bytes = (size_t)w->channels * sizeof(int16_t);
+    if (frames * frame_bytes > w->data_left) frames = (size_t)(w->data_left / frame_bytes);
+    if (frames == 0) return 0;
+
+    size_t got = fread(out, frame_bytes, frames, w->f);
+    w->data_left -= got * frame_bytes;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < got * (size_t)w->channels; i++) {
+        uint16_t v = (uint16_t)out[i];
+        out[i] = (int16_t)(uint16_t)(v >> 8 | v << 8);
+    }
+#endif
+    return got;
+}
+
+uint64_t audio_wav_frames(const audio_wav_t *w) {
+    return w->channels > 0 ? w->data_bytes / ((uint64_t)w->channels * sizeof(int16_t)) : 0;
+}
+
+int audio_wav_parse(const unsigned char *data, size_t size, long *rate, int *channels, size_t *offset,
+                    uint64_t *bytes) {
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) return -1;
+
+    int have_fmt = 0;
+    size_t pos = 12;
+    while (size - pos >= 8) {
+        const unsigned char *chunk = data + pos;
+        uint32_t chunk_size = le32(chunk + 4);
+        pos += 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16) {
+            if (size - pos < 16 || read_fmt(data + pos, rate, channels) != 0) return -1;
+            have_fmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) return -1;
+            *offset = pos;
+            *bytes = chunk_size < size - pos ? chunk_size : size - pos; /* Cut short by a copy */
+            return 0;
+        }
+
+        /* Chunks are padded to an even size. */
+        uint64_t skip = (uint64_t)chunk_size + (chunk_size & 1u);
+        if (skip > size - pos) return -1;
+        pos += (size_t)skip;
+    }
+    return -1;
+}
@@ -0,0 +1,37 @@
+#ifndef AUDIO_WAV_H
+#define AUDIO_WAV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * audio_wav.h
+ *
+ * Reader for 16-bit PCM WAV files (plain or WAVE_FORMAT_EXTENSIBLE),
+ * mono or stereo, any sample rate. Unknown chunks are skipped.
+ */
+
+typedef struct
+{
+	FILE *f;
+	long rate;
+	int channels;
+	uint64_t data_bytes;
+	uint64_t data_left;
+} audio_wav_t;
+
+int audio_wav_open(audio_wav_t *w, const char *path);
+void audio_wav_close(audio_wav_t *w);
+
+/* Interleaved int16 frames; returns frames read, 0 at the end. */
+size_t audio_wav_read(audio_wav_t *w, int16_t *out, size_t frames);
+
+/* Length in frames. */
+uint64_t audio_wav_frames(const audio_wav_t *w);
+
+/* The same checks on a file in memory: format and where the samples are. */
+int audio_wav_parse(const unsigned char *data, size_t size, long *rate, int *channels, size_t *offset,
+					uint64_t *bytes);
+
+#endif
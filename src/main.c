@@ -152,10 +152,15 @@
  *    fprintf(stderr, "msg\n")           print errors to stderr
  *    snprintf(buffer, size, fmt, ...)   format a string into a char array   */
 
+#include <stdlib.h>
+/*  General utilities.  Used here:
+ *    getenv("NAME")       read an environment variable (NULL if unset)       */
+
 #include <string.h>
 /*  String functions.  Used here:
  *    strlen(str)          count bytes in str (not counting '\0')
- *    strcat(dest, src)    append src to dest (dest must have room!)          */
+ *    strcat(dest, src)    append src to dest (dest must have room!)
+ *    strcmp / strncmp     compare whole strings / their first n bytes        */
 
 #include <stdbool.h>
 /*  Provides 'bool', 'true' (= 1), and 'false' (= 0).
@@ -198,9 +203,12 @@
 #include "services/settings_service.h"
 #include "frame_renderer.h"
 #include "draw_utils.h"
+#include "album_art.h"
 #include "services/theme_service.h"
 #include "services/notes_service.h"
+#include "services/mixer_service.h"
 #include "services/mp3_service.h"
+#include "services/sound_service.h"
 #include "services/voice_memo_service.h"
 
 
@@ -329,6 +337,22 @@ int main(void) {
     settings_service_init();
     theme_service_init();
     notes_service_init();
+
+    /*
+     * One output for everything that makes sound, opened before its users.
+     * BLACKHAND_AUDIO_OUT=null       play silently (no sound card needed)
+     * BLACKHAND_AUDIO_OUT=wav:<file> capture all audio to a WAV file
+     * Anything else, or unset, uses the real audio device.
+     */
+    const char *audio_out = getenv("BLACKHAND_AUDIO_OUT");
+    if (audio_out && strcmp(audio_out, "null") == 0) {
+        mixer_service_init(MIXER_OUTPUT_NULL, NULL);
+    } else if (audio_out && strncmp(audio_out, "wav:", 4) == 0) {
+        mixer_service_init(MIXER_OUTPUT_WAV, audio_out + 4);
+    } else {
+        mixer_service_init(MIXER_OUTPUT_DEVICE, NULL);
+    }
+    sound_service_init();
     mp3_service_init("./Music");
     voice_memo_service_init();
 
@@ -492,6 +516,9 @@ int main(void) {
         tick++;
         voice_memo_service_tick();
 
+        /* Pick up notes the background writer has saved. */
+        notes_service_poll();
+
         switch (current_screen) {
             case SCREEN_HOME:
                 screen_home_draw(phone);
@@ -596,8 +623,9 @@ int main(void) {
          * Here it exits the while(1) loop, falling through to cleanup.
          */
         if (key == NCKEY_RESIZE) { continue; }  /* redraw at new size */
-        if (key == 'q' || key == 'Q') { break; } /* quit */
-        if (key == 'h' || key == 'H') {
+        int typing = current_screen == SCREEN_NOTES && screen_notes_typing();
+        if (!typing && (key == 'q' || key == 'Q')) { break; } /* quit */
+        if (!typing && (key == 'h' || key == 'H')) {
             current_screen = SCREEN_HOME;
             continue;
         }
@@ -688,10 +716,13 @@ int main(void) {
      * hardware_cleanup()
      *   Closes any I2C/UART file descriptors opened by hardware_init().
      */
+    album_art_shutdown();
     ncplane_destroy(phone);
     notcurses_stop(nc);
     mp3_service_shutdown();
     voice_memo_service_shutdown();
+    sound_service_shutdown();
+    mixer_service_shutdown();
     notes_service_shutdown();
     settings_service_shutdown();
     hardware_cleanup();
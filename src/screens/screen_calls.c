@@ -3,6 +3,9 @@
 
 #include "config.h"
 #include "ui.h"
+#include "services/sound_service.h"
+
+static int g_ringing = 0;
 
 static const char *k_call_log[] = {
     "Noura  2m ago",
@@ -27,15 +30,33 @@ void screen_calls_draw(struct ncplane *phone) {
         ncplane_putstr_yx(phone, 5 + i, 2, k_call_log[i]);
     }
 
+    if (g_ringing) {
+        ncplane_set_fg_rgb(phone, COL_GHOST_PCT);
+        ncplane_putstr_yx(phone, 9, 2, "Incoming call...");
+    }
+
     ncplane_set_fg_rgb(phone, COL_HINT);
-    ncplane_putstr_yx(phone, (int)rows - 2, 2, "[b] Back");
+    ncplane_putstr_yx(phone, (int)rows - 2, 2, "[r] Ring  [b] Back");
 }
 
 screen_id screen_calls_input(uint32_t key) {
     switch (key) {
+        case 'r':
+        case 'R':
+            if (g_ringing) {
+                sound_service_stop(SOUND_RINGTONE);
+                g_ringing = 0;
+            } else {
+                g_ringing = (sound_service_play(SOUND_RINGTONE) == 0);
+            }
+            return SCREEN_CALLS;
         case NCKEY_ESC:
         case 'b':
         case 'B':
+            if (g_ringing) {
+                sound_service_stop(SOUND_RINGTONE);
+                g_ringing = 0;
+            }
             return SCREEN_HOME;
         default:
             return SCREEN_CALLS;
@@ -3,8 +3,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "album_art.h"
 #include "config.h"
 #include "ui.h"
+#include "services/lrc.h"
 #include "services/mp3_service.h"
 #include "services/theme_service.h"
 
@@ -13,8 +15,18 @@ typedef enum {
     MP3_MODE_NOW_PLAYING,
 } mp3_mode_t;
 
+#define VOLUME_STEP 5u
+
+/* Cover thumbnail at the right of the state line: 12x6 quadrant pixels, square on screen. */
+#define ART_ROW 8
+#define ART_ROWS 3u
+#define ART_COLS 6u
+
 static mp3_mode_t mode = MP3_MODE_LIBRARY;
 static int selected = 0;
+static int show_stats = 0;
+static lrc_t lyrics;
+static int lyrics_track = -1; /* Track the lyrics were loaded for */
 
 static int safe_trunc_index(int cols, int padding, int buf_size) {
     int idx = cols - padding;
@@ -49,6 +61,66 @@ static void draw_visualizer(struct ncplane *phone, int row, int col, int width)
     }
 }
 
+/* Load <track>.lrc when the track changes; a missing file leaves lyrics empty. */
+static void update_lyrics(int current, const AudioFile *track) {
+    if (current == lyrics_track) return;
+    lrc_free(&lyrics);
+    lyrics_track = current;
+
+    char path[1100];
+    const char *dot = strrchr(track->path, '.');
+    int stem = dot ? (int)(dot - track->path) : (int)strlen(track->path);
+    snprintf(path, sizeof(path), "%.*s.lrc", stem, track->path);
+    lrc_load(&lyrics, path);
+}
+
+/* Current lyric line, cut to width characters (not bytes: verses are often not ASCII). */
+static void draw_lyric(struct ncplane *phone, int row, int col, int width) {
+    const char *line = lrc_line_at(&lyrics, mp3_service_get_position_ms());
+    if (!line || width <= 0) return;
+
+    char out[256];
+    size_t len = 0;
+    int chars = 0;
+    const unsigned char *p = (const unsigned char *)line;
+    while (*p && chars < width) {
+        size_t n = (*p >= 0xF0) ? 4 : (*p >= 0xE0) ? 3 : (*p >= 0xC0) ? 2 : 1;
+        size_t have = 0;
+        while (have < n && p[have]) have++;
+        if (len + have >= sizeof(out)) break;
+        memcpy(out + len, p, have);
+        len += have;
+        p += have;
+        chars++;
+    }
+    out[len] = '\0';
+
+    ncplane_set_fg_rgb(phone, theme_text_primary());
+    ncplane_set_bg_rgb(phone, theme_bg());
+    ncplane_putstr_yx(phone, row, col, out);
+}
+
+/* Engine counters in place of the visualizer, for tuning buffer size. */
+static void draw_stats(struct ncplane *phone, int row, int col) {
+    mp3_engine_stats stats;
+    mp3_service_get_stats(&stats);
+
+    char line[64];
+    ncplane_set_fg_rgb(phone, theme_text_muted());
+    ncplane_set_bg_rgb(phone, theme_bg());
+
+    snprintf(line, sizeof(line), "Buf %u/%ums  U %lu", stats.ring_fill_ms, stats.ring_capacity_ms, stats.underruns);
+    ncplane_putstr_yx(phone, row, col, line);
+    snprintf(line, sizeof(line), "Dec %u/%u us", stats.decode_us_avg, stats.decode_us_max);
+    ncplane_putstr_yx(phone, row + 1, col, line);
+    snprintf(line, sizeof(line), "FFT %u us %u.%u%% cpu", stats.analysis_us_avg,
+             stats.analysis_cpu_permille / 10, stats.analysis_cpu_permille % 10);
+    ncplane_putstr_yx(phone, row + 2, col, line);
+    snprintf(line, sizeof(line), "EQ %u us/s %u.%u%% cpu", stats.eq_us_per_sec,
+             stats.eq_us_per_sec / 10000, stats.eq_us_per_sec / 1000 % 10);
+    ncplane_putstr_yx(phone, row + 3, col, line);
+}
+
 static void draw_library(struct ncplane *phone, unsigned rows, unsigned cols) {
     size_t count = mp3_service_count();
 
@@ -61,17 +133,31 @@ static void draw_library(struct ncplane *phone, unsigned rows, unsigned cols) {
         return;
     }
 
-    if (selected < 0) selected = 0;
+    /* A playlist's name takes the first row. */
+    int playlist = mp3_service_get_playlist();
+    int first_row = 3;
+    if (playlist >= 0) {
+        count = mp3_service_listed_count();
+        char name[64];
+        snprintf(name, sizeof(name), "%s (%zu)", mp3_service_playlist_name(playlist), count);
+        name[safe_trunc_index((int)cols, 4, (int)sizeof(name))] = '\0';
+        ncplane_set_fg_rgb(phone, theme_text_muted());
+        ncplane_set_bg_rgb(phone, theme_bg());
+        ncplane_putstr_yx(phone, first_row++, 2, name);
+    }
+
     if (selected >= (int)count) selected = (int)count - 1;
+    if (selected < 0) selected = 0;
 
-    int max_rows = (int)rows - 5;
+    int max_rows = (int)rows - 2 - first_row;
     if (max_rows < 1) max_rows = 1;
 
     for (int i = 0; i < (int)count && i < max_rows; i++) {
-        const AudioFile *track = mp3_service_get((size_t)i);
+        int index = mp3_service_sorted((size_t)i);
+        const AudioFile *track = index >= 0 ? mp3_service_get((size_t)index) : NULL;
         if (!track) continue;
 
-        int row = 3 + i;
+        int row = first_row + i;
         const char *cursor = (i == selected) ? MENU_CURSOR : MENU_CURSOR_BLANK;
         uint32_t fg = (i == selected) ? theme_text_primary() : theme_text_muted();
 
@@ -87,7 +173,9 @@ static void draw_library(struct ncplane *phone, unsigned rows, unsigned cols) {
 
     ncplane_set_fg_rgb(phone, theme_text_muted());
     ncplane_set_bg_rgb(phone, theme_bg());
-    ncplane_putstr_yx(phone, (int)rows - 2, 2, "[Enter] Play  [b] Back");
+    char hint[64];
+    snprintf(hint, sizeof(hint), "[Ent]Play [o]%s [b]Back", mp3_service_sort_name(mp3_service_get_sort()));
+    ncplane_putstr_yx(phone, (int)rows - 2, 2, hint);
 }
 
 static void draw_now_playing(struct ncplane *phone, unsigned rows, unsigned cols) {
@@ -105,6 +193,7 @@ static void draw_now_playing(struct ncplane *phone, unsigned rows, unsigned cols
 
     playback_state st = mp3_service_get_state();
     unsigned elapsed = mp3_service_get_elapsed();
+    unsigned duration = mp3_service_get_duration();
 
     const char *state_text = (st == PLAYING) ? "PLAYING" : (st == PAUSED ? "PAUSED" : "STOPPED");
 
@@ -112,12 +201,32 @@ static void draw_now_playing(struct ncplane *phone, unsigned rows, unsigned cols
     ncplane_set_bg_rgb(phone, theme_bg());
     ncplane_putstr_yx(phone, 4, 2, "Now Playing");
 
+    char volume[16];
+    snprintf(volume, sizeof(volume), "Vol %u%%", mp3_service_get_volume());
+    ncplane_set_fg_rgb(phone, theme_text_muted());
+    ncplane_putstr_yx(phone, 4, (int)cols - 2 - (int)strlen(volume), volume);
+    char eq[32];
+    snprintf(eq, sizeof(eq), "EQ %s", mp3_service_eq_preset_name(mp3_service_get_eq_preset()));
+    ncplane_putstr_yx(phone, 5, (int)cols - 2 - (int)strlen(eq), eq);
+    static const char *repeat_text[PLAY_REPEAT_COUNT] = { "", "Rep", "Rep1" };
+    char modes[16];
+    snprintf(modes, sizeof(modes), "%s%s%s", mp3_service_get_shuffle() ? "Shuf" : "",
+             mp3_service_get_shuffle() && mp3_service_get_repeat() != PLAY_REPEAT_OFF ? " " : "",
+             repeat_text[mp3_service_get_repeat()]);
+    ncplane_putstr_yx(phone, 5, 2, modes);
+    ncplane_set_fg_rgb(phone, theme_text_primary());
+
     char line1[256];
     char line2[256];
     char line3[64];
     snprintf(line1, sizeof(line1), "Title: %s", track->title ? track->title : "Unknown");
     snprintf(line2, sizeof(line2), "Artist: %s", track->author ? track->author : "Unknown");
-    snprintf(line3, sizeof(line3), "%s  %u sec", state_text, elapsed);
+    if (duration > 0) {
+        snprintf(line3, sizeof(line3), "%s  %u:%02u/%u:%02u", state_text,
+                 elapsed / 60, elapsed % 60, duration / 60, duration % 60);
+    } else {
+        snprintf(line3, sizeof(line3), "%s  %u:%02u", state_text, elapsed / 60, elapsed % 60);
+    }
 
     line1[safe_trunc_index((int)cols, 4, (int)sizeof(line1))] = '\0';
     line2[safe_trunc_index((int)cols, 4, (int)sizeof(line2))] = '\0';
@@ -127,9 +236,21 @@ static void draw_now_playing(struct ncplane *phone, unsigned rows, unsigned cols
     ncplane_set_fg_rgb(phone, theme_text_muted());
     ncplane_putstr_yx(phone, 9, 2, line3);
 
-    draw_visualizer(phone, 11, 2, (int)cols - 4);
+    if (show_stats) {
+        draw_stats(phone, 10, 2);
+    } else {
+        char art_path[1100];
+        uint64_t art_key;
+        if (mp3_service_get_art((size_t)current, art_path, sizeof(art_path), &art_key) == 0) {
+            album_art_draw(phone, art_key, art_path, ART_ROW, (int)cols - 2 - (int)ART_COLS, ART_ROWS, ART_COLS);
+        }
+        draw_visualizer(phone, 11, 2, (int)cols - 4);
+        update_lyrics(current, track);
+        draw_lyric(phone, (int)rows - 3, 2, (int)cols - 4);
+    }
 
-    ncplane_putstr_yx(phone, (int)rows - 2, 2, "[space] Play/Pause  [b] Back");
+    ncplane_set_fg_rgb(phone, theme_text_muted());
+    ncplane_putstr_yx(phone, (int)rows - 2, 2, "[spc]Play [<>]Seek [b]Back");
 }
 
 void screen_mp3_draw(struct ncplane *phone) {
@@ -144,7 +265,7 @@ void screen_mp3_draw(struct ncplane *phone) {
 }
 
 screen_id screen_mp3_input(uint32_t key) {
-    size_t count = mp3_service_count();
+    size_t count = mp3_service_listed_count();
 
     if (mode == MP3_MODE_LIBRARY) {
         switch (key) {
@@ -155,8 +276,28 @@ screen_id screen_mp3_input(uint32_t key) {
                 if (selected < (int)count - 1) selected++;
                 return SCREEN_MP3;
             case NCKEY_ENTER:
-            case '\n':
-                if (count > 0 && mp3_service_play((size_t)selected) == 0) {
+            case '\n': {
+                int index = mp3_service_sorted((size_t)selected);
+                if (index >= 0 && mp3_service_play((size_t)index) == 0) {
+                    mode = MP3_MODE_NOW_PLAYING;
+                }
+                return SCREEN_MP3;
+            }
+            case 'o':
+            case 'O':
+                mp3_service_set_sort((mp3_service_get_sort() + 1) % MP3_SORT_COUNT);
+                selected = 0;
+                return SCREEN_MP3;
+            case 'l':
+            case 'L': {
+                /* All, then each playlist in turn. */
+                int next = mp3_service_get_playlist() + 1;
+                mp3_service_set_playlist((size_t)next < mp3_service_playlist_count() ? next : -1);
+                selected = 0;
+                return SCREEN_MP3;
+            }
+            case ' ':
+                if (mp3_service_get_current_index() >= 0 || mp3_service_play_queue() == 0) {
                     mode = MP3_MODE_NOW_PLAYING;
                 }
                 return SCREEN_MP3;
@@ -175,10 +316,56 @@ screen_id screen_mp3_input(uint32_t key) {
                 mp3_service_pause();
             } else if (mp3_service_get_state() == PAUSED) {
                 mp3_service_resume();
-            } else if (count > 0) {
-                mp3_service_play((size_t)selected);
+            } else if (mp3_service_play_queue() != 0 && mp3_service_sorted((size_t)selected) >= 0) {
+                mp3_service_play((size_t)mp3_service_sorted((size_t)selected));
             }
             return SCREEN_MP3;
+        case 'n':
+        case 'N':
+            mp3_service_next();
+            return SCREEN_MP3;
+        case 'p':
+        case 'P':
+            mp3_service_prev();
+            return SCREEN_MP3;
+        case 'z':
+        case 'Z':
+            mp3_service_set_shuffle(!mp3_service_get_shuffle());
+            return SCREEN_MP3;
+        case 'r':
+        case 'R':
+            mp3_service_set_repeat((mp3_service_get_repeat() + 1) % PLAY_REPEAT_COUNT);
+            return SCREEN_MP3;
+        case NCKEY_LEFT:
+            mp3_service_seek(-10);
+            return SCREEN_MP3;
+        case NCKEY_RIGHT:
+            mp3_service_seek(10);
+            return SCREEN_MP3;
+        case '+':
+        case '=':
+            mp3_service_set_volume(mp3_service_get_volume() + VOLUME_STEP);
+            return SCREEN_MP3;
+        case '-':
+        case '_': {
+            unsigned volume = mp3_service_get_volume();
+            mp3_service_set_volume(volume > VOLUME_STEP ? volume - VOLUME_STEP : 0);
+            return SCREEN_MP3;
+        }
+        case ',':
+            mp3_service_seek(-60);
+            return SCREEN_MP3;
+        case '.':
+            mp3_service_seek(60);
+            return SCREEN_MP3;
+        case 'e':
+        case 'E':
+            mp3_service_set_eq_preset((mp3_service_get_eq_preset() + 1) % mp3_service_eq_preset_count());
+            return SCREEN_MP3;
+        case 'i':
+        case 'I':
+            show_stats = !show_stats;
+            return SCREEN_MP3;
         case NCKEY_ESC:
         case 'b':
         case 'B':
@@ -1,5 +1,6 @@
 #include <notcurses/notcurses.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "config.h"
@@ -11,9 +12,10 @@
 /*
  * screen_notes.c
  *
- * Notes screen with two modes:
- *   LIST mode  — browse notes, create/delete
- *   VIEW mode  — read a single note's content
+ * Notes screen with three modes:
+ *   LIST mode   — browse notes, create/delete
+ *   VIEW mode   — read a single note's content
+ *   SEARCH mode — type words, pick from the best matching notes
  *
  * Coupling/cohesion:
  *   All note data comes from notes_service.
@@ -24,12 +26,23 @@
 typedef enum {
     NOTES_MODE_LIST,
     NOTES_MODE_VIEW,
+    NOTES_MODE_SEARCH,
 } notes_mode_t;
 
 /* ── Screen state (static = private to this file) ─────────────────────── */
 static notes_mode_t mode = NOTES_MODE_LIST;
 static int selected = 0;
 static int scroll_offset = 0;  /* for content scrolling in view mode */
+static notes_mode_t view_return = NOTES_MODE_LIST;  /* where [b] leaves view mode to */
+
+/* Search mode: the query as typed and the results of the last draw */
+#define SEARCH_QUERY_MAX    64
+#define SEARCH_RESULTS_MAX  32
+static char search_query[SEARCH_QUERY_MAX];
+static size_t search_len = 0;
+static Note *search_results[SEARCH_RESULTS_MAX];
+static int search_count = 0;
+static int search_selected = 0;
 
 static int safe_trunc_index(int cols, int padding, int buf_size) {
     int idx = cols - padding;
@@ -108,7 +121,7 @@ static void draw_list(struct ncplane *phone) {
 
     /* Hints at bottom */
     ghost_text(phone, (int)rows - 2, NOTES_COL,
-               theme_text_muted(), "[Enter]Open [n]New [d]Del [b]Back");
+               theme_text_muted(), "[Enter]Open [/]Find [n]New [d]Del [b]Back");
 }
 
 /* ── VIEW mode draw ───────────────────────────────────────────────────── */
@@ -145,9 +158,10 @@ static void draw_view(struct ncplane *phone) {
     int content_width = (int)cols - NOTES_COL - 2;  /* inside borders */
     if (content_width < 1) content_width = 1;
 
-    if (n->content && strlen(n->content) > 0) {
+    const char *content = notes_service_content(n);
+    if (content[0] != '\0') {
         /* Walk through content line by line */
-        const char *ptr = n->content;
+        const char *ptr = content;
         int line_num = 0;
         int drawn = 0;
 
@@ -183,9 +197,57 @@ static void draw_view(struct ncplane *phone) {
                    theme_text_muted(), "(empty)");
     }
 
-    /* Hints */
+    /* Hints, and whether the last change has reached the disk */
+    const char *hint = n->saving ? "[b]Back to list  saving..."
+                     : n->save_error ? "[b]Back to list  not saved"
+                                     : "[b]Back to list";
+    ghost_text(phone, (int)rows - 2, NOTES_COL, theme_text_muted(), hint);
+}
+
+/* ── SEARCH mode draw ─────────────────────────────────────────────────── */
+static void draw_search(struct ncplane *phone) {
+    unsigned rows, cols;
+    ncplane_dim_yx(phone, &rows, &cols);
+
+    char line[SEARCH_QUERY_MAX + 16];
+    snprintf(line, sizeof(line), "Find: %s_", search_query);
+    ghost_text(phone, NOTES_START_ROW, NOTES_COL, theme_text_primary(), line);
+
+    /* Searched every frame, so results follow the index as it catches up. */
+    int ready = 1;
+    search_count = (int)notes_service_search(search_query, search_results,
+                                             SEARCH_RESULTS_MAX, &ready);
+    if (search_selected >= search_count) search_selected = search_count - 1;
+    if (search_selected < 0) search_selected = 0;
+
+    int first_row = NOTES_START_ROW + 2;
+    if (search_count == 0) {
+        const char *msg = search_len == 0 ? "Type to search"
+                        : !ready          ? "Indexing notes..."
+                                          : "No matches";
+        ghost_text(phone, first_row, NOTES_COL, theme_text_muted(), msg);
+    }
+
+    int max_visible = (int)rows - first_row - NOTES_HINT_ROW_OFFSET;
+    for (int i = 0; i < search_count && i < max_visible; i++) {
+        Note *n = search_results[i];
+        uint32_t fg = (i == search_selected) ? theme_text_primary() : theme_text_muted();
+        ncplane_set_fg_rgb(phone, fg);
+        ncplane_set_bg_rgb(phone, theme_bg());
+        ncplane_putstr_yx(phone, first_row + i, NOTES_COL,
+                          (i == search_selected) ? MENU_CURSOR : MENU_CURSOR_BLANK);
+
+        char title_buf[128];
+        snprintf(title_buf, sizeof(title_buf), "%s", n->title ? n->title : "Untitled");
+        int trunc = safe_trunc_index((int)cols, NOTES_COL + 4, (int)sizeof(title_buf));
+        if ((int)strlen(title_buf) > trunc && trunc > 3) {
+            memcpy(title_buf + trunc - 3, "...", 4);
+        }
+        ncplane_putstr_yx(phone, first_row + i, NOTES_COL + 2, title_buf);
+    }
+
     ghost_text(phone, (int)rows - 2, NOTES_COL,
-               theme_text_muted(), "[b]Back to list");
+               theme_text_muted(), "[Enter]Open [Esc]Back");
 }
 
 /* ── Public draw ──────────────────────────────────────────────────────── */
@@ -193,6 +255,63 @@ void screen_notes_draw(struct ncplane *phone) {
     switch (mode) {
         case NOTES_MODE_LIST: draw_list(phone); break;
         case NOTES_MODE_VIEW: draw_view(phone); break;
+        case NOTES_MODE_SEARCH: draw_search(phone); break;
+    }
+}
+
+int screen_notes_typing(void) {
+    return mode == NOTES_MODE_SEARCH;
+}
+
+/* Open a search result in view mode; [b] comes back to the results. */
+static void open_result(Note *target) {
+    size_t count = 0;
+    Note **notes = notes_service_list_all(&count);
+    for (size_t i = 0; notes && i < count; i++) {
+        if (notes[i] == target) {
+            selected = (int)i;
+            scroll_offset = 0;
+            view_return = NOTES_MODE_SEARCH;
+            mode = NOTES_MODE_VIEW;
+            return;
+        }
+    }
+}
+
+static screen_id search_input(uint32_t key) {
+    switch (key) {
+        case NCKEY_UP:
+            if (search_selected > 0) search_selected--;
+            return SCREEN_NOTES;
+
+        case NCKEY_DOWN:
+            if (search_selected < search_count - 1) search_selected++;
+            return SCREEN_NOTES;
+
+        case NCKEY_ENTER:
+        case '\n':
+            if (search_selected < search_count) open_result(search_results[search_selected]);
+            return SCREEN_NOTES;
+
+        case NCKEY_BACKSPACE:
+        case 127:
+        case '\b':
+            if (search_len > 0) search_query[--search_len] = '\0';
+            search_selected = 0;
+            return SCREEN_NOTES;
+
+        case NCKEY_ESC:
+            mode = NOTES_MODE_LIST;
+            return SCREEN_NOTES;
+
+        default:
+            /* Letters go into the query, including the ones that are commands elsewhere. */
+            if (key >= ' ' && key < 127 && search_len < SEARCH_QUERY_MAX - 1) {
+                search_query[search_len++] = (char)key;
+                search_query[search_len] = '\0';
+                search_selected = 0;
+            }
+            return SCREEN_NOTES;
     }
 }
 
@@ -200,6 +319,8 @@ void screen_notes_draw(struct ncplane *phone) {
 screen_id screen_notes_input(uint32_t key) {
     size_t count = notes_service_note_count();
 
+    if (mode == NOTES_MODE_SEARCH) return search_input(key);
+
     if (mode == NOTES_MODE_LIST) {
         switch (key) {
             case NCKEY_UP:
@@ -214,10 +335,18 @@ screen_id screen_notes_input(uint32_t key) {
             case '\n':
                 if (count > 0) {
                     mode = NOTES_MODE_VIEW;
+                    view_return = NOTES_MODE_LIST;
                     scroll_offset = 0;
                 }
                 return SCREEN_NOTES;
 
+            case '/':
+                mode = NOTES_MODE_SEARCH;
+                search_query[0] = '\0';
+                search_len = 0;
+                search_selected = 0;
+                return SCREEN_NOTES;
+
             case 'n':
             case 'N':
                 notes_service_create("New Note", "");
@@ -258,7 +387,7 @@ screen_id screen_notes_input(uint32_t key) {
         case NCKEY_ESC:
         case 'b':
         case 'B':
-            mode = NOTES_MODE_LIST;
+            mode = view_return;
             scroll_offset = 0;
             return SCREEN_NOTES;
 
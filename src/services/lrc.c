@@ -0,0 +1,149 @@
+#include "lrc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LRC_MAX_BYTES (1024 * 1024)
+
+static int compare_lines(const void *a, const void *b) {
+    const lrc_line_t *x = a;
+    const lrc_line_t *y = b;
+    if (x->ms != y->ms) return x->ms < y->ms ? -1 : 1;
+    return (x->text > y->text) - (x->text < y->text); /* File order for equal times */
+}
+
+static const char *parse_digits(const char *p, long *out) {
+    if (*p < '0' || *p > '9') return NULL;
+    long v = 0;
+    while (*p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    *out = v;
+    return p;
+}
+
+/* "[mm:ss]", "[mm:ss.x]" to "[mm:ss.xxx]"; returns the end of the tag or NULL. */
+static const char *parse_time_tag(const char *p, long *ms) {
+    long min, sec, frac = 0;
+    if (*p++ != '[' || !(p = parse_digits(p, &min)) || *p++ != ':' || !(p = parse_digits(p, &sec))) return NULL;
+    if (*p == '.' || *p == ':') {
+        const char *start = ++p;
+        if (!(p = parse_digits(p, &frac))) return NULL;
+        for (long digits = p - start; digits < 3; digits++) frac *= 10;
+        for (long digits = p - start; digits > 3; digits--) frac /= 10;
+    }
+    if (*p != ']') return NULL;
+    *ms = (min * 60 + sec) * 1000 + frac;
+    return p + 1;
+}
+
+static int add_line(lrc_t *l, size_t *cap, long ms, size_t text) {
+    if (l->count == *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 64;
+        lrc_line_t *grown = realloc(l->lines, grown_cap * sizeof(*grown));
+        if (!grown) return -1;
+        l->lines = grown;
+        *cap = grown_cap;
+    }
+    l->lines[l->count].ms = (uint32_t)(ms > 0 ? ms : 0);
+    l->lines[l->count].text = (uint32_t)text;
+    l->count++;
+    return 0;
+}
+
+int lrc_load(lrc_t *l, const char *path) {
+    memset(l, 0, sizeof(*l));
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    long size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+    rewind(f);
+    if (size <= 0 || size > LRC_MAX_BYTES) {
+        fclose(f);
+        return -1;
+    }
+    l->text = malloc((size_t)size + 1);
+    size_t len = l->text ? fread(l->text, 1, (size_t)size, f) : 0;
+    fclose(f);
+    if (len == 0) {
+        lrc_free(l);
+        return -1;
+    }
+    l->text[len] = '\0';
+
+    /* Lines are cut in place; the file buffer becomes the text store. */
+    size_t cap = 0;
+    long offset = 0;
+    char *line = l->text;
+    if (strncmp(line, "\xEF\xBB\xBF", 3) == 0) line += 3;
+    while (line < l->text + len) {
+        char *end = strchr(line, '\n');
+        char *next = end ? end + 1 : l->text + len;
+        if (!end) end = l->text + len;
+        *end = '\0';
+        if (end > line && end[-1] == '\r') end[-1] = '\0';
+
+        const char *p = line;
+        size_t first = l->count;
+        long ms;
+        const char *after;
+        while ((after = parse_time_tag(p, &ms)) != NULL) {
+            if (add_line(l, &cap, ms, 0) != 0) {
+                lrc_free(l);
+                return -1;
+            }
+            p = after;
+        }
+        if (l->count > first) {
+            while (*p == ' ' || *p == '\t') p++;
+            for (size_t i = first; i < l->count; i++) l->lines[i].text = (uint32_t)(p - l->text);
+        } else if (strncmp(line, "[offset:", 8) == 0) {
+            offset = strtol(line + 8, NULL, 10);
+        }
+        line = next;
+    }
+
+    if (l->count == 0) {
+        lrc_free(l);
+        return -1;
+    }
+    /* A positive offset makes the lyrics come sooner. */
+    for (size_t i = 0; i < l->count; i++) {
+        long ms = (long)l->lines[i].ms - offset;
+        l->lines[i].ms = (uint32_t)(ms > 0 ? ms : 0);
+    }
+    qsort(l->lines, l->count, sizeof(*l->lines), compare_lines);
+    return 0;
+}
+
+void lrc_free(lrc_t *l) {
+    free(l->lines);
+    free(l->text);
+    memset(l, 0, sizeof(*l));
+}
+
+const char *lrc_line_at(lrc_t *l, unsigned long ms) {
+    if (l->count == 0 || ms < l->lines[0].ms) return NULL;
+
+    size_t c = l->cursor;
+    if (ms >= l->lines[c].ms) {
+        /* Playing forward: still on this line, or moved to the next. */
+        if (c + 1 == l->count || ms < l->lines[c + 1].ms) return l->text + l->lines[c].text;
+        if (c + 2 == l->count || ms < l->lines[c + 2].ms) {
+            l->cursor = c + 1;
+            return l->text + l->lines[c + 1].text;
+        }
+    }
+
+    /* Last line starting at or before ms. */
+    size_t lo = 0;
+    size_t hi = l->count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (l->lines[mid].ms <= ms) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    l->cursor = lo;
+    return l->text + l->lines[lo].text;
+}
@@ -0,0 +1,40 @@
+#ifndef LRC_H
+#define LRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * lrc.h
+ *
+ * Time-synced lyrics from an LRC file: "[mm:ss.xx]text" lines, several
+ * timestamps per line allowed, with the [offset:ms] tag applied.
+ *
+ * The file is parsed once into one text buffer and an array of lines
+ * sorted by time. Lookups keep a cursor on the last line returned, so
+ * while playback moves forward the answer is the same line or the next
+ * one, checked in O(1); anything else (a seek) is a binary search.
+ */
+
+typedef struct
+{
+	uint32_t ms;
+	uint32_t text; /* Offset into lrc_t.text */
+} lrc_line_t;
+
+typedef struct
+{
+	lrc_line_t *lines;
+	size_t count;
+	char *text;
+	size_t cursor;
+} lrc_t;
+
+/* Returns -1 if the file is missing or has no timed lines. */
+int lrc_load(lrc_t *l, const char *path);
+void lrc_free(lrc_t *l);
+
+/* Line showing at position ms, or NULL before the first one. */
+const char *lrc_line_at(lrc_t *l, unsigned long ms);
+
+#endif
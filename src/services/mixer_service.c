@@ -0,0 +1,35 @@
+#include "mixer_service.h"
+
+#include <stdio.h>
+
+/*
+ * Device buffer we ask out123 for. Knowing its size lets positions
+ * subtract what has been handed to the device but not heard yet.
+ */
+#define DEVICE_BUFFER_SEC 0.05
+
+static audio_mixer_t mixer;
+static int mixer_ready = 0;
+
+int mixer_service_init(mixer_output kind, const char *wav_path) {
+    audio_sink_kind sink = AUDIO_SINK_DEVICE;
+    if (kind == MIXER_OUTPUT_NULL) sink = AUDIO_SINK_NULL;
+    if (kind == MIXER_OUTPUT_WAV) sink = AUDIO_SINK_WAV;
+
+    if (audio_mixer_open(&mixer, sink, wav_path, DEVICE_BUFFER_SEC) != 0) {
+        fprintf(stderr, "Failed to open audio output\n");
+        return -1;
+    }
+    mixer_ready = 1;
+    return 0;
+}
+
+void mixer_service_shutdown(void) {
+    if (!mixer_ready) return;
+    audio_mixer_close(&mixer);
+    mixer_ready = 0;
+}
+
+audio_mixer_t *mixer_service_get(void) {
+    return mixer_ready ? &mixer : NULL;
+}
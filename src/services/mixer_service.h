@@ -0,0 +1,30 @@
+#ifndef MIXER_SERVICE_H
+#define MIXER_SERVICE_H
+
+#include "audio/audio_mixer.h"
+
+/*
+ * mixer_service.h
+ *
+ * Owns the one audio output. Services that make sound write into their
+ * own source of this mixer instead of opening the device themselves, so
+ * music, memos, UI sounds and the ringtone can play at the same time.
+ *
+ * NULL and WAV outputs are paced to real time like a device; WAV captures
+ * everything the mixer plays until shutdown.
+ */
+
+typedef enum
+{
+	MIXER_OUTPUT_DEVICE = 0,
+	MIXER_OUTPUT_NULL,
+	MIXER_OUTPUT_WAV
+} mixer_output;
+
+int mixer_service_init(mixer_output kind, const char *wav_path);
+void mixer_service_shutdown(void);
+
+/* NULL if no output could be opened. */
+audio_mixer_t *mixer_service_get(void);
+
+#endif
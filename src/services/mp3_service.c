@@ -1,35 +1,401 @@
 #include "mp3_service.h"
+#include "mixer_service.h"
+#include "settings_service.h"
+#include "string_pool.h"
+#include "track_query.h"
+#include "audio/audio_loudness.h"
+#include "audio/audio_eq.h"
+#include "audio/audio_kernels.h"
+#include "audio/audio_decoder.h"
+#include "audio/audio_mmap.h"
+#include "audio/audio_payload.h"
+#include "audio/audio_resample.h"
+#include "audio/audio_ring.h"
+#include "audio/audio_spectrum.h"
+#include "platform/hardware.h"
 
 #include <dirent.h>
 #include <math.h>
 #include <mpg123.h>
 #include <out123.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
+#define INDEX_CACHE_MAGIC "BHIX"
+#define INDEX_CACHE_VERSION 1u
+#define LOUDNESS_CACHE_MAGIC "BHLN"
+#define LOUDNESS_CACHE_VERSION 2u
+#define CONTENT_CACHE_MAGIC "BHCH"
+#define CONTENT_CACHE_VERSION 1u
+
 #define INITIAL_AUDIO_CAPACITY 16
 
+/* Start opening the next queued track this many seconds before the end. */
+#define PREFETCH_SECONDS 4
+/* Decoded blocks of the next track kept ready for the transition. */
+#define PREROLL_BLOCKS 4
+
+/*
+ * Music is handed to the mixer in its format; every track is resampled
+ * and channel mapped to it on the decoder thread.
+ */
+#define OUTPUT_RATE AUDIO_MIXER_RATE
+#define OUTPUT_CHANNELS AUDIO_MIXER_CHANNELS
+#define OUTPUT_FRAME_BYTES AUDIO_MIXER_FRAME_BYTES
+
+/*
+ * The decoder thread runs ahead of the output thread by up to ring_ms of
+ * audio, always in the output format.
+ */
+#define DEFAULT_RING_MS 500
+#define MIN_RING_MS 50
+#define MAX_RING_MS 5000
+#define RING_BYTES_PER_SEC (OUTPUT_RATE * OUTPUT_FRAME_BYTES)
+#define OUTPUT_CHUNK_BYTES 4096
+#define RING_WAIT_US 2000
+
+/* Spectrum analysis runs at display rate, not once per decoded block. */
+#define ANALYSIS_HZ 30
+
+/*
+ * Gain stage. Volume 1..100 spans VOLUME_RANGE_DB down to 0 dB, 0 mutes;
+ * it is the music source's gain in the mixer. Track gain changes ramp in
+ * GAIN_BLOCK_FRAMES steps, closing a quarter of the gap each step (~40 ms
+ * to settle), so they never click.
+ */
+#define VOLUME_RANGE_DB 50.0
+#define GAIN_BLOCK_FRAMES 64
+
+/*
+ * Untagged tracks are normalized from their measured loudness to the
+ * ReplayGain 2 reference, keeping the true peak under the ceiling.
+ * On battery the analysis job works one slice in LOUDNESS_BATTERY_DUTY.
+ */
+#define LOUDNESS_TARGET_LUFS (-18.0)
+#define LOUDNESS_PEAK_CEILING_DB (-1.0)
+#define LOUDNESS_SAVE_EVERY 8
+#define LOUDNESS_SLICE_BLOCKS 32
+#define LOUDNESS_BATTERY_DUTY 4
+
+/* Content hashing: bytes hashed between throttle checks, and save interval. */
+#define CONTENT_SLICE_BYTES (1024u * 1024u)
+#define CONTENT_SAVE_EVERY 64
+
+/* Cover images larger than this are ignored. */
+#define ART_MAX_BYTES (4u * 1024u * 1024u)
+/* Tracks waiting for an art lookup; the oldest is dropped beyond this. */
+#define ART_REQUESTS 4
+
+/* Head of the next queued track pulled into the page cache while this one plays. */
+#define READAHEAD_BYTES (4u * 1024u * 1024u)
+
+#define BOOKMARK_LOG_MAGIC "BHBM"
+#define BOOKMARK_LOG_VERSION 1u
+#define BOOKMARK_FLUSH_SEC 15	/* Position of the playing track is logged this often */
+#define BOOKMARK_MARGIN_SEC 10	/* Closer than this to either end counts as no bookmark */
+#define BOOKMARK_COMPACT_MIN 256 /* Log records before compaction is considered */
+
+#define PLAY_COUNT_MAGIC "BHPC"
+#define PLAY_COUNT_VERSION 1u
+
+/* Built-in smart playlists. */
+#define RECENT_DAYS 30
+#define MOST_PLAYED_MIN 5
+#define DUPLICATES_MIN 2
+
 static AudioFile *library = NULL;
 static size_t track_count = 0;
 static size_t capacity = 0;
 
 static playback_state state = STOPPED;
 static int current_index = -1;
-static time_t start_time = 0;
-static unsigned pause_offset = 0;
+static char cache_dir[1024] = "";
 
 static pthread_t player_thread;
+static int thread_started = 0; /* Created and not yet joined */
 static int thread_running = 0;
 static int stop_requested = 0;
 static pthread_mutex_t mp3_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static float viz_levels[MP3_VIZ_BINS] = {0};
+static audio_ring_t pcm_ring;
+static unsigned ring_ms = DEFAULT_RING_MS;
+
+/*
+ * Output format handshake. The decoder publishes the device format once,
+ * before any PCM, by bumping format_gen; the output thread starts the
+ * sink when it sees the change.
+ */
+static long out_rate = 0;
+static int out_channels = 0;
+static int out_encoding = 0;
+static atomic_uint format_gen;
+static atomic_uint applied_gen;
+static atomic_int decode_finished;
+static atomic_int output_failed;
+
+/*
+ * A segment is a run of PCM in the ring that starts at a known sample of a
+ * known track: every track start and every seek opens one. The decoder runs
+ * ahead of the speaker, so it keeps its own queue cursor and posts the next
+ * segment; the output thread makes it active when it reaches ring_at, which
+ * is when current_index and the position actually change.
+ */
+typedef struct {
+    size_t pos; /* In the play queue */
+    unsigned gen; /* queue_gen that pos belongs to */
+} queue_cursor_t;
+
+typedef struct {
+    size_t ring_at;
+    int index;
+    queue_cursor_t at;
+    long long sample;
+    long long length; /* Track length in samples, 0 if unknown */
+    long rate;
+    size_t frame_bytes;
+    int gain_q12; /* ReplayGain of the track */
+    int handover; /* Follows the previous track gaplessly */
+} play_segment_t;
+
+static play_segment_t seg_pending;
+static int seg_has_pending = 0;
+static play_segment_t seg_active;
+static long long play_pos_samples = 0;
+
+/* Seek request from the UI, in samples of the audible track. */
+static long long seek_target = -1;
+static int seek_index = -1;
+
+/*
+ * Measured loudness per library track, filled by the background job from
+ * <audio_root>/.cache/loudness.bin and by analysis. Guarded by mp3_lock.
+ */
+typedef struct {
+    int known; /* 1 measured, -1 failed to decode, 0 not yet */
+    float lufs;
+    float peak_db;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint32_t seconds; /* Decoded length */
+} track_loudness_t;
+
+typedef struct {
+    uint64_t path_hash;
+    uint64_t file_size;
+    int64_t file_mtime;
+    float lufs;
+    float peak_db;
+    uint32_t seconds;
+    uint32_t reserved;
+} loudness_record_t;
+
+static track_loudness_t *loudness = NULL;
+static pthread_t loudness_thread;
+static int loudness_started = 0;
+static atomic_int loudness_quit;
+
+/*
+ * Hash of each track's audio payload (tags cut off), 0 until known, for
+ * finding copies of one song saved under several folders. Hashed by the
+ * background job before loudness and cached in <audio_root>/.cache/
+ * content.bin by inode, size and mtime. `content_group` is the lowest
+ * library index with the same hash. Guarded by mp3_lock.
+ */
+typedef struct {
+    uint64_t inode;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t hash;
+} content_record_t;
+
+static content_record_t *content = NULL;
+static uint32_t *content_group = NULL;
+
+/*
+ * Resume bookmarks: per library track, the audible position in output
+ * samples when it was last left, 0 for none. Guarded by mp3_lock; the
+ * audio threads only touch memory. The bookmark thread appends changed
+ * entries to <audio_root>/.cache/bookmarks.log in batches and rewrites the
+ * log with only live entries once it has grown to twice their number.
+ */
+typedef struct {
+    uint64_t id;
+    int64_t sample;
+} bookmark_record_t;
+
+static int64_t *bookmarks = NULL;
+static unsigned char *bookmark_dirty = NULL;
+static pthread_cond_t bookmark_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t bookmark_thread;
+static int bookmark_started = 0;
+static int bookmark_quit = 0;
+static int bookmark_flush_now = 0;
+static size_t bookmark_log_records = 0;
+
+/*
+ * Cover art per library track: the front-cover APIC frame, copied once to
+ * <audio_root>/.cache/art/<key>, else folder.jpg beside the track. The key
+ * is a hash of the image bytes, so an album shares one thumbnail. The
+ * player queues the tracks it opens for the art thread, and the library
+ * job fills in every track it analyses; the audio threads never do the
+ * file work. Guarded by mp3_lock.
+ */
+typedef enum {
+    ART_UNKNOWN = 0,
+    ART_EMBEDDED,
+    ART_FOLDER,
+    ART_NONE
+} art_source;
+
+typedef struct {
+    uint64_t key;
+    unsigned char source;
+} track_art_t;
+
+static track_art_t *art = NULL;
+static int art_requests[ART_REQUESTS]; /* Oldest first */
+static size_t art_request_count = 0;
+static pthread_cond_t art_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t art_thread;
+static int art_started = 0;
+static int art_quit = 0;
+
+/*
+ * Display order. Titles, artists and genres are interned in `strings`,
+ * which AudioFile points into, and track_names holds each track's ids.
+ * The sort thread orders tracks by the strings' collation ranks and swaps
+ * a new `sorted` in under mp3_lock; the pool itself is fixed after init.
+ */
+typedef struct {
+    uint32_t title;
+    uint32_t author;
+    uint32_t genre;
+} track_names_t;
+
+typedef struct {
+    uint32_t key[3];
+    uint32_t index;
+} sort_item_t;
+
+static string_pool_t strings;
+static track_names_t *track_names = NULL;
+static uint32_t *sorted = NULL;  /* Library indices in display order */
+static mp3_sort_order sort_order = MP3_SORT_FOLDER;  /* Order of sorted */
+static mp3_sort_order sort_wanted = MP3_SORT_FOLDER;
+static pthread_t sort_thread;
+static int sort_started = 0; /* Created and not yet joined */
+static int sort_running = 0;
+static int sort_quit = 0;
+
+/*
+ * Smart playlists: queries over `columns`, one row per library track,
+ * each keeping its result bitset current as rows change (a play counted,
+ * a duration measured). Durations and file times come from the loudness
+ * job, copy counts from the content hashes; play counts are saved to
+ * <audio_root>/.cache/plays.bin by the bookmark thread. `listed` is the
+ * display order filtered by the chosen playlist. All guarded by mp3_lock.
+ */
+typedef struct {
+    track_query_t query;
+    track_bitset_t hits;
+    int grouped; /* Listed with copies of one song together */
+} smart_playlist_t;
+
+typedef struct {
+    uint64_t id;
+    uint32_t plays;
+    uint32_t reserved;
+} play_count_record_t;
+
+static track_table_t columns;
+static smart_playlist_t *playlists = NULL;
+static size_t playlist_count = 0;
+static int plays_dirty = 0;
+static int listed_playlist = -1; /* -1 for the whole library */
+static uint32_t *listed = NULL;
+static size_t listed_count = 0;
+static int listed_stale = 1;
+
+static atomic_uint master_volume = 80;
+static atomic_int replay_gain_on = 1;
+
+/*
+ * Equalizer presets, gains per audio_eq_band_hz band. "Custom" reads its
+ * gains from the eq_* settings. The output thread picks up eq_gains
+ * (guarded by mp3_lock) whenever eq_gen moves.
+ */
+typedef struct {
+    const char *name;
+    float gains_db[AUDIO_EQ_BANDS];
+} eq_preset_t;
+
+static const eq_preset_t eq_presets[] = {
+    { "Flat",     { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
+    { "Bass",     { 6, 5, 4, 2, 0, 0, 0, 0, 0, 0 } },
+    { "Treble",   { 0, 0, 0, 0, 0, 0, 2, 4, 5, 6 } },
+    { "Vocal",    { -2, -2, -1, 0, 2, 3, 3, 2, 0, -1 } },
+    { "Loudness", { 5, 4, 2, 0, -1, -1, 0, 2, 4, 5 } },
+    { "Custom",   { 0 } },
+};
+
+#define EQ_PRESET_COUNT ((int)(sizeof(eq_presets) / sizeof(eq_presets[0])))
+#define EQ_PRESET_CUSTOM (EQ_PRESET_COUNT - 1)
+
+static const char *const eq_band_keys[AUDIO_EQ_BANDS] = {
+    "eq_31", "eq_62", "eq_125", "eq_250", "eq_500", "eq_1k", "eq_2k", "eq_4k", "eq_8k", "eq_16k",
+};
+
+static atomic_int eq_preset;
+static atomic_uint eq_gen;
+static float eq_gains[AUDIO_EQ_BANDS];
+
+/* Ring flush handshake used by seeks, same scheme as format_gen. */
+static atomic_uint flush_gen;
+static atomic_uint flushed_gen;
+
+/* Engine counters, written by the audio threads and read by the UI. */
+static atomic_uint stat_bytes_per_sec;
+static atomic_ulong stat_underruns;
+static atomic_ulong stat_blocks;
+static atomic_uint stat_decode_us_last;
+static atomic_uint stat_decode_us_avg;
+static atomic_uint stat_decode_us_max;
+static atomic_uint stat_eq_us_per_sec;
+
+/*
+ * Visualizer bands. The output thread feeds the analyzer's tap, the
+ * analysis thread turns it into bands, and the UI reads the published
+ * copy without ever waiting on either audio thread.
+ */
+static audio_spectrum_t spectrum;
+static int spectrum_ready = 0;
+static atomic_int analysis_quit;
+
+/*
+ * Play queue, guarded by mp3_lock. queue.pos is the audible track; the
+ * player thread keeps its own cursor and asks for the track after it
+ * ahead of time so the transition is gapless. queue_gen changes whenever
+ * positions are renumbered (new queue, shuffle toggled).
+ */
+static play_queue_t queue;
+static unsigned queue_gen = 0;
+
+/*
+ * Track id -> library index, open addressing with linear probing. Slots
+ * hold index + 1, 0 when empty; the table is at most half full.
+ */
+static uint32_t *id_slots = NULL;
+static size_t id_slot_mask = 0;
 
 static int ensure_capacity(void) {
     if (track_count < capacity) return 0;
@@ -41,6 +407,13 @@ static int ensure_capacity(void) {
     return 0;
 }
 
+/* Interned copy of an owned string, which is freed; NULL if out of memory. */
+static char *intern(char *s) {
+    int id = s ? string_pool_intern(&strings, s) : -1;
+    free(s);
+    return id >= 0 ? (char *)string_pool_get(&strings, (uint32_t)id) : NULL;
+}
+
 static char *title_from_filename(const char *filename) {
     char *copy = strdup(filename);
     if (!copy) return strdup("Unknown");
@@ -54,161 +427,1809 @@ static char *title_from_filename(const char *filename) {
     return copy;
 }
 
+/* Path order is genre/author/file order, which keeps album tracks together. */
+static int compare_tracks_by_path(const void *a, const void *b) {
+    const AudioFile *ta = (const AudioFile *)a;
+    const AudioFile *tb = (const AudioFile *)b;
+    return strcmp(ta->path, tb->path);
+}
+
+/* Only call while no analysis thread is running. */
 static void clear_visualizer(void) {
-    for (int i = 0; i < MP3_VIZ_BINS; i++) viz_levels[i] = 0.0f;
+    if (spectrum_ready) audio_spectrum_reset(&spectrum);
+}
+
+/*
+ * One open decoder. The next track is opened while the current one is still
+ * playing and its first blocks are decoded into preroll, so the switch-over
+ * writes straight into the already running output device.
+ */
+typedef struct {
+    audio_decoder_t dec;
+    mpg123_handle *mh;       /* MP3 tracks: tags and frame index, else NULL */
+    int index;
+    unsigned char *preroll;
+    size_t preroll_fill;
+    long long indexed_bytes; /* File span covered by the cached frame index */
+    int gain_q12;            /* ReplayGain, else from measured loudness, else unity */
+} track_decoder_t;
+
+/*
+ * Frame index cache. mpg123 can only seek as far as its frame index
+ * reaches and otherwise scans the file linearly. The index of every track
+ * we decode is saved under <audio_root>/.cache, keyed by path and
+ * invalidated by size/mtime, so a later seek anywhere is a direct jump.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t file_size;
+    int64_t file_mtime;
+    int64_t step;
+    uint64_t fill;
+} index_cache_header_t;
+
+static uint64_t hash_path(const char *path) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t hash_bytes(const unsigned char *p, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1; /* 0 means no art */
+}
+
+static int index_cache_path(const char *track_path, char *out, size_t out_size) {
+    if (cache_dir[0] == '\0') return -1;
+    snprintf(out, out_size, "%s/%016llx.idx", cache_dir, (unsigned long long)hash_path(track_path));
+    return 0;
+}
+
+static void index_cache_load(track_decoder_t *td, const char *track_path) {
+    char path[1200];
+    struct stat st;
+    if (!td->mh || index_cache_path(track_path, path, sizeof(path)) != 0 || stat(track_path, &st) != 0) return;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+
+    index_cache_header_t hdr;
+    off_t *offsets = NULL;
+    int64_t *raw = NULL;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, INDEX_CACHE_MAGIC, 4) != 0 ||
+        hdr.version != INDEX_CACHE_VERSION || hdr.file_size != (uint64_t)st.st_size ||
+        hdr.file_mtime != (int64_t)st.st_mtime || hdr.fill == 0 || hdr.fill > (1u << 24)) {
+        goto done;
+    }
+
+    raw = malloc(hdr.fill * sizeof(int64_t));
+    offsets = malloc(hdr.fill * sizeof(off_t));
+    if (!raw || !offsets || fread(raw, sizeof(int64_t), hdr.fill, f) != hdr.fill) goto done;
+    for (uint64_t i = 0; i < hdr.fill; i++) offsets[i] = (off_t)raw[i];
+
+    if (mpg123_set_index(td->mh, offsets, (off_t)hdr.step, (size_t)hdr.fill) == MPG123_OK) {
+        td->indexed_bytes = (long long)raw[hdr.fill - 1];
+    }
+
+done:
+    free(raw);
+    free(offsets);
+    fclose(f);
+}
+
+/* Write the index if decoding or seeking got further than the cached one. */
+static void index_cache_save(track_decoder_t *td, const char *track_path) {
+    off_t *offsets = NULL;
+    off_t step = 0;
+    size_t fill = 0;
+    if (!td->mh || mpg123_index(td->mh, &offsets, &step, &fill) != MPG123_OK || fill == 0) return;
+    if ((long long)offsets[fill - 1] <= td->indexed_bytes) return;
+
+    char path[1200];
+    char tmp[1224];
+    struct stat st;
+    if (index_cache_path(track_path, path, sizeof(path)) != 0 || stat(track_path, &st) != 0) return;
+    mkdir(cache_dir, 0755);
+    /* The loudness job and the player can save the same track. */
+    static atomic_uint tmp_seq;
+    snprintf(tmp, sizeof(tmp), "%s.%u.tmp", path, atomic_fetch_add(&tmp_seq, 1));
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return;
+
+    index_cache_header_t hdr;
+    memcpy(hdr.magic, INDEX_CACHE_MAGIC, 4);
+    hdr.version = INDEX_CACHE_VERSION;
+    hdr.file_size = (uint64_t)st.st_size;
+    hdr.file_mtime = (int64_t)st.st_mtime;
+    hdr.step = (int64_t)step;
+    hdr.fill = (uint64_t)fill;
+
+    int ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+    for (size_t i = 0; ok && i < fill; i++) {
+        int64_t v = (int64_t)offsets[i];
+        ok = (fwrite(&v, sizeof(v), 1, f) == 1);
+    }
+    if (fclose(f) != 0) ok = 0;
+
+    if (ok && rename(tmp, path) == 0) {
+        td->indexed_bytes = (long long)offsets[fill - 1];
+    } else {
+        remove(tmp);
+    }
+}
+
+static void track_decoder_close(track_decoder_t *td) {
+    if (td->index >= 0) index_cache_save(td, library[td->index].path);
+    audio_decoder_close(&td->dec);
+    free(td->preroll);
+    memset(td, 0, sizeof(*td));
+    td->index = -1;
+}
+
+static int gain_db_to_q12(double db) {
+    double g = pow(10.0, db / 20.0) * AUDIO_GAIN_UNITY;
+    if (g > AUDIO_GAIN_MAX) g = AUDIO_GAIN_MAX;
+    return (int)(g + 0.5);
+}
+
+static int volume_to_q12(unsigned percent) {
+    if (percent == 0) return 0;
+    return gain_db_to_q12(VOLUME_RANGE_DB * ((double)percent / 100.0 - 1.0));
+}
+
+static int text_is(const mpg123_string *s, const char *want) {
+    return s && s->p && s->fill > 0 && strcasecmp(s->p, want) == 0;
+}
+
+/*
+ * ReplayGain from the ID3v2 TXXX frames most taggers write, -1 if there
+ * are none. The gain is capped so the tagged peak stays below full scale;
+ * the limiter catches anything the tags get wrong.
+ */
+static int read_replay_gain(mpg123_handle *mh) {
+    mpg123_id3v2 *v2 = NULL;
+    if (!(mpg123_meta_check(mh) & MPG123_ID3) || mpg123_id3(mh, NULL, &v2) != MPG123_OK || !v2) {
+        return -1;
+    }
+
+    double gain_db = 0.0;
+    double peak = 0.0;
+    int found = 0;
+    for (size_t i = 0; i < v2->extras; i++) {
+        const mpg123_text *t = &v2->extra[i];
+        if (!t->text.p) continue;
+        if (text_is(&t->description, "replaygain_track_gain")) {
+            gain_db = strtod(t->text.p, NULL);
+            found = 1;
+        } else if (text_is(&t->description, "replaygain_track_peak")) {
+            peak = strtod(t->text.p, NULL);
+        }
+    }
+    if (!found) return -1;
+
+    int gain = gain_db_to_q12(gain_db);
+    if (peak > 0.0 && gain * peak > AUDIO_GAIN_UNITY) gain = (int)(AUDIO_GAIN_UNITY / peak);
+    return gain;
+}
+
+/* Gain from the analysed loudness, for tracks without tags. */
+static int measured_gain(int index) {
+    pthread_mutex_lock(&mp3_lock);
+    track_loudness_t l = loudness ? loudness[index] : (track_loudness_t){0};
+    pthread_mutex_unlock(&mp3_lock);
+    if (l.known != 1 || l.lufs <= AUDIO_LOUDNESS_SILENT) return AUDIO_GAIN_UNITY;
+
+    double gain_db = LOUDNESS_TARGET_LUFS - l.lufs;
+    if (l.peak_db + gain_db > LOUDNESS_PEAK_CEILING_DB) gain_db = LOUDNESS_PEAK_CEILING_DB - l.peak_db;
+    return gain_db_to_q12(gain_db);
+}
+
+static void art_cache_path(uint64_t key, char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/art/%016llx", cache_dir, (unsigned long long)key);
+}
+
+static void folder_art_path(const char *track_path, char *out, size_t out_size) {
+    const char *slash = strrchr(track_path, '/');
+    int dir = slash ? (int)(slash - track_path) : 1;
+    snprintf(out, out_size, "%.*s/folder.jpg", dir, slash ? track_path : ".");
+}
+
+/* Front cover if tagged as one, else the first picture. */
+static const mpg123_picture *embedded_picture(mpg123_handle *mh) {
+    mpg123_id3v2 *v2 = NULL;
+    if (!(mpg123_meta_check(mh) & MPG123_ID3) || mpg123_id3(mh, NULL, &v2) != MPG123_OK || !v2) return NULL;
+
+    const mpg123_picture *found = NULL;
+    for (size_t i = 0; i < v2->pictures; i++) {
+        const mpg123_picture *pic = &v2->picture[i];
+        if (!pic->data || pic->size == 0 || pic->size > ART_MAX_BYTES) continue;
+        if (pic->type == mpg123_id3_pic_front_cover) return pic;
+        if (!found) found = pic;
+    }
+    return found;
+}
+
+/* Copy embedded art into the cache unless an earlier track already did. */
+static int store_embedded_art(const mpg123_picture *pic, uint64_t key) {
+    char path[1100];
+    char tmp[1124];
+    struct stat st;
+    art_cache_path(key, path, sizeof(path));
+    if (stat(path, &st) == 0) return 0;
+
+    char dir[1100];
+    snprintf(dir, sizeof(dir), "%s/art", cache_dir);
+    mkdir(cache_dir, 0755);
+    mkdir(dir, 0755);
+    static atomic_uint tmp_seq;
+    snprintf(tmp, sizeof(tmp), "%s.%u.tmp", path, atomic_fetch_add(&tmp_seq, 1));
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    int ok = fwrite(pic->data, 1, pic->size, f) == pic->size;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t hash_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    long size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+    rewind(f);
+    unsigned char *data = (size > 0 && size <= (long)ART_MAX_BYTES) ? malloc((size_t)size) : NULL;
+    uint64_t key = 0;
+    if (data && fread(data, 1, (size_t)size, f) == (size_t)size) key = hash_bytes(data, (size_t)size);
+    free(data);
+    fclose(f);
+    return key;
+}
+
+/*
+ * Called with the track's ID3, if any, parsed; the file work is done
+ * unlocked. Not for the audio threads: it may hash and copy megabytes.
+ */
+static void find_art(mpg123_handle *mh, int index) {
+    pthread_mutex_lock(&mp3_lock);
+    int known = !art || art[index].source != ART_UNKNOWN;
+    pthread_mutex_unlock(&mp3_lock);
+    if (known) return;
+
+    track_art_t found = { 0, ART_NONE };
+    const mpg123_picture *pic = mh ? embedded_picture(mh) : NULL;
+    if (pic) {
+        found.key = hash_bytes(pic->data, pic->size);
+        if (store_embedded_art(pic, found.key) == 0) found.source = ART_EMBEDDED;
+    }
+    if (found.source == ART_NONE) {
+        char path[1100];
+        folder_art_path(library[index].path, path, sizeof(path));
+        found.key = hash_file(path);
+        if (found.key) found.source = ART_FOLDER;
+    }
+
+    pthread_mutex_lock(&mp3_lock);
+    if (art) art[index] = found;
+    pthread_mutex_unlock(&mp3_lock);
+}
+
+/* Queue a track's art lookup for the art thread unless it is known or queued. */
+static void request_art(int index) {
+    pthread_mutex_lock(&mp3_lock);
+    int wanted = art && art[index].source == ART_UNKNOWN;
+    for (size_t i = 0; i < art_request_count && wanted; i++) wanted = art_requests[i] != index;
+    if (wanted) {
+        if (art_request_count == ART_REQUESTS) {
+            art_request_count--;
+            memmove(art_requests, art_requests + 1, art_request_count * sizeof(*art_requests));
+        }
+        art_requests[art_request_count++] = index;
+        pthread_cond_signal(&art_cond);
+    }
+    pthread_mutex_unlock(&mp3_lock);
+}
+
+/* Art thread: opens each queued track on its own to read its tags. */
+static void *art_thread_fn(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&mp3_lock);
+    for (;;) {
+        while (!art_quit && art_request_count == 0) pthread_cond_wait(&art_cond, &mp3_lock);
+        if (art_quit) break;
+        int index = art_requests[0];
+        art_request_count--;
+        memmove(art_requests, art_requests + 1, art_request_count * sizeof(*art_requests));
+        pthread_mutex_unlock(&mp3_lock);
+
+        audio_decoder_t dec;
+        if (audio_decoder_open(&dec, library[index].path) == 0) {
+            find_art(audio_decoder_mpg123_handle(&dec), index);
+            audio_decoder_close(&dec);
+        } else {
+            find_art(NULL, index);
+        }
+        pthread_mutex_lock(&mp3_lock);
+    }
+    pthread_mutex_unlock(&mp3_lock);
+    return NULL;
+}
+
+static int track_decoder_open(track_decoder_t *td, int index) {
+    memset(td, 0, sizeof(*td));
+    td->index = -1;
+    if (index < 0 || (size_t)index >= track_count) return -1;
+    if (audio_decoder_open(&td->dec, library[index].path) != 0) return -1;
+
+    td->mh = audio_decoder_mpg123_handle(&td->dec);
+    index_cache_load(td, library[index].path);
+    td->gain_q12 = td->mh ? read_replay_gain(td->mh) : -1;
+    if (td->gain_q12 < 0) td->gain_q12 = measured_gain(index);
+    td->index = index;
+    return 0;
+}
+
+/* Copy the first PREROLL_BLOCKS blocks of an opened track into memory. */
+static int track_decoder_preroll(track_decoder_t *td) {
+    size_t capacity_bytes = 0;
+    td->preroll_fill = 0;
+    for (int blocks = 0; blocks < PREROLL_BLOCKS;) {
+        const unsigned char *pcm;
+        size_t bytes;
+        int r = audio_decoder_read(&td->dec, &pcm, &bytes);
+        if (r == AUDIO_DECODER_NEW_FORMAT) continue;
+        if (r == AUDIO_DECODER_ERROR) return -1;
+        if (td->preroll_fill + bytes > capacity_bytes) {
+            size_t grown_size = (td->preroll_fill + bytes) * 2;
+            unsigned char *grown = realloc(td->preroll, grown_size);
+            if (!grown) return -1;
+            td->preroll = grown;
+            capacity_bytes = grown_size;
+        }
+        if (bytes > 0) memcpy(td->preroll + td->preroll_fill, pcm, bytes);
+        td->preroll_fill += bytes;
+        blocks++;
+        if (r == AUDIO_DECODER_DONE) break;
+    }
+    return 0;
+}
+
+/* True once fewer than PREFETCH_SECONDS of the current track remain. */
+static int track_decoder_near_end(track_decoder_t *td) {
+    long long length = audio_decoder_length(&td->dec);
+    long long pos = audio_decoder_tell(&td->dec);
+    if (length <= 0 || pos < 0) return 1;
+    return (length - pos) <= (long long)td->dec.rate * PREFETCH_SECONDS;
+}
+
+/* Re-find a cursor's track if the queue was renumbered since. Call with mp3_lock held. */
+static void queue_sync(queue_cursor_t *at, int index) {
+    if (at->gen == queue_gen) return;
+    int pos = play_queue_find(&queue, (uint32_t)index);
+    if (pos >= 0) at->pos = (size_t)pos;
+    at->gen = queue_gen;
+}
+
+/*
+ * The track that plays after the one at *at (whose library index is
+ * index) and its queue position, or -1 at the end of the queue.
+ */
+static int queue_following(queue_cursor_t *at, int index, queue_cursor_t *next) {
+    pthread_mutex_lock(&mp3_lock);
+    queue_sync(at, index);
+    int following = -1;
+    *next = *at;
+    if (play_queue_next(&queue, at->pos, &next->pos) == 0) following = play_queue_at(&queue, next->pos);
+    pthread_mutex_unlock(&mp3_lock);
+    return following;
+}
+
+static int should_stop(void) {
+    pthread_mutex_lock(&mp3_lock);
+    int stop = stop_requested;
+    pthread_mutex_unlock(&mp3_lock);
+    return stop || atomic_load(&output_failed);
+}
+
+static unsigned elapsed_us(const struct timespec *a, const struct timespec *b) {
+    long long us = (long long)(b->tv_sec - a->tv_sec) * 1000000LL + (b->tv_nsec - a->tv_nsec) / 1000;
+    return us < 0 ? 0u : (unsigned)us;
+}
+
+static void record_decode_time(unsigned us) {
+    unsigned avg = atomic_load_explicit(&stat_decode_us_avg, memory_order_relaxed);
+    avg = (avg == 0) ? us : (avg * 7 + us) / 8;
+    atomic_store_explicit(&stat_decode_us_last, us, memory_order_relaxed);
+    atomic_store_explicit(&stat_decode_us_avg, avg, memory_order_relaxed);
+    if (us > atomic_load_explicit(&stat_decode_us_max, memory_order_relaxed)) {
+        atomic_store_explicit(&stat_decode_us_max, us, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&stat_blocks, 1, memory_order_relaxed);
+}
+
+static int seek_requested(void) {
+    pthread_mutex_lock(&mp3_lock);
+    int pending = (seek_target >= 0);
+    pthread_mutex_unlock(&mp3_lock);
+    return pending;
+}
+
+/*
+ * Decoder side: block until all bytes are in the ring. Returns -1 when
+ * stopped, 1 when a seek arrived while the ring was full (the rest would
+ * be flushed anyway, so it is dropped).
+ */
+static int ring_push(const unsigned char *pcm, size_t bytes) {
+    while (bytes > 0) {
+        size_t written = audio_ring_write(&pcm_ring, pcm, bytes);
+        pcm += written;
+        bytes -= written;
+        if (bytes == 0) break;
+        if (should_stop()) return -1;
+        if (seek_requested()) return 1;
+        usleep(RING_WAIT_US);
+    }
+    return 0;
+}
+
+static void publish_format(long rate, int channels, int encoding) {
+    out_rate = rate;
+    out_channels = channels;
+    out_encoding = encoding;
+    atomic_store(&stat_bytes_per_sec, (unsigned)(rate * channels * out123_encsize(encoding)));
+    atomic_fetch_add_explicit(&format_gen, 1, memory_order_release);
+}
+
+/* Record where a track was left, in output samples. Call with mp3_lock held. */
+static void set_bookmark(int index, long long sample, long long length) {
+    if (!bookmarks || index < 0 || (size_t)index >= track_count) return;
+    long long margin = (long long)BOOKMARK_MARGIN_SEC * OUTPUT_RATE;
+    if (sample < margin || (length > 0 && sample > length - margin)) sample = 0;
+    if (bookmarks[index] == sample) return;
+    bookmarks[index] = sample;
+    bookmark_dirty[index] = 1;
+}
+
+/* Bookmark the audible position. Call with mp3_lock held. */
+static void remember_position(void) {
+    if (current_index < 0 || seg_active.frame_bytes == 0 || stop_requested) return;
+    set_bookmark(current_index, play_pos_samples, seg_active.length);
+}
+
+/* Change one track's column and re-test it in every playlist. Call with mp3_lock held. */
+static void set_column(int index, track_column column, uint32_t value) {
+    if (index < 0 || (size_t)index >= columns.rows || columns.col[column][index] == value) return;
+    columns.col[column][index] = value;
+    for (size_t p = 0; p < playlist_count; p++) {
+        int had = track_bitset_test(&playlists[p].hits, (size_t)index);
+        int has = track_query_update(&playlists[p].query, &columns, &playlists[p].hits, (size_t)index);
+        if (had != has && (int)p == listed_playlist) listed_stale = 1;
+    }
+}
+
+/* A track was heard to its end. Call with mp3_lock held. */
+static void count_play(int index) {
+    if (index < 0 || (size_t)index >= columns.rows) return;
+    set_column(index, TRACK_COL_PLAYS, columns.col[TRACK_COL_PLAYS][index] + 1);
+    plays_dirty = 1;
+}
+
+/* Make the pending segment the audible one. Call with mp3_lock held. */
+static void activate_segment(void) {
+    /* A track handing over to another was heard to the end. */
+    if (seg_active.frame_bytes > 0 && seg_active.index != seg_pending.index) set_bookmark(seg_active.index, 0, 0);
+    if (seg_active.frame_bytes > 0 && seg_pending.handover) count_play(seg_active.index);
+    seg_has_pending = 0;
+    seg_active = seg_pending;
+    queue_sync(&seg_active.at, seg_active.index);
+    queue.pos = seg_active.at.pos;
+    current_index = seg_active.index;
+}
+
+/*
+ * Decoder side: the next PCM written to the ring starts this segment.
+ * sample is in source samples; segments are kept in output samples.
+ */
+static void post_segment(track_decoder_t *td, const queue_cursor_t *at, long long sample, int handover) {
+    long long length = audio_decoder_length(&td->dec);
+
+    pthread_mutex_lock(&mp3_lock);
+    /* The previous segment never reached the speaker; apply it now. */
+    if (seg_has_pending) activate_segment();
+    seg_pending.ring_at = atomic_load(&pcm_ring.head);
+    seg_pending.index = td->index;
+    seg_pending.at = *at;
+    seg_pending.sample = sample * OUTPUT_RATE / td->dec.rate;
+    seg_pending.length = length * OUTPUT_RATE / td->dec.rate;
+    seg_pending.rate = OUTPUT_RATE;
+    seg_pending.frame_bytes = OUTPUT_FRAME_BYTES;
+    seg_pending.gain_q12 = atomic_load(&replay_gain_on) ? td->gain_q12 : AUDIO_GAIN_UNITY;
+    seg_pending.handover = handover;
+    seg_has_pending = 1;
+    pthread_mutex_unlock(&mp3_lock);
+}
+
+/*
+ * Output side: activate a segment once playback reaches it, then publish
+ * the audible position. latency_bytes is what the device holds but has
+ * not played yet. Returns the active track's gain.
+ */
+static int update_position(size_t consumed_to, size_t latency_bytes) {
+    pthread_mutex_lock(&mp3_lock);
+    if (seg_has_pending && !stop_requested && (ptrdiff_t)(consumed_to - seg_pending.ring_at) >= 0) {
+        activate_segment();
+    }
+    if (seg_active.frame_bytes > 0 && !stop_requested) {
+        long long played = (long long)((consumed_to - seg_active.ring_at) / seg_active.frame_bytes);
+        played -= (long long)(latency_bytes / seg_active.frame_bytes);
+        play_pos_samples = seg_active.sample + (played > 0 ? played : 0);
+    }
+    int gain = seg_active.frame_bytes > 0 ? seg_active.gain_q12 : AUDIO_GAIN_UNITY;
+    pthread_mutex_unlock(&mp3_lock);
+    return gain;
+}
+
+/* Apply the track gain, ramping from *gain toward the target. */
+static void apply_gain(const int16_t *in, int16_t *out, size_t samples, int track_gain, int *gain) {
+    const size_t block = GAIN_BLOCK_FRAMES * OUTPUT_CHANNELS;
+    for (size_t off = 0; off < samples; off += block) {
+        if (*gain != track_gain) {
+            int step = (track_gain - *gain) / 4;
+            if (step == 0) step = (track_gain > *gain) ? 1 : -1;
+            *gain += step;
+        }
+        size_t len = (samples - off < block) ? samples - off : block;
+        audio_gain_s16(in + off, out + off, len, *gain);
+    }
+}
+
+/*
+ * Output thread: drains the ring through the EQ and track gain into the
+ * mixer's music source. Everything it hands over is already decoded, so a
+ * slow decode block only lowers the fill level instead of reaching the
+ * speaker. Volume and ducking are applied by the mixer.
+ */
+static void *output_thread_fn(void *arg) {
+    (void)arg;
+    audio_mixer_t *mixer = mixer_service_get();
+    if (!mixer) {
+        atomic_store(&output_failed, 1);
+        return NULL;
+    }
+
+    unsigned device_gen = 0;
+    unsigned flushed = 0;
+    size_t latency = 0;
+    int16_t gained[OUTPUT_CHUNK_BYTES / sizeof(int16_t)];
+    audio_eq_t eq;
+    unsigned eq_applied = 0;
+    unsigned long long eq_us = 0;
+    size_t eq_frames = 0;
+    int track_gain = AUDIO_GAIN_UNITY;
+    int gain = -1;
+    int paused_locally = 0;
+    int primed = 0;
+    int stopping = 0;
+    audio_eq_init(&eq, OUTPUT_RATE);
+    audio_mixer_pause(mixer, AUDIO_SOURCE_MUSIC, 0);
+
+    while (1) {
+        pthread_mutex_lock(&mp3_lock);
+        stopping = stop_requested;
+        playback_state st = state;
+        pthread_mutex_unlock(&mp3_lock);
+
+        if (stopping) break;
+
+        /* A seek throws away everything decoded before it, here and in the mixer. */
+        unsigned fg = atomic_load(&flush_gen);
+        if (fg != flushed) {
+            audio_ring_consume(&pcm_ring, audio_ring_readable(&pcm_ring));
+            audio_mixer_drop(mixer, AUDIO_SOURCE_MUSIC);
+            audio_eq_reset(&eq);
+            latency = 0;
+            primed = 0;
+            flushed = fg;
+            atomic_store(&flushed_gen, fg);
+        }
+
+        if (st == PAUSED) {
+            if (!paused_locally) {
+                audio_mixer_pause(mixer, AUDIO_SOURCE_MUSIC, 1);
+                paused_locally = 1;
+            }
+            track_gain = update_position(atomic_load(&pcm_ring.tail), latency);
+            usleep(20000);
+            continue;
+        }
+
+        if (paused_locally) {
+            audio_mixer_pause(mixer, AUDIO_SOURCE_MUSIC, 0);
+            paused_locally = 0;
+        }
+
+        size_t run = 0;
+        const unsigned char *pcm = audio_ring_peek(&pcm_ring, &run);
+        unsigned gen = atomic_load_explicit(&format_gen, memory_order_acquire);
+
+        /* The format is fixed to the mixer's; only the spectrum needs to know. */
+        if (gen != device_gen) {
+            if (out_rate != OUTPUT_RATE || out_channels != OUTPUT_CHANNELS) {
+                atomic_store(&output_failed, 1);
+                break;
+            }
+            device_gen = gen;
+            if (spectrum_ready) audio_spectrum_set_rate(&spectrum, out_rate);
+            atomic_store(&applied_gen, gen);
+            continue;
+        }
+
+        if (run == 0) {
+            if (atomic_load(&decode_finished)) break;
+            if (primed) {
+                atomic_fetch_add_explicit(&stat_underruns, 1, memory_order_relaxed);
+                primed = 0;
+            }
+            usleep(RING_WAIT_US);
+            continue;
+        }
+
+        if (run > OUTPUT_CHUNK_BYTES) run = OUTPUT_CHUNK_BYTES;
+        size_t room = audio_mixer_writable(mixer, AUDIO_SOURCE_MUSIC);
+        if (run > room) run = room;
+        run -= run % OUTPUT_FRAME_BYTES;
+        if (run == 0) {
+            latency = audio_mixer_latency(mixer, AUDIO_SOURCE_MUSIC);
+            if (spectrum_ready) audio_spectrum_set_latency(&spectrum, latency / OUTPUT_FRAME_BYTES);
+            track_gain = update_position(atomic_load(&pcm_ring.tail), latency);
+            usleep(RING_WAIT_US);
+            continue;
+        }
+
+        unsigned eg = atomic_load(&eq_gen);
+        if (eg != eq_applied) {
+            float gains[AUDIO_EQ_BANDS];
+            pthread_mutex_lock(&mp3_lock);
+            memcpy(gains, eq_gains, sizeof(gains));
+            pthread_mutex_unlock(&mp3_lock);
+            audio_eq_set(&eq, gains);
+            eq_applied = eg;
+        }
+
+        /* EQ cost is published per second of audio it has processed. */
+        struct timespec t0, t1;
+        size_t frames = run / OUTPUT_FRAME_BYTES;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        audio_eq_process(&eq, (const int16_t *)pcm, gained, frames);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        eq_us += elapsed_us(&t0, &t1);
+        eq_frames += frames;
+        if (eq_frames >= OUTPUT_RATE) {
+            atomic_store_explicit(&stat_eq_us_per_sec, (unsigned)(eq_us * OUTPUT_RATE / eq_frames), memory_order_relaxed);
+            eq_us = 0;
+            eq_frames = 0;
+        }
+
+        if (gain < 0) gain = track_gain;
+        apply_gain(gained, gained, run / sizeof(int16_t), track_gain, &gain);
+        audio_mixer_write(mixer, AUDIO_SOURCE_MUSIC, gained, run);
+        if (spectrum_ready) {
+            audio_spectrum_push(&spectrum, (const int16_t *)pcm, frames, OUTPUT_CHANNELS);
+        }
+
+        audio_ring_consume(&pcm_ring, run);
+        primed = 1;
+
+        latency = audio_mixer_latency(mixer, AUDIO_SOURCE_MUSIC);
+        if (spectrum_ready) audio_spectrum_set_latency(&spectrum, latency / OUTPUT_FRAME_BYTES);
+        track_gain = update_position(atomic_load(&pcm_ring.tail), latency);
+    }
+
+    /* Let the tail of the last track play out unless we were stopped. */
+    if (stopping) audio_mixer_drop(mixer, AUDIO_SOURCE_MUSIC);
+    audio_mixer_pause(mixer, AUDIO_SOURCE_MUSIC, 0);
+    return NULL;
+}
+
+/*
+ * Analysis thread: one spectrum frame per display tick while playing.
+ * Paused playback leaves the bars where they are.
+ */
+static void *analysis_thread_fn(void *arg) {
+    (void)arg;
+    while (!atomic_load(&analysis_quit)) {
+        pthread_mutex_lock(&mp3_lock);
+        playback_state st = state;
+        pthread_mutex_unlock(&mp3_lock);
+
+        if (st == PLAYING) audio_spectrum_process(&spectrum);
+        usleep(1000000 / ANALYSIS_HZ);
+    }
+    return NULL;
+}
+
+static int record_cmp(const void *a, const void *b) {
+    uint64_t x = ((const loudness_record_t *)a)->path_hash;
+    uint64_t y = ((const loudness_record_t *)b)->path_hash;
+    return (x > y) - (x < y);
+}
+
+static void loudness_cache_path(char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/loudness.bin", cache_dir);
+}
+
+/* Fill loudness[] from the cache for every track whose file is unchanged. */
+static void loudness_cache_load(void) {
+    char path[1100];
+    loudness_cache_path(path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t count = 0;
+    loudness_record_t *records = NULL;
+    if (fread(magic, 4, 1, f) != 1 || memcmp(magic, LOUDNESS_CACHE_MAGIC, 4) != 0 ||
+        fread(&version, sizeof(version), 1, f) != 1 || version != LOUDNESS_CACHE_VERSION ||
+        fread(&count, sizeof(count), 1, f) != 1 || count == 0 || count > (1u << 20)) {
+        fclose(f);
+        return;
+    }
+    records = malloc(count * sizeof(*records));
+    if (!records || fread(records, sizeof(*records), count, f) != count) {
+        free(records);
+        fclose(f);
+        return;
+    }
+    fclose(f);
+    qsort(records, count, sizeof(*records), record_cmp);
+
+    for (size_t i = 0; i < track_count && !atomic_load(&loudness_quit); i++) {
+        struct stat st;
+        loudness_record_t key = { .path_hash = hash_path(library[i].path) };
+        loudness_record_t *r = bsearch(&key, records, count, sizeof(*records), record_cmp);
+        if (!r || stat(library[i].path, &st) != 0) continue;
+        if (r->file_size != (uint64_t)st.st_size || r->file_mtime != (int64_t)st.st_mtime) continue;
+
+        pthread_mutex_lock(&mp3_lock);
+        loudness[i].known = 1;
+        loudness[i].lufs = r->lufs;
+        loudness[i].peak_db = r->peak_db;
+        loudness[i].file_size = r->file_size;
+        loudness[i].file_mtime = r->file_mtime;
+        loudness[i].seconds = r->seconds;
+        set_column((int)i, TRACK_COL_DURATION, r->seconds);
+        set_column((int)i, TRACK_COL_ADDED, (uint32_t)r->file_mtime);
+        pthread_mutex_unlock(&mp3_lock);
+    }
+    free(records);
+}
+
+static void loudness_cache_save(void) {
+    loudness_record_t *records = malloc((track_count ? track_count : 1) * sizeof(*records));
+    if (!records) return;
+
+    uint64_t count = 0;
+    pthread_mutex_lock(&mp3_lock);
+    for (size_t i = 0; i < track_count; i++) {
+        if (loudness[i].known != 1) continue;
+        records[count].path_hash = hash_path(library[i].path);
+        records[count].file_size = loudness[i].file_size;
+        records[count].file_mtime = loudness[i].file_mtime;
+        records[count].lufs = loudness[i].lufs;
+        records[count].peak_db = loudness[i].peak_db;
+        records[count].seconds = loudness[i].seconds;
+        records[count].reserved = 0;
+        count++;
+    }
+    pthread_mutex_unlock(&mp3_lock);
+
+    char path[1100];
+    char tmp[1110];
+    loudness_cache_path(path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    mkdir(cache_dir, 0755);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        free(records);
+        return;
+    }
+    uint32_t version = LOUDNESS_CACHE_VERSION;
+    int ok = fwrite(LOUDNESS_CACHE_MAGIC, 4, 1, f) == 1 &&
+             fwrite(&version, sizeof(version), 1, f) == 1 &&
+             fwrite(&count, sizeof(count), 1, f) == 1 &&
+             fwrite(records, sizeof(*records), count, f) == count;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) remove(tmp);
+    free(records);
+}
+
+/* On battery, sleep so the job only runs one slice in LOUDNESS_BATTERY_DUTY. */
+static void loudness_throttle(const struct timespec *slice_start) {
+    if (hardware_get_battery().charging) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long long rest = (unsigned long long)elapsed_us(slice_start, &now) * (LOUDNESS_BATTERY_DUTY - 1);
+    while (rest > 0 && !atomic_load(&loudness_quit)) {
+        unsigned chunk = rest > 100000 ? 100000 : (unsigned)rest;
+        usleep(chunk);
+        rest -= chunk;
+    }
+}
+
+static int analyse_track(size_t index, track_loudness_t *out) {
+    struct stat st;
+    if (stat(library[index].path, &st) != 0) return -1;
+    out->file_size = (uint64_t)st.st_size;
+    out->file_mtime = (int64_t)st.st_mtime;
+
+    track_decoder_t td;
+    if (track_decoder_open(&td, (int)index) != 0) return -1;
+    find_art(td.mh, (int)index);
+
+    audio_loudness_t meter;
+    long rate = td.dec.rate;
+    int channels = td.dec.channels;
+    int result = -1;
+    if (audio_loudness_init(&meter, rate, channels) != 0) {
+        track_decoder_close(&td);
+        return -1;
+    }
+
+    struct timespec slice;
+    clock_gettime(CLOCK_MONOTONIC, &slice);
+    unsigned blocks = 0;
+    unsigned long long frames = 0;
+    while (!atomic_load(&loudness_quit)) {
+        const unsigned char *pcm;
+        size_t done = 0;
+        int r = audio_decoder_read(&td.dec, &pcm, &done);
+        if (r == AUDIO_DECODER_NEW_FORMAT) {
+            if (td.dec.rate != rate || td.dec.channels != channels) break;
+            continue;
+        }
+        if (r == AUDIO_DECODER_ERROR) break;
+        size_t got = done / ((size_t)channels * sizeof(int16_t));
+        if (audio_loudness_add(&meter, (const int16_t *)pcm, got) != 0) break;
+        frames += got;
+        if (r == AUDIO_DECODER_DONE) {
+            result = 0;
+            break;
+        }
+        if (++blocks % LOUDNESS_SLICE_BLOCKS == 0) {
+            loudness_throttle(&slice);
+            clock_gettime(CLOCK_MONOTONIC, &slice);
+        }
+    }
+
+    if (result == 0) {
+        out->known = 1;
+        out->lufs = (float)audio_loudness_integrated(&meter);
+        out->peak_db = (float)audio_loudness_true_peak_db(&meter);
+        out->seconds = (uint32_t)(frames / (unsigned long long)rate);
+    }
+    audio_loudness_free(&meter);
+    track_decoder_close(&td);
+    return result;
+}
+
+typedef struct {
+    uint64_t hash;
+    uint32_t index;
+} content_item_t;
+
+static int content_record_cmp(const void *a, const void *b) {
+    uint64_t x = ((const content_record_t *)a)->inode;
+    uint64_t y = ((const content_record_t *)b)->inode;
+    return (x > y) - (x < y);
+}
+
+static int content_item_cmp(const void *a, const void *b) {
+    const content_item_t *x = a;
+    const content_item_t *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static void content_cache_path(char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/content.bin", cache_dir);
+}
+
+/* Saved records sorted by inode, or NULL. */
+static content_record_t *content_cache_read(uint64_t *count) {
+    char path[1100];
+    content_cache_path(path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    char magic[4];
+    uint32_t version = 0;
+    content_record_t *records = NULL;
+    if (fread(magic, 4, 1, f) == 1 && memcmp(magic, CONTENT_CACHE_MAGIC, 4) == 0 &&
+        fread(&version, sizeof(version), 1, f) == 1 && version == CONTENT_CACHE_VERSION &&
+        fread(count, sizeof(*count), 1, f) == 1 && *count > 0 && *count <= (1u << 20)) {
+        records = malloc(*count * sizeof(*records));
+        if (records && fread(records, sizeof(*records), *count, f) != *count) {
+            free(records);
+            records = NULL;
+        }
+    }
+    fclose(f);
+    if (records) qsort(records, *count, sizeof(*records), content_record_cmp);
+    return records;
+}
+
+static void content_cache_save(void) {
+    content_record_t *records = malloc((track_count ? track_count : 1) * sizeof(*records));
+    if (!records) return;
+
+    uint64_t count = 0;
+    pthread_mutex_lock(&mp3_lock);
+    for (size_t i = 0; i < track_count; i++) {
+        if (content[i].hash != 0) records[count++] = content[i];
+    }
+    pthread_mutex_unlock(&mp3_lock);
+
+    char path[1100];
+    char tmp[1110];
+    content_cache_path(path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    mkdir(cache_dir, 0755);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        free(records);
+        return;
+    }
+    uint32_t version = CONTENT_CACHE_VERSION;
+    int ok = fwrite(CONTENT_CACHE_MAGIC, 4, 1, f) == 1 && fwrite(&version, sizeof(version), 1, f) == 1 &&
+             fwrite(&count, sizeof(count), 1, f) == 1 && fwrite(records, sizeof(*records), count, f) == count;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) remove(tmp);
+    free(records);
+}
+
+/* Recount the copies of every hashed track from the hashes alone. */
+static void content_regroup(void) {
+    content_item_t *items = malloc((track_count ? track_count : 1) * sizeof(*items));
+    if (!items) return;
+    size_t n = 0;
+    pthread_mutex_lock(&mp3_lock);
+    for (size_t i = 0; i < track_count; i++) {
+        if (content[i].hash != 0) items[n++] = (content_item_t){ content[i].hash, (uint32_t)i };
+    }
+    pthread_mutex_unlock(&mp3_lock);
+    qsort(items, n, sizeof(*items), content_item_cmp);
+
+    pthread_mutex_lock(&mp3_lock);
+    for (size_t run = 0; run < n;) {
+        size_t end = run + 1;
+        while (end < n && items[end].hash == items[run].hash) end++;
+        for (size_t k = run; k < end; k++) {
+            uint32_t index = items[k].index;
+            if (content_group[index] != items[run].index) {
+                content_group[index] = items[run].index;
+                if (listed_playlist >= 0 && playlists[listed_playlist].grouped) listed_stale = 1;
+            }
+            set_column((int)index, TRACK_COL_COPIES, (uint32_t)(end - run));
+        }
+        run = end;
+    }
+    pthread_mutex_unlock(&mp3_lock);
+    free(items);
+}
+
+static void content_pace(void *ctx) {
+    struct timespec *slice = ctx;
+    loudness_throttle(slice);
+    clock_gettime(CLOCK_MONOTONIC, slice);
+}
+
+/*
+ * Fill content[] from the cache, then hash every track whose inode, size
+ * or mtime is not in it. The cache is saved every CONTENT_SAVE_EVERY new
+ * hashes and on quit, so an interrupted scan resumes where it stopped.
+ */
+static void content_scan(void) {
+    uint64_t count = 0;
+    content_record_t *records = content_cache_read(&count);
+    unsigned char *stale = calloc(track_count ? track_count : 1, 1);
+    if (!stale) {
+        free(records);
+        return;
+    }
+
+    for (size_t i = 0; i < track_count && !atomic_load(&loudness_quit); i++) {
+        struct stat st;
+        if (stat(library[i].path, &st) != 0) continue;
+        content_record_t rec = {
+            .inode = (uint64_t)st.st_ino,
+            .file_size = (uint64_t)st.st_size,
+            .file_mtime = (int64_t)st.st_mtime,
+        };
+        content_record_t *r = records ? bsearch(&rec, records, count, sizeof(*records), content_record_cmp) : NULL;
+        if (!r || r->file_size != rec.file_size || r->file_mtime != rec.file_mtime) {
+            stale[i] = 1;
+            continue;
+        }
+        pthread_mutex_lock(&mp3_lock);
+        content[i] = *r;
+        pthread_mutex_unlock(&mp3_lock);
+    }
+    free(records);
+    content_regroup();
+
+    struct timespec slice;
+    clock_gettime(CLOCK_MONOTONIC, &slice);
+    size_t fresh = 0;
+    for (size_t i = 0; i < track_count && !atomic_load(&loudness_quit); i++) {
+        struct stat st;
+        if (!stale[i] || stat(library[i].path, &st) != 0) continue;
+        content_record_t rec = {
+            .inode = (uint64_t)st.st_ino,
+            .file_size = (uint64_t)st.st_size,
+            .file_mtime = (int64_t)st.st_mtime,
+        };
+        if (audio_payload_hash(library[i].path, CONTENT_SLICE_BYTES, content_pace, &slice, &loudness_quit, &rec.hash,
+                               NULL) != 0) {
+            continue;
+        }
+        content_pace(&slice);
+
+        pthread_mutex_lock(&mp3_lock);
+        content[i] = rec;
+        pthread_mutex_unlock(&mp3_lock);
+        if (++fresh % CONTENT_SAVE_EVERY == 0) {
+            content_cache_save();
+            content_regroup();
+        }
+    }
+    free(stale);
+    if (fresh % CONTENT_SAVE_EVERY != 0) {
+        content_cache_save();
+        if (!atomic_load(&loudness_quit)) content_regroup();
+    }
+}
+
+/*
+ * Background library job: hashes track contents, then loads the loudness
+ * cache and decodes every track not in it once. Runs at the lowest CPU
+ * and I/O priority (per thread on Linux) and throttles itself on battery.
+ */
+static void *loudness_thread_fn(void *arg) {
+    (void)arg;
+#if defined(__linux__) && defined(SYS_gettid)
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#if defined(SYS_ioprio_set)
+    syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, (int)syscall(SYS_gettid), 3 << 13 /* IOPRIO_CLASS_IDLE */);
+#endif
+#endif
+
+    content_scan();
+    loudness_cache_load();
+
+    size_t fresh = 0;
+    for (size_t i = 0; i < track_count && !atomic_load(&loudness_quit); i++) {
+        pthread_mutex_lock(&mp3_lock);
+        int known = loudness[i].known;
+        pthread_mutex_unlock(&mp3_lock);
+        if (known != 0) continue;
+
+        track_loudness_t result = { .known = -1 };
+        if (analyse_track(i, &result) != 0 && atomic_load(&loudness_quit)) break;
+
+        pthread_mutex_lock(&mp3_lock);
+        loudness[i] = result;
+        set_column((int)i, TRACK_COL_DURATION, result.seconds);
+        set_column((int)i, TRACK_COL_ADDED, (uint32_t)result.file_mtime);
+        pthread_mutex_unlock(&mp3_lock);
+        if (result.known == 1 && ++fresh % LOUDNESS_SAVE_EVERY == 0) loudness_cache_save();
+    }
+    if (fresh % LOUDNESS_SAVE_EVERY != 0) loudness_cache_save();
+    return NULL;
+}
+
+/* Decoder side: take a pending seek for this track, if any. */
+static long long take_seek_request(int index) {
+    pthread_mutex_lock(&mp3_lock);
+    long long target = -1;
+    if (seek_target >= 0 && seek_index == index) target = seek_target;
+    seek_target = -1;
+    seek_index = -1;
+    pthread_mutex_unlock(&mp3_lock);
+    return target;
+}
+
+/*
+ * Jump the current track to target (in output samples) and discard the decoded audio queued
+ * ahead of it. Returns -1 only when playback is being stopped.
+ */
+static int seek_current(track_decoder_t *cur, audio_resampler_t *rs, const queue_cursor_t *at, long long target) {
+    long long pos = audio_decoder_seek(&cur->dec, target * cur->dec.rate / OUTPUT_RATE);
+    if (pos < 0) return 0;
+    audio_resampler_reset(rs);
+
+    atomic_fetch_add(&flush_gen, 1);
+    while (atomic_load(&flushed_gen) != atomic_load(&flush_gen)) {
+        if (should_stop()) return -1;
+        usleep(RING_WAIT_US);
+    }
+    post_segment(cur, at, pos, 0);
+    return 0;
+}
+
+static atomic_int readahead_cancel;
+
+static void *readahead_thread_fn(void *arg) {
+    int index = (int)(intptr_t)arg;
+    audio_mmap_warm(library[index].path, READAHEAD_BYTES, &readahead_cancel);
+    return NULL;
+}
+
+/* Warm a library track (-1 for none), abandoning any earlier readahead. */
+static void start_readahead(pthread_t *thread, int *started, int index) {
+    if (*started) {
+        atomic_store(&readahead_cancel, 1);
+        pthread_join(*thread, NULL);
+        *started = 0;
+    }
+    atomic_store(&readahead_cancel, 0);
+
+    if (index >= 0 && pthread_create(thread, NULL, readahead_thread_fn, (void *)(intptr_t)index) == 0) {
+        *started = 1;
+    }
+}
+
+/* Bring decoded PCM to the device format and queue it. Same contract as ring_push. */
+static int push_converted(audio_resampler_t *rs, const unsigned char *pcm, size_t bytes,
+                          int16_t **scratch, size_t *scratch_frames) {
+    if (rs->passthrough && rs->in_channels == OUTPUT_CHANNELS) return ring_push(pcm, bytes);
+
+    size_t frames = bytes / ((size_t)rs->in_channels * sizeof(int16_t));
+    size_t need = audio_resampler_max_out(rs, frames);
+    if (need > *scratch_frames) {
+        int16_t *grown = realloc(*scratch, need * OUTPUT_FRAME_BYTES);
+        if (!grown) return -1;
+        *scratch = grown;
+        *scratch_frames = need;
+    }
+    size_t out = audio_resampler_process(rs, (const int16_t *)pcm, frames, *scratch);
+    return ring_push((const unsigned char *)*scratch, out * OUTPUT_FRAME_BYTES);
+}
+
+/* Queue the input the resampler filter still holds back. */
+static int flush_resampler(audio_resampler_t *rs, int16_t **scratch, size_t *scratch_frames) {
+    if (rs->in_rate <= 0) return 0;
+
+    size_t need = audio_resampler_max_out(rs, 0);
+    if (need > *scratch_frames) {
+        int16_t *grown = realloc(*scratch, need * OUTPUT_FRAME_BYTES);
+        if (!grown) return -1;
+        *scratch = grown;
+        *scratch_frames = need;
+    }
+    size_t tail = audio_resampler_flush(rs, *scratch);
+    return ring_push((const unsigned char *)*scratch, tail * OUTPUT_FRAME_BYTES) < 0 ? -1 : 0;
+}
+
+/*
+ * Switch the converter to a new source format. Consecutive tracks at the
+ * same rate keep the filter state, so they stay gapless through it.
+ */
+static int retarget_resampler(audio_resampler_t *rs, long rate, int channels,
+                              int16_t **scratch, size_t *scratch_frames) {
+    if (rs->in_rate == rate && rs->in_channels == channels) return 0;
+    if (flush_resampler(rs, scratch, scratch_frames) != 0) return -1;
+    audio_resampler_free(rs);
+    return audio_resampler_init(rs, rate, channels, OUTPUT_RATE, OUTPUT_CHANNELS);
+}
+
+typedef struct {
+    int index;
+    queue_cursor_t at;
+    long long start; /* Bookmark to resume at, in output samples */
+} player_args_t;
+
+/*
+ * Decoder thread: decodes the queue, converts it to the output format and
+ * feeds the ring. Starts the output thread once the first track is open.
+ */
+static void *player_thread_fn(void *arg) {
+    player_args_t *args = (player_args_t *)arg;
+    if (!args) return NULL;
+
+    track_decoder_t cur;
+    track_decoder_t next;
+    int next_tried = 0;
+    queue_cursor_t decode_at = args->at;
+    queue_cursor_t next_at = args->at;
+    queue_cursor_t ahead;
+    long long start = 0;
+    pthread_t output_thread;
+    pthread_t analysis_thread;
+    pthread_t readahead_thread;
+    int output_started = 0;
+    int analysis_started = 0;
+    int readahead_started = 0;
+    int played_out = 0; /* Reached the end of the last queued track, not an error */
+    audio_resampler_t rs;
+    int16_t *converted = NULL;
+    size_t converted_frames = 0;
+
+    memset(&rs, 0, sizeof(rs));
+
+    memset(&next, 0, sizeof(next));
+    next.index = -1;
+    if (track_decoder_open(&cur, args->index) != 0) goto cleanup;
+    request_art(cur.index);
+    if (retarget_resampler(&rs, cur.dec.rate, cur.dec.channels, &converted, &converted_frames) != 0) goto cleanup;
+
+    /* Resume with a direct seek; the frame index cache makes it a jump, not a scan. */
+    if (args->start > 0) {
+        long long pos = audio_decoder_seek(&cur.dec, args->start * cur.dec.rate / OUTPUT_RATE);
+        if (pos > 0) start = pos;
+    }
+
+    publish_format(OUTPUT_RATE, OUTPUT_CHANNELS, MPG123_ENC_SIGNED_16);
+    post_segment(&cur, &decode_at, start, 0);
+    if (pthread_create(&output_thread, NULL, output_thread_fn, NULL) != 0) goto cleanup;
+    output_started = 1;
+
+    atomic_store(&analysis_quit, 0);
+    if (spectrum_ready && pthread_create(&analysis_thread, NULL, analysis_thread_fn, NULL) == 0) {
+        analysis_started = 1;
+    }
+    start_readahead(&readahead_thread, &readahead_started, queue_following(&decode_at, cur.index, &ahead));
+
+    while (!should_stop()) {
+        long long target = take_seek_request(cur.index);
+        if (target >= 0 && seek_current(&cur, &rs, &decode_at, target) != 0) break;
+
+        if (!next_tried && track_decoder_near_end(&cur)) {
+            next_tried = 1;
+            int next_index = queue_following(&decode_at, cur.index, &next_at);
+            if (next_index >= 0 && track_decoder_open(&next, next_index) == 0) {
+                request_art(next_index);
+                if (track_decoder_preroll(&next) != 0) track_decoder_close(&next);
+            }
+        }
+
+        struct timespec t0, t1;
+        const unsigned char *pcm;
+        size_t done = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int r = audio_decoder_read(&cur.dec, &pcm, &done);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        record_decode_time(elapsed_us(&t0, &t1));
+
+        if (r == AUDIO_DECODER_NEW_FORMAT) {
+            if (retarget_resampler(&rs, cur.dec.rate, cur.dec.channels, &converted, &converted_frames) != 0) break;
+            continue;
+        }
+        if (r == AUDIO_DECODER_ERROR) break;
+
+        if (push_converted(&rs, pcm, done, &converted, &converted_frames) < 0) break;
+        if (r != AUDIO_DECODER_DONE) continue;
+
+        /* A seek that arrived while the last block decoded still belongs to this track. */
+        target = take_seek_request(cur.index);
+        if (target >= 0) {
+            if (seek_current(&cur, &rs, &decode_at, target) != 0) break;
+            continue;
+        }
+
+        /* End of track: hand over to the pre-opened next one, if any. */
+        if (next.index < 0) {
+            flush_resampler(&rs, &converted, &converted_frames);
+            played_out = 1;
+            break;
+        }
+        if (retarget_resampler(&rs, next.dec.rate, next.dec.channels, &converted, &converted_frames) != 0) break;
+
+        track_decoder_close(&cur);
+        cur = next;
+        memset(&next, 0, sizeof(next));
+        next.index = -1;
+        next_tried = 0;
+        decode_at = next_at;
+        start_readahead(&readahead_thread, &readahead_started, queue_following(&decode_at, cur.index, &ahead));
+
+        post_segment(&cur, &decode_at, 0, 1);
+        int pushed = push_converted(&rs, cur.preroll, cur.preroll_fill, &converted, &converted_frames);
+        free(cur.preroll);
+        cur.preroll = NULL;
+        cur.preroll_fill = 0;
+        if (pushed < 0) break;
+    }
+
+cleanup:
+    atomic_store(&decode_finished, 1);
+    if (output_started) pthread_join(output_thread, NULL);
+    atomic_store(&analysis_quit, 1);
+    if (analysis_started) pthread_join(analysis_thread, NULL);
+    atomic_store(&readahead_cancel, 1);
+    if (readahead_started) pthread_join(readahead_thread, NULL);
+
+    track_decoder_close(&cur);
+    track_decoder_close(&next);
+    audio_resampler_free(&rs);
+    free(converted);
+
+    pthread_mutex_lock(&mp3_lock);
+    thread_running = 0;
+    seg_has_pending = 0;
+    if (!stop_requested) {
+        /* A track that failed to open or decode keeps its place and is not counted as heard. */
+        if (played_out) {
+            set_bookmark(current_index, 0, 0);
+            count_play(current_index);
+        } else {
+            remember_position();
+        }
+        state = STOPPED;
+        current_index = -1;
+        memset(&seg_active, 0, sizeof(seg_active));
+        play_pos_samples = 0;
+        clear_visualizer();
+    }
+    pthread_mutex_unlock(&mp3_lock);
+
+    free(args);
+    return NULL;
+}
+
+static void build_id_table(void) {
+    size_t slots = 16;
+    while (slots < track_count * 2) slots *= 2;
+    id_slots = calloc(slots, sizeof(*id_slots));
+    if (!id_slots) return;
+    id_slot_mask = slots - 1;
+
+    for (size_t i = 0; i < track_count; i++) {
+        uint64_t id = library[i].id;
+        size_t s = (size_t)(id ^ (id >> 32)) & id_slot_mask;
+        while (id_slots[s]) s = (s + 1) & id_slot_mask;
+        id_slots[s] = (uint32_t)i + 1;
+    }
+}
+
+static int find_track_id(uint64_t id) {
+    if (!id_slots) return -1;
+    size_t s = (size_t)(id ^ (id >> 32)) & id_slot_mask;
+    while (id_slots[s]) {
+        uint32_t index = id_slots[s] - 1;
+        if (library[index].id == id) return (int)index;
+        s = (s + 1) & id_slot_mask;
+    }
+    return -1;
+}
+
+static uint64_t queue_id_of(uint32_t index, void *ctx) {
+    (void)ctx;
+    return library[index].id;
+}
+
+/* The saved index is right unless the library changed since. */
+static int queue_find(uint64_t id, uint32_t hint, void *ctx) {
+    (void)ctx;
+    if (hint < track_count && library[hint].id == id) return (int)hint;
+    return find_track_id(id);
+}
+
+static void queue_file_path(char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/queue.bin", cache_dir);
+}
+
+/* Saves a copy, so the output thread is not held up by the file write. */
+static void queue_save(void) {
+    play_queue_t copy;
+    play_queue_init(&copy);
+    pthread_mutex_lock(&mp3_lock);
+    int ok = queue.len > 0 && play_queue_copy(&copy, &queue) == 0;
+    pthread_mutex_unlock(&mp3_lock);
+
+    if (ok) {
+        char path[1100];
+        queue_file_path(path, sizeof(path));
+        mkdir(cache_dir, 0755);
+        play_queue_save(&copy, path, queue_id_of, NULL);
+    }
+    play_queue_free(&copy);
+}
+
+static void bookmark_log_path(char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/bookmarks.log", cache_dir);
+}
+
+static int write_bookmark_header(FILE *f) {
+    uint32_t version = BOOKMARK_LOG_VERSION;
+    return fwrite(BOOKMARK_LOG_MAGIC, 4, 1, f) == 1 && fwrite(&version, sizeof(version), 1, f) == 1;
+}
+
+/* Replay the log; the last record for a track wins. A torn final record is ignored. */
+static void bookmark_log_load(void) {
+    char path[1100];
+    bookmark_log_path(path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+
+    char magic[4];
+    uint32_t version = 0;
+    if (fread(magic, 4, 1, f) == 1 && memcmp(magic, BOOKMARK_LOG_MAGIC, 4) == 0 &&
+        fread(&version, sizeof(version), 1, f) == 1 && version == BOOKMARK_LOG_VERSION) {
+        bookmark_record_t batch[256];
+        size_t n;
+        while ((n = fread(batch, sizeof(batch[0]), 256, f)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                int index = find_track_id(batch[i].id);
+                if (index >= 0) bookmarks[index] = batch[i].sample > 0 ? batch[i].sample : 0;
+            }
+            bookmark_log_records += n;
+        }
+    }
+    fclose(f);
+}
+
+/* Rewrite the log with one record per live bookmark. */
+static void bookmark_log_compact(void) {
+    bookmark_record_t *live = malloc((track_count ? track_count : 1) * sizeof(*live));
+    if (!live) return;
+    size_t count = 0;
+    pthread_mutex_lock(&mp3_lock);
+    for (size_t i = 0; i < track_count; i++) {
+        if (bookmarks[i] <= 0) continue;
+        live[count].id = library[i].id;
+        live[count].sample = bookmarks[i];
+        count++;
+    }
+    pthread_mutex_unlock(&mp3_lock);
+
+    char path[1100];
+    char tmp[1110];
+    bookmark_log_path(path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        free(live);
+        return;
+    }
+    int ok = write_bookmark_header(f) && fwrite(live, sizeof(*live), count, f) == count;
+    if (fclose(f) != 0) ok = 0;
+    if (ok && rename(tmp, path) == 0) {
+        bookmark_log_records = count;
+    } else {
+        remove(tmp);
+    }
+    free(live);
+}
+
+/* Append the changed bookmarks in one write. Runs on the bookmark thread only. */
+static void bookmark_log_flush(void) {
+    bookmark_record_t *batch = malloc((track_count ? track_count : 1) * sizeof(*batch));
+    if (!batch) return;
+    size_t count = 0;
+    size_t live = 0;
+    pthread_mutex_lock(&mp3_lock);
+    for (size_t i = 0; i < track_count; i++) {
+        if (bookmarks[i] > 0) live++;
+        if (!bookmark_dirty[i]) continue;
+        bookmark_dirty[i] = 0;
+        batch[count].id = library[i].id;
+        batch[count].sample = bookmarks[i];
+        count++;
+    }
+    pthread_mutex_unlock(&mp3_lock);
+
+    if (count > 0) {
+        char path[1100];
+        bookmark_log_path(path, sizeof(path));
+        mkdir(cache_dir, 0755);
+        FILE *f = fopen(path, "ab");
+        if (f) {
+            if (fseek(f, 0, SEEK_END) == 0 && ftell(f) == 0) write_bookmark_header(f);
+            bookmark_log_records += fwrite(batch, sizeof(*batch), count, f);
+            fclose(f);
+        }
+    }
+    free(batch);
+
+    if (bookmark_log_records > BOOKMARK_COMPACT_MIN && bookmark_log_records > live * 2) bookmark_log_compact();
+}
+
+static void play_count_path(char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/plays.bin", cache_dir);
+}
+
+/* Before the playlists are built; tracks no longer in the library are dropped. */
+static void play_counts_load(void) {
+    char path[1100];
+    play_count_path(path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t count = 0;
+    if (fread(magic, 4, 1, f) == 1 && memcmp(magic, PLAY_COUNT_MAGIC, 4) == 0 &&
+        fread(&version, sizeof(version), 1, f) == 1 && version == PLAY_COUNT_VERSION &&
+        fread(&count, sizeof(count), 1, f) == 1) {
+        play_count_record_t batch[256];
+        size_t n;
+        while ((n = fread(batch, sizeof(batch[0]), 256, f)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                int index = find_track_id(batch[i].id);
+                if (index >= 0) columns.col[TRACK_COL_PLAYS][index] = batch[i].plays;
+            }
+        }
+    }
+    fclose(f);
 }
 
-static void update_visualizer_from_pcm16(const int16_t *samples, size_t sample_count, int channels) {
-    if (!samples || sample_count == 0) return;
-    if (channels < 1) channels = 1;
-
-    size_t frames = sample_count / (size_t)channels;
-    if (frames == 0) return;
+/* Rewrite the counts if any changed. Runs on the bookmark thread only. */
+static void play_counts_save(void) {
+    play_count_record_t *records = malloc((track_count ? track_count : 1) * sizeof(*records));
+    if (!records) return;
+    uint64_t count = 0;
+    pthread_mutex_lock(&mp3_lock);
+    int dirty = plays_dirty;
+    plays_dirty = 0;
+    for (size_t i = 0; dirty && i < columns.rows; i++) {
+        if (columns.col[TRACK_COL_PLAYS][i] == 0) continue;
+        records[count].id = library[i].id;
+        records[count].plays = columns.col[TRACK_COL_PLAYS][i];
+        records[count].reserved = 0;
+        count++;
+    }
+    pthread_mutex_unlock(&mp3_lock);
+    if (!dirty) {
+        free(records);
+        return;
+    }
 
-    size_t frames_per_bin = frames / MP3_VIZ_BINS;
-    if (frames_per_bin == 0) frames_per_bin = 1;
+    char path[1100];
+    char tmp[1110];
+    play_count_path(path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    mkdir(cache_dir, 0755);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        free(records);
+        return;
+    }
+    uint32_t version = PLAY_COUNT_VERSION;
+    int ok = fwrite(PLAY_COUNT_MAGIC, 4, 1, f) == 1 && fwrite(&version, sizeof(version), 1, f) == 1 &&
+             fwrite(&count, sizeof(count), 1, f) == 1 && fwrite(records, sizeof(*records), count, f) == count;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) remove(tmp);
+    free(records);
+}
 
-    for (int b = 0; b < MP3_VIZ_BINS; b++) {
-        size_t start = (size_t)b * frames_per_bin;
-        if (start >= frames) {
-            viz_levels[b] *= 0.85f;
-            continue;
-        }
+/*
+ * Bookmark thread: every BOOKMARK_FLUSH_SEC, or when playback pauses or
+ * stops, notes the audible position and writes what changed. Play counts
+ * are saved on the same schedule.
+ */
+static void *bookmark_thread_fn(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&mp3_lock);
+    for (;;) {
+        remember_position();
+        int quit = bookmark_quit;
+        bookmark_flush_now = 0;
+        pthread_mutex_unlock(&mp3_lock);
 
-        size_t end = start + frames_per_bin;
-        if (end > frames) end = frames;
+        bookmark_log_flush();
+        play_counts_save();
+        if (quit) break;
 
-        double sum_sq = 0.0;
-        size_t count = 0;
-        for (size_t f = start; f < end; f++) {
-            int16_t s = samples[f * (size_t)channels];
-            double n = (double)s / 32768.0;
-            sum_sq += n * n;
-            count++;
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += BOOKMARK_FLUSH_SEC;
+        pthread_mutex_lock(&mp3_lock);
+        while (!bookmark_quit && !bookmark_flush_now) {
+            if (pthread_cond_timedwait(&bookmark_cond, &mp3_lock, &deadline) != 0) break;
         }
+    }
+    return NULL;
+}
 
-        float rms = 0.0f;
-        if (count > 0) rms = (float)sqrt(sum_sq / (double)count);
-
-        float smoothed = (viz_levels[b] * 0.7f) + (rms * 0.3f);
-        if (smoothed > 1.0f) smoothed = 1.0f;
-        viz_levels[b] = smoothed;
+static int compare_sort_items(const void *a, const void *b) {
+    const sort_item_t *x = a;
+    const sort_item_t *y = b;
+    for (int k = 0; k < 3; k++) {
+        if (x->key[k] != y->key[k]) return x->key[k] < y->key[k] ? -1 : 1;
     }
+    return (x->index > y->index) - (x->index < y->index);
 }
 
-typedef struct {
-    char *path;
-} player_args_t;
+/* New display order; ties fall back to folder order. Runs on the sort thread. */
+static uint32_t *sort_library(mp3_sort_order order) {
+    if (order != MP3_SORT_FOLDER && string_pool_rank(&strings) != 0) return NULL;
 
-static void *player_thread_fn(void *arg) {
-    player_args_t *args = (player_args_t *)arg;
-    if (!args || !args->path) {
-        free(args);
+    sort_item_t *items = malloc((track_count ? track_count : 1) * sizeof(*items));
+    uint32_t *result = malloc((track_count ? track_count : 1) * sizeof(*result));
+    if (!items || !result) {
+        free(items);
+        free(result);
         return NULL;
     }
 
-    mpg123_handle *mh = NULL;
-    out123_handle *ao = NULL;
-    unsigned char *buffer = NULL;
-    size_t outblock = 0;
-    long rate = 0;
-    int channels = 0;
-    int encoding = 0;
-
-    int err = 0;
-    mh = mpg123_new(NULL, &err);
-    if (!mh) goto cleanup;
-
-    if (mpg123_open(mh, args->path) != MPG123_OK) goto cleanup;
-    if (mpg123_getformat(mh, &rate, &channels, &encoding) != MPG123_OK) goto cleanup;
-
-    ao = out123_new();
-    if (!ao) goto cleanup;
-    if (out123_open(ao, NULL, NULL) != 0) goto cleanup;
-    if (out123_start(ao, rate, channels, encoding) != 0) goto cleanup;
-
-    outblock = mpg123_outblock(mh);
-    if (outblock == 0) goto cleanup;
-    buffer = malloc(outblock);
-    if (!buffer) goto cleanup;
+    const uint32_t *rank = strings.ranks;
+    for (size_t i = 0; i < track_count; i++) {
+        const track_names_t *n = &track_names[i];
+        sort_item_t *it = &items[i];
+        it->index = (uint32_t)i;
+        memset(it->key, 0, sizeof(it->key));
+        switch (order) {
+            case MP3_SORT_ARTIST:
+                it->key[0] = rank[n->author];
+                it->key[1] = rank[n->title];
+                break;
+            case MP3_SORT_TITLE:
+                it->key[0] = rank[n->title];
+                it->key[1] = rank[n->author];
+                break;
+            case MP3_SORT_GENRE:
+                it->key[0] = rank[n->genre];
+                it->key[1] = rank[n->author];
+                it->key[2] = rank[n->title];
+                break;
+            default:
+                break;
+        }
+    }
+    qsort(items, track_count, sizeof(*items), compare_sort_items);
+    for (size_t i = 0; i < track_count; i++) result[i] = items[i].index;
+    free(items);
+    return result;
+}
 
-    int paused_locally = 0;
-    while (1) {
-        pthread_mutex_lock(&mp3_lock);
-        int should_stop = stop_requested;
-        playback_state st = state;
+/* Sorts until the order asked for is the one shown. */
+static void *sort_thread_fn(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&mp3_lock);
+    while (!sort_quit && sort_order != sort_wanted) {
+        mp3_sort_order want = sort_wanted;
         pthread_mutex_unlock(&mp3_lock);
-
-        if (should_stop) break;
-
-        if (st == PAUSED) {
-            if (!paused_locally) {
-                out123_pause(ao);
-                paused_locally = 1;
-            }
-            usleep(20000);
-            continue;
+        uint32_t *order = sort_library(want);
+        pthread_mutex_lock(&mp3_lock);
+        if (!order) {
+            sort_wanted = sort_order;
+            break;
         }
+        free(sorted);
+        sorted = order;
+        sort_order = want;
+        listed_stale = 1;
+    }
+    sort_running = 0;
+    pthread_mutex_unlock(&mp3_lock);
+    return NULL;
+}
 
-        if (paused_locally) {
-            out123_continue(ao);
-            paused_locally = 0;
-        }
+/* Copies of one song together, songs in folder order of their first copy. */
+static int compare_grouped(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    if (content_group[x] != content_group[y]) return content_group[x] < content_group[y] ? -1 : 1;
+    return (x > y) - (x < y);
+}
 
-        size_t done = 0;
-        int r = mpg123_read(mh, buffer, outblock, &done);
-        if (r == MPG123_DONE) break;
-        if (r != MPG123_OK && r != MPG123_NEW_FORMAT) break;
-
-        if (r == MPG123_NEW_FORMAT) {
-            if (mpg123_getformat(mh, &rate, &channels, &encoding) != MPG123_OK) break;
-            out123_stop(ao);
-            if (out123_start(ao, rate, channels, encoding) != 0) break;
-            continue;
-        }
+/* Rebuild `listed` from the display order and the chosen playlist. Call with mp3_lock held. */
+static void refresh_listed(void) {
+    if (!listed_stale) return;
+    listed_stale = 0;
+    listed_count = 0;
+    if (listed_playlist < 0 || !listed || !sorted) return;
+    const track_bitset_t *hits = &playlists[listed_playlist].hits;
+    for (size_t i = 0; i < track_count; i++) {
+        if (track_bitset_test(hits, sorted[i])) listed[listed_count++] = sorted[i];
+    }
+    if (playlists[listed_playlist].grouped && content_group) {
+        qsort(listed, listed_count, sizeof(*listed), compare_grouped);
+    }
+}
 
-        if (done > 0) {
-            out123_play(ao, buffer, done);
+/* Library index listed at pos. Call with mp3_lock held. */
+static int listed_at(size_t pos) {
+    refresh_listed();
+    if (listed_playlist >= 0) return pos < listed_count ? (int)listed[pos] : -1;
+    return (sorted && pos < track_count) ? (int)sorted[pos] : -1;
+}
 
-            pthread_mutex_lock(&mp3_lock);
-            if (out123_encsize(encoding) == 2) {
-                update_visualizer_from_pcm16((const int16_t *)buffer, done / sizeof(int16_t), channels);
-            }
-            pthread_mutex_unlock(&mp3_lock);
-        }
-    }
+static int resolve_name(track_column column, const char *name, void *ctx) {
+    (void)ctx;
+    (void)column; /* Ids are shared by all fields; a title's id matches no genre */
+    return string_pool_find(&strings, name);
+}
 
-cleanup:
-    if (ao) {
-        out123_drop(ao);
-        out123_close(ao);
-        out123_del(ao);
+static int add_playlist(track_query_t *query) {
+    smart_playlist_t *grown = realloc(playlists, (playlist_count + 1) * sizeof(*grown));
+    if (!grown) {
+        track_query_free(query);
+        return -1;
     }
-    if (mh) {
-        mpg123_close(mh);
-        mpg123_delete(mh);
+    playlists = grown;
+    smart_playlist_t *pl = &playlists[playlist_count++];
+    memset(pl, 0, sizeof(*pl));
+    pl->query = *query;
+    track_query_anchor(&pl->query, (uint32_t)time(NULL));
+    return track_query_run(&pl->query, &columns, &pl->hits);
+}
+
+/* Built-in playlists, then <audio_root>/.playlists/<name>.query. */
+static void load_playlists(const char *audio_root) {
+    track_query_t q;
+    memset(&q, 0, sizeof(q));
+    snprintf(q.name, sizeof(q.name), "Recently added");
+    if (track_query_add_recent(&q, RECENT_DAYS) == 0) add_playlist(&q);
+    memset(&q, 0, sizeof(q));
+    snprintf(q.name, sizeof(q.name), "Most played");
+    if (track_query_add(&q, TRACK_COL_PLAYS, MOST_PLAYED_MIN, UINT32_MAX) == 0) add_playlist(&q);
+    memset(&q, 0, sizeof(q));
+    snprintf(q.name, sizeof(q.name), "Duplicates");
+    size_t duplicates = playlist_count;
+    if (track_query_add(&q, TRACK_COL_COPIES, DUPLICATES_MIN, UINT32_MAX) == 0) add_playlist(&q);
+    if (playlist_count > duplicates) playlists[duplicates].grouped = 1;
+
+    char dir_path[1100];
+    snprintf(dir_path, sizeof(dir_path), "%s/.playlists", audio_root);
+    DIR *dir = opendir(dir_path);
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *ext = strrchr(entry->d_name, '.');
+        if (entry->d_name[0] == '.' || !ext || strcmp(ext, ".query") != 0) continue;
+        char path[1400];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        if (track_query_load(&q, path, resolve_name, NULL) == 0) add_playlist(&q);
     }
-    free(buffer);
+    closedir(dir);
+}
 
+static void request_sort(mp3_sort_order order) {
+    if (order < 0 || order >= MP3_SORT_COUNT) return;
     pthread_mutex_lock(&mp3_lock);
-    thread_running = 0;
-    if (!stop_requested) {
-        state = STOPPED;
-        current_index = -1;
-        start_time = 0;
-        pause_offset = 0;
-        clear_visualizer();
-    }
+    sort_wanted = order;
+    int start = sorted && !sort_running && sort_order != order;
+    if (start) sort_running = 1;
     pthread_mutex_unlock(&mp3_lock);
+    if (!start) return;
 
-    free(args->path);
-    free(args);
-    return NULL;
+    /* A finished sort thread still has to be joined. */
+    if (sort_started) pthread_join(sort_thread, NULL);
+    sort_started = (pthread_create(&sort_thread, NULL, sort_thread_fn, NULL) == 0);
+    if (!sort_started) {
+        pthread_mutex_lock(&mp3_lock);
+        sort_running = 0;
+        sort_wanted = sort_order;
+        pthread_mutex_unlock(&mp3_lock);
+    }
 }
 
 int mp3_service_init(const char *audio_root) {
     if (!audio_root || audio_root[0] == '\0') return -1;
+    snprintf(cache_dir, sizeof(cache_dir), "%s/.cache", audio_root);
+
+    unsigned volume = (unsigned)settings_service_get_int("volume");
+    atomic_store(&master_volume, volume);
+    audio_mixer_t *mixer = mixer_service_get();
+    if (mixer) audio_mixer_set_gain(mixer, AUDIO_SOURCE_MUSIC, volume_to_q12(volume));
+    mp3_service_set_eq_preset(settings_service_get_int("eq_preset"));
 
+    spectrum_ready = (audio_spectrum_init(&spectrum, MP3_VIZ_BINS) == 0);
+    string_pool_init(&strings);
     library = malloc(sizeof(AudioFile) * INITIAL_AUDIO_CAPACITY);
     if (!library) return -1;
     capacity = INITIAL_AUDIO_CAPACITY;
@@ -266,8 +2287,7 @@ int mp3_service_init(const char *audio_root) {
             struct dirent *file_entry;
             while ((file_entry = readdir(author_dir)) != NULL) {
                 if (file_entry->d_name[0] == '.') continue;
-                const char *ext = strrchr(file_entry->d_name, '.');
-                if (!ext || strcmp(ext, ".mp3") != 0) continue;
+                if (!audio_decoder_find(file_entry->d_name)) continue;
 
                 if (ensure_capacity() != 0) continue;
 
@@ -276,16 +2296,14 @@ int mp3_service_init(const char *audio_root) {
                 snprintf(full_path, sizeof(full_path), "%s/%s", author_path, file_entry->d_name);
 
                 track->path = strdup(full_path);
-                track->title = title_from_filename(file_entry->d_name);
-                track->author = strdup(author_entry->d_name);
-                track->genre = strdup(genre_entry->d_name);
+                track->title = intern(title_from_filename(file_entry->d_name));
+                track->author = intern(strdup(author_entry->d_name));
+                track->genre = intern(strdup(genre_entry->d_name));
                 track->duration = 0;
+                track->id = hash_path(full_path + strlen(audio_root) + 1);
 
                 if (!track->path || !track->title || !track->author || !track->genre) {
                     free(track->path);
-                    free(track->title);
-                    free(track->author);
-                    free(track->genre);
                     continue;
                 }
 
@@ -297,9 +2315,158 @@ int mp3_service_init(const char *audio_root) {
     }
     closedir(root_dir);
 
+    qsort(library, track_count, sizeof(AudioFile), compare_tracks_by_path);
+
+    build_id_table();
+    char queue_path[1100];
+    queue_file_path(queue_path, sizeof(queue_path));
+    play_queue_init(&queue);
+    if (play_queue_load(&queue, queue_path, queue_find, NULL) != 0) play_queue_free(&queue);
+
+    bookmarks = calloc(track_count ? track_count : 1, sizeof(*bookmarks));
+    bookmark_dirty = calloc(track_count ? track_count : 1, 1);
+    bookmark_quit = 0;
+    if (bookmarks && bookmark_dirty) {
+        bookmark_log_load();
+        if (pthread_create(&bookmark_thread, NULL, bookmark_thread_fn, NULL) == 0) bookmark_started = 1;
+    } else {
+        free(bookmarks);
+        free(bookmark_dirty);
+        bookmarks = NULL;
+        bookmark_dirty = NULL;
+    }
+
+    art = calloc(track_count ? track_count : 1, sizeof(*art));
+    art_request_count = 0;
+    art_quit = 0;
+    if (art && pthread_create(&art_thread, NULL, art_thread_fn, NULL) == 0) art_started = 1;
+
+    /* Shown in folder order until the saved order has been sorted. */
+    track_names = malloc((track_count ? track_count : 1) * sizeof(*track_names));
+    uint32_t *folder_order = malloc((track_count ? track_count : 1) * sizeof(*folder_order));
+    if (track_names && folder_order) {
+        for (size_t i = 0; i < track_count; i++) {
+            track_names[i].title = (uint32_t)string_pool_intern(&strings, library[i].title);
+            track_names[i].author = (uint32_t)string_pool_intern(&strings, library[i].author);
+            track_names[i].genre = (uint32_t)string_pool_intern(&strings, library[i].genre);
+            folder_order[i] = (uint32_t)i;
+        }
+        if (track_table_resize(&columns, track_count) == 0) {
+            for (size_t i = 0; i < track_count; i++) {
+                columns.col[TRACK_COL_GENRE][i] = track_names[i].genre;
+                columns.col[TRACK_COL_AUTHOR][i] = track_names[i].author;
+                track_table_set_live(&columns, i, 1);
+            }
+            play_counts_load();
+            listed = malloc((track_count ? track_count : 1) * sizeof(*listed));
+            if (listed) load_playlists(audio_root);
+        }
+
+        pthread_mutex_lock(&mp3_lock);
+        sorted = folder_order;
+        sort_order = MP3_SORT_FOLDER;
+        sort_quit = 0;
+        listed_stale = 1;
+        pthread_mutex_unlock(&mp3_lock);
+        request_sort((mp3_sort_order)settings_service_get_int("library_sort"));
+    } else {
+        free(track_names);
+        free(folder_order);
+        track_names = NULL;
+    }
+
+    loudness = calloc(track_count ? track_count : 1, sizeof(*loudness));
+    content = calloc(track_count ? track_count : 1, sizeof(*content));
+    content_group = calloc(track_count ? track_count : 1, sizeof(*content_group));
+    atomic_store(&loudness_quit, 0);
+    if (loudness && content && content_group &&
+        pthread_create(&loudness_thread, NULL, loudness_thread_fn, NULL) == 0) {
+        loudness_started = 1;
+    }
+    return 0;
+}
+
+int mp3_service_find(uint64_t id) {
+    return find_track_id(id);
+}
+
+int mp3_service_get_art(size_t index, char *path, size_t path_size, uint64_t *key) {
+    pthread_mutex_lock(&mp3_lock);
+    track_art_t found = (art && index < track_count) ? art[index] : (track_art_t){ 0, ART_UNKNOWN };
+    pthread_mutex_unlock(&mp3_lock);
+
+    if (found.source == ART_EMBEDDED) {
+        art_cache_path(found.key, path, path_size);
+    } else if (found.source == ART_FOLDER) {
+        folder_art_path(library[index].path, path, path_size);
+    } else {
+        return -1;
+    }
+    *key = found.key;
     return 0;
 }
 
+int mp3_service_sorted(size_t pos) {
+    pthread_mutex_lock(&mp3_lock);
+    int index = listed_at(pos);
+    pthread_mutex_unlock(&mp3_lock);
+    return index;
+}
+
+size_t mp3_service_listed_count(void) {
+    pthread_mutex_lock(&mp3_lock);
+    refresh_listed();
+    size_t count = listed_playlist >= 0 ? listed_count : (sorted ? track_count : 0);
+    pthread_mutex_unlock(&mp3_lock);
+    return count;
+}
+
+size_t mp3_service_playlist_count(void) {
+    return playlist_count;
+}
+
+const char *mp3_service_playlist_name(int playlist) {
+    return (playlist >= 0 && (size_t)playlist < playlist_count) ? playlists[playlist].query.name : "All";
+}
+
+/* Re-run in full on selection so "recently added" counts back from now. */
+void mp3_service_set_playlist(int playlist) {
+    pthread_mutex_lock(&mp3_lock);
+    listed_playlist = (playlist >= 0 && (size_t)playlist < playlist_count) ? playlist : -1;
+    if (listed_playlist >= 0) {
+        smart_playlist_t *pl = &playlists[listed_playlist];
+        track_query_anchor(&pl->query, (uint32_t)time(NULL));
+        track_query_run(&pl->query, &columns, &pl->hits);
+    }
+    listed_stale = 1;
+    pthread_mutex_unlock(&mp3_lock);
+}
+
+int mp3_service_get_playlist(void) {
+    pthread_mutex_lock(&mp3_lock);
+    int playlist = listed_playlist;
+    pthread_mutex_unlock(&mp3_lock);
+    return playlist;
+}
+
+void mp3_service_set_sort(mp3_sort_order order) {
+    if (order < 0 || order >= MP3_SORT_COUNT) return;
+    settings_service_set_int("library_sort", (int)order);
+    request_sort(order);
+}
+
+mp3_sort_order mp3_service_get_sort(void) {
+    pthread_mutex_lock(&mp3_lock);
+    mp3_sort_order order = sort_wanted;
+    pthread_mutex_unlock(&mp3_lock);
+    return order;
+}
+
+const char *mp3_service_sort_name(mp3_sort_order order) {
+    static const char *names[MP3_SORT_COUNT] = { "Artist", "Title", "Genre", "Folder" };
+    return (order >= 0 && order < MP3_SORT_COUNT) ? names[order] : "";
+}
+
 size_t mp3_service_count(void) {
     return track_count;
 }
@@ -309,36 +2476,67 @@ const AudioFile *mp3_service_get(size_t index) {
     return &library[index];
 }
 
-int mp3_service_play(size_t index) {
-    if (index >= track_count) return -1;
-
-    mp3_service_stop();
-
+/* Start the player at queue.pos. Playback must be stopped. */
+static int start_queue(void) {
     player_args_t *args = malloc(sizeof(player_args_t));
     if (!args) return -1;
-    args->path = strdup(library[index].path);
-    if (!args->path) {
+
+    pthread_mutex_lock(&mp3_lock);
+    args->index = play_queue_at(&queue, queue.pos);
+    args->at.pos = queue.pos;
+    args->at.gen = queue_gen;
+    args->start = 0;
+    if (bookmarks && args->index >= 0 && (size_t)args->index < track_count) args->start = bookmarks[args->index];
+    pthread_mutex_unlock(&mp3_lock);
+    if (args->index < 0 || (size_t)args->index >= track_count) {
         free(args);
         return -1;
     }
 
+    size_t ring_bytes = (size_t)RING_BYTES_PER_SEC / 1000 * ring_ms;
+    if (!pcm_ring.data || pcm_ring.capacity < ring_bytes) {
+        audio_ring_free(&pcm_ring);
+        if (audio_ring_init(&pcm_ring, ring_bytes) != 0) {
+            free(args);
+            return -1;
+        }
+    }
+    audio_ring_reset(&pcm_ring);
+    atomic_store(&format_gen, 0);
+    atomic_store(&applied_gen, 0);
+    atomic_store(&decode_finished, 0);
+    atomic_store(&flush_gen, 0);
+    atomic_store(&flushed_gen, 0);
+    atomic_store(&output_failed, 0);
+    atomic_store(&stat_underruns, 0);
+    atomic_store(&stat_blocks, 0);
+    atomic_store(&stat_decode_us_last, 0);
+    atomic_store(&stat_decode_us_avg, 0);
+    atomic_store(&stat_decode_us_max, 0);
+    atomic_store(&stat_eq_us_per_sec, 0);
+    atomic_store(&replay_gain_on, settings_service_get_bool("replay_gain") ? 1 : 0);
+
     pthread_mutex_lock(&mp3_lock);
+    seg_has_pending = 0;
+    memset(&seg_active, 0, sizeof(seg_active));
+    play_pos_samples = 0;
+    seek_target = -1;
+    seek_index = -1;
     state = PLAYING;
-    current_index = (int)index;
-    start_time = time(NULL);
-    pause_offset = 0;
+    current_index = args->index;
     stop_requested = 0;
     clear_visualizer();
     thread_running = 1;
+    thread_started = 1;
     pthread_mutex_unlock(&mp3_lock);
 
     if (pthread_create(&player_thread, NULL, player_thread_fn, args) != 0) {
         pthread_mutex_lock(&mp3_lock);
         thread_running = 0;
+        thread_started = 0;
         state = STOPPED;
         current_index = -1;
         pthread_mutex_unlock(&mp3_lock);
-        free(args->path);
         free(args);
         return -1;
     }
@@ -346,39 +2544,142 @@ int mp3_service_play(size_t index) {
     return 0;
 }
 
-void mp3_service_pause(void) {
+int mp3_service_play(size_t index) {
+    if (index >= track_count) return -1;
+
+    mp3_service_stop();
+
+    /* Queue the whole library as listed, starting at the chosen track. */
+    uint32_t *list = malloc(track_count * sizeof(*list));
+    if (!list) return -1;
+
     pthread_mutex_lock(&mp3_lock);
-    if (state == PLAYING) {
-        pause_offset += (unsigned)(time(NULL) - start_time);
-        state = PAUSED;
+    size_t len = 0;
+    size_t start = 0;
+    for (int at; (at = listed_at(len)) >= 0; len++) {
+        list[len] = (uint32_t)at;
+        if ((size_t)at == index) start = len;
     }
+    if (len == 0 || list[start] != index) {
+        list[0] = (uint32_t)index; /* Not listed: play it alone */
+        len = 1;
+        start = 0;
+    }
+    int r = play_queue_assign(&queue, list, len, start);
+    queue_gen++;
     pthread_mutex_unlock(&mp3_lock);
+    free(list);
+
+    if (r == 0) r = start_queue();
+    queue_save();
+    return r;
 }
 
-void mp3_service_resume(void) {
+int mp3_service_play_queue(void) {
+    pthread_mutex_lock(&mp3_lock);
+    size_t len = queue.len;
+    pthread_mutex_unlock(&mp3_lock);
+    if (len == 0) return -1;
+
+    mp3_service_stop();
+    return start_queue();
+}
+
+/* User skip: dir 1 for next, -1 for previous. Keeps playing at either end. */
+static int skip(int dir) {
+    size_t pos;
+    pthread_mutex_lock(&mp3_lock);
+    int r = play_queue_skip(&queue, queue.pos, dir, &pos);
+    pthread_mutex_unlock(&mp3_lock);
+    if (r != 0) return -1;
+
+    mp3_service_stop();
+
+    /* The audible track may have moved on before the player stopped. */
+    pthread_mutex_lock(&mp3_lock);
+    r = play_queue_skip(&queue, queue.pos, dir, &pos);
+    if (r == 0) queue.pos = pos;
+    pthread_mutex_unlock(&mp3_lock);
+
+    if (r == 0) r = start_queue();
+    queue_save();
+    return r;
+}
+
+int mp3_service_next(void) {
+    return skip(1);
+}
+
+int mp3_service_prev(void) {
+    return skip(-1);
+}
+
+void mp3_service_set_shuffle(int on) {
     pthread_mutex_lock(&mp3_lock);
-    if (state == PAUSED) {
-        start_time = time(NULL);
-        state = PLAYING;
+    if (queue.shuffle != (on ? 1 : 0)) {
+        play_queue_set_shuffle(&queue, on);
+        queue_gen++;
     }
     pthread_mutex_unlock(&mp3_lock);
+    queue_save();
+}
+
+int mp3_service_get_shuffle(void) {
+    pthread_mutex_lock(&mp3_lock);
+    int on = queue.shuffle;
+    pthread_mutex_unlock(&mp3_lock);
+    return on;
+}
+
+/* Applies from the next track the player lines up. */
+void mp3_service_set_repeat(play_repeat mode) {
+    if (mode < PLAY_REPEAT_OFF || mode >= PLAY_REPEAT_COUNT) return;
+    pthread_mutex_lock(&mp3_lock);
+    queue.repeat = mode;
+    pthread_mutex_unlock(&mp3_lock);
+    queue_save();
+}
+
+play_repeat mp3_service_get_repeat(void) {
+    pthread_mutex_lock(&mp3_lock);
+    play_repeat mode = queue.repeat;
+    pthread_mutex_unlock(&mp3_lock);
+    return mode;
+}
+
+void mp3_service_pause(void) {
+    pthread_mutex_lock(&mp3_lock);
+    if (state == PLAYING) state = PAUSED;
+    remember_position();
+    bookmark_flush_now = 1;
+    pthread_cond_signal(&bookmark_cond);
+    pthread_mutex_unlock(&mp3_lock);
+}
+
+void mp3_service_resume(void) {
+    pthread_mutex_lock(&mp3_lock);
+    if (state == PAUSED) state = PLAYING;
+    pthread_mutex_unlock(&mp3_lock);
 }
 
 void mp3_service_stop(void) {
     pthread_t join_thread;
     int should_join = 0;
 
+    /* A thread that finished on its own still needs joining. */
     pthread_mutex_lock(&mp3_lock);
-    if (thread_running) {
-        stop_requested = 1;
+    remember_position();
+    bookmark_flush_now = 1;
+    pthread_cond_signal(&bookmark_cond);
+    if (thread_started) {
+        if (thread_running) stop_requested = 1;
         join_thread = player_thread;
         should_join = 1;
     }
     state = STOPPED;
     current_index = -1;
-    start_time = 0;
-    pause_offset = 0;
-    clear_visualizer();
+    memset(&seg_active, 0, sizeof(seg_active));
+    play_pos_samples = 0;
     pthread_mutex_unlock(&mp3_lock);
 
     if (should_join) {
@@ -386,8 +2687,10 @@ void mp3_service_stop(void) {
         pthread_mutex_lock(&mp3_lock);
         stop_requested = 0;
         thread_running = 0;
+        thread_started = 0;
         pthread_mutex_unlock(&mp3_lock);
     }
+    clear_visualizer();
 }
 
 playback_state mp3_service_get_state(void) {
@@ -405,43 +2708,222 @@ int mp3_service_get_current_index(void) {
 }
 
 unsigned mp3_service_get_elapsed(void) {
+    return (unsigned)(mp3_service_get_position_ms() / 1000);
+}
+
+unsigned long mp3_service_get_position_ms(void) {
+    pthread_mutex_lock(&mp3_lock);
+    unsigned long ms = 0;
+    if (state != STOPPED && seg_active.rate > 0) {
+        ms = (unsigned long)(play_pos_samples * 1000 / seg_active.rate);
+    }
+    pthread_mutex_unlock(&mp3_lock);
+    return ms;
+}
+
+unsigned mp3_service_get_duration(void) {
+    pthread_mutex_lock(&mp3_lock);
+    unsigned seconds = 0;
+    if (state != STOPPED && seg_active.rate > 0) {
+        seconds = (unsigned)(seg_active.length / seg_active.rate);
+    }
+    pthread_mutex_unlock(&mp3_lock);
+    return seconds;
+}
+
+int mp3_service_seek_to_ms(unsigned long ms) {
     pthread_mutex_lock(&mp3_lock);
-    unsigned elapsed = 0;
-    if (state == PLAYING) {
-        elapsed = pause_offset + (unsigned)(time(NULL) - start_time);
-    } else if (state == PAUSED) {
-        elapsed = pause_offset;
+    /*
+     * Once the decoder has handed over to the next track, the audible one is
+     * only the tail left in the ring and can no longer be seeked.
+     */
+    if (state == STOPPED || seg_active.rate <= 0 || (seg_has_pending && seg_pending.handover)) {
+        pthread_mutex_unlock(&mp3_lock);
+        return -1;
     }
+    long long target = (long long)ms * seg_active.rate / 1000;
+    if (seg_active.length > 0 && target >= seg_active.length) target = seg_active.length - 1;
+    seek_target = target;
+    seek_index = seg_active.index;
+    play_pos_samples = target;
     pthread_mutex_unlock(&mp3_lock);
-    return elapsed;
+    return 0;
+}
+
+int mp3_service_seek(int delta_seconds) {
+    long long ms = (long long)mp3_service_get_position_ms() + (long long)delta_seconds * 1000;
+    if (ms < 0) ms = 0;
+    return mp3_service_seek_to_ms((unsigned long)ms);
 }
 
 size_t mp3_service_get_visualizer(unsigned char *out_levels, size_t max_levels) {
     if (!out_levels || max_levels == 0) return 0;
 
     size_t count = (max_levels < MP3_VIZ_BINS) ? max_levels : MP3_VIZ_BINS;
-    pthread_mutex_lock(&mp3_lock);
+    float levels[MP3_VIZ_BINS] = {0};
+    if (spectrum_ready) audio_spectrum_read(&spectrum, levels, count);
     for (size_t i = 0; i < count; i++) {
-        float v = viz_levels[i];
+        float v = levels[i];
         if (v < 0.0f) v = 0.0f;
         if (v > 1.0f) v = 1.0f;
         out_levels[i] = (unsigned char)(v * 8.0f);
     }
-    pthread_mutex_unlock(&mp3_lock);
     return count;
 }
 
+void mp3_service_set_buffer_ms(unsigned ms) {
+    if (ms < MIN_RING_MS) ms = MIN_RING_MS;
+    if (ms > MAX_RING_MS) ms = MAX_RING_MS;
+    ring_ms = ms;
+}
+
+void mp3_service_set_volume(unsigned percent) {
+    if (percent > 100) percent = 100;
+    atomic_store(&master_volume, percent);
+    audio_mixer_t *mixer = mixer_service_get();
+    if (mixer) audio_mixer_set_gain(mixer, AUDIO_SOURCE_MUSIC, volume_to_q12(percent));
+    settings_service_set_int("volume", (int)percent);
+}
+
+unsigned mp3_service_get_volume(void) {
+    return atomic_load(&master_volume);
+}
+
+int mp3_service_eq_preset_count(void) {
+    return EQ_PRESET_COUNT;
+}
+
+const char *mp3_service_eq_preset_name(int preset) {
+    if (preset < 0 || preset >= EQ_PRESET_COUNT) return "";
+    return eq_presets[preset].name;
+}
+
+int mp3_service_get_eq_preset(void) {
+    return atomic_load(&eq_preset);
+}
+
+void mp3_service_set_eq_preset(int preset) {
+    if (preset < 0 || preset >= EQ_PRESET_COUNT) preset = 0;
+
+    float gains[AUDIO_EQ_BANDS];
+    for (int k = 0; k < AUDIO_EQ_BANDS; k++) {
+        gains[k] = (preset == EQ_PRESET_CUSTOM) ? (float)settings_service_get_int(eq_band_keys[k])
+                                                : eq_presets[preset].gains_db[k];
+    }
+
+    pthread_mutex_lock(&mp3_lock);
+    memcpy(eq_gains, gains, sizeof(eq_gains));
+    pthread_mutex_unlock(&mp3_lock);
+    atomic_store(&eq_preset, preset);
+    atomic_fetch_add(&eq_gen, 1);
+    settings_service_set_int("eq_preset", preset);
+}
+
+void mp3_service_get_stats(mp3_engine_stats *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+
+    unsigned bytes_per_sec = atomic_load(&stat_bytes_per_sec);
+    out->ring_capacity_bytes = pcm_ring.capacity;
+    if (pcm_ring.data) out->ring_fill_bytes = audio_ring_readable(&pcm_ring);
+    if (bytes_per_sec > 0) {
+        out->ring_capacity_ms = (unsigned)(out->ring_capacity_bytes * 1000 / bytes_per_sec);
+        out->ring_fill_ms = (unsigned)(out->ring_fill_bytes * 1000 / bytes_per_sec);
+    }
+    out->underruns = atomic_load(&stat_underruns);
+    out->blocks_decoded = atomic_load(&stat_blocks);
+    out->decode_us_last = atomic_load(&stat_decode_us_last);
+    out->decode_us_avg = atomic_load(&stat_decode_us_avg);
+    out->decode_us_max = atomic_load(&stat_decode_us_max);
+    out->eq_us_per_sec = atomic_load(&stat_eq_us_per_sec);
+    if (spectrum_ready) {
+        out->analysis_us_avg = atomic_load(&spectrum.cost_us_avg);
+        out->analysis_us_max = atomic_load(&spectrum.cost_us_max);
+        out->analysis_cpu_permille = out->analysis_us_avg * ANALYSIS_HZ / 1000;
+    }
+}
+
 void mp3_service_shutdown(void) {
     mp3_service_stop();
+    pthread_mutex_lock(&mp3_lock);
+    bookmark_quit = 1;
+    pthread_cond_signal(&bookmark_cond);
+    pthread_mutex_unlock(&mp3_lock);
+    if (bookmark_started) {
+        pthread_join(bookmark_thread, NULL);
+        bookmark_started = 0;
+    }
+    free(bookmarks);
+    free(bookmark_dirty);
+    bookmarks = NULL;
+    bookmark_dirty = NULL;
+    bookmark_log_records = 0;
+    plays_dirty = 0;
+    atomic_store(&loudness_quit, 1);
+    if (loudness_started) {
+        pthread_join(loudness_thread, NULL);
+        loudness_started = 0;
+    }
+    free(loudness);
+    loudness = NULL;
+    pthread_mutex_lock(&mp3_lock);
+    art_quit = 1;
+    pthread_cond_signal(&art_cond);
+    pthread_mutex_unlock(&mp3_lock);
+    if (art_started) {
+        pthread_join(art_thread, NULL);
+        art_started = 0;
+    }
+    pthread_mutex_lock(&mp3_lock);
+    free(content);
+    free(content_group);
+    content = NULL;
+    content_group = NULL;
+    free(art);
+    art = NULL;
+    pthread_mutex_unlock(&mp3_lock);
+    audio_ring_free(&pcm_ring);
+    if (spectrum_ready) {
+        audio_spectrum_free(&spectrum);
+        spectrum_ready = 0;
+    }
 
-    if (!library) return;
-    for (size_t i = 0; i < track_count; i++) {
-        free(library[i].author);
-        free(library[i].genre);
-        free(library[i].path);
-        free(library[i].title);
+    pthread_mutex_lock(&mp3_lock);
+    sort_quit = 1;
+    pthread_mutex_unlock(&mp3_lock);
+    if (sort_started) {
+        pthread_join(sort_thread, NULL);
+        sort_started = 0;
+    }
+    free(sorted);
+    free(track_names);
+    sorted = NULL;
+    track_names = NULL;
+    for (size_t p = 0; p < playlist_count; p++) {
+        track_query_free(&playlists[p].query);
+        track_bitset_free(&playlists[p].hits);
     }
+    free(playlists);
+    free(listed);
+    playlists = NULL;
+    playlist_count = 0;
+    listed = NULL;
+    listed_count = 0;
+    listed_playlist = -1;
+    listed_stale = 1;
+    track_table_free(&columns);
+    sort_order = MP3_SORT_FOLDER;
+    sort_wanted = MP3_SORT_FOLDER;
+
+    queue_save();
+    play_queue_free(&queue);
+    free(id_slots);
+    id_slots = NULL;
+    id_slot_mask = 0;
+
+    for (size_t i = 0; i < track_count; i++) free(library[i].path);
     free(library);
+    string_pool_free(&strings);
     library = NULL;
     track_count = 0;
     capacity = 0;
@@ -1,6 +1,9 @@
 #ifndef MP3_SERVICE_H
 #define MP3_SERVICE_H
 #include <stddef.h>
+#include <stdint.h>
+
+#include "play_queue.h"
 
 /*
  * mp3_service.h
@@ -20,6 +23,7 @@ typedef struct
 	char *author;	   /* Folder level 2 */
 	char *genre;	   /* Folder level 1 */
 	unsigned duration; /* Duration in seconds */
+	uint64_t id;	   /* Stable across rescans: hash of the path under the music root */
 } AudioFile;
 
 typedef enum
@@ -29,19 +33,104 @@ typedef enum
 	PAUSED
 } playback_state;
 
+/* Library display orders; ties keep folder order. */
+typedef enum
+{
+	MP3_SORT_ARTIST = 0,
+	MP3_SORT_TITLE,
+	MP3_SORT_GENRE,
+	MP3_SORT_FOLDER,
+	MP3_SORT_COUNT
+} mp3_sort_order;
+
+/* Visualizer frequency bands, log-spaced, lowest first. */
 #define MP3_VIZ_BINS 20
 
+/*
+ * Audio engine counters for tuning the decode-ahead buffer on the device.
+ * Fill levels are in the current output format; decode times are per
+ * mpg123_read() block.
+ */
+typedef struct
+{
+	size_t ring_capacity_bytes;
+	size_t ring_fill_bytes;
+	unsigned ring_capacity_ms;
+	unsigned ring_fill_ms;
+	unsigned long underruns;	   /* Times the output found the ring empty */
+	unsigned long blocks_decoded;
+	unsigned decode_us_last;
+	unsigned decode_us_avg;
+	unsigned decode_us_max;
+	unsigned eq_us_per_sec;		   /* Equalizer CPU time per second of audio */
+	unsigned analysis_us_avg;	   /* Spectrum frame cost */
+	unsigned analysis_us_max;
+	unsigned analysis_cpu_permille; /* Share of one core at ANALYSIS_HZ */
+} mp3_engine_stats;
+
 int mp3_service_init(const char *audio_root);
 void mp3_service_shutdown(void);
 size_t mp3_service_count(void);
 const AudioFile *mp3_service_get(size_t index);
-int mp3_service_play(size_t index);
+
+/*
+ * Library order by LC_COLLATE. Changing it re-sorts on a background
+ * thread and the old order shows until that is done; saved to settings.
+ */
+int mp3_service_sorted(size_t pos); /* Library index listed at pos, or -1 */
+size_t mp3_service_listed_count(void);
+void mp3_service_set_sort(mp3_sort_order order);
+mp3_sort_order mp3_service_get_sort(void);
+const char *mp3_service_sort_name(mp3_sort_order order);
+
+/*
+ * Smart playlists: "Recently added", "Most played", then the queries in
+ * <audio_root>/.playlists/<name>.query (see track_query.h). Choosing one
+ * lists only its tracks; -1 lists the whole library.
+ */
+size_t mp3_service_playlist_count(void);
+const char *mp3_service_playlist_name(int playlist);
+void mp3_service_set_playlist(int playlist);
+int mp3_service_get_playlist(void);
+int mp3_service_find(uint64_t id); /* Library index of a track id, or -1 */
+
+/*
+ * Cover image file for a track and a hash of its bytes, found once its
+ * decoder has opened it; -1 until then or if it has none.
+ */
+int mp3_service_get_art(size_t index, char *path, size_t path_size, uint64_t *key);
+
+/*
+ * Playback runs through a queue of the whole library. play() starts a new
+ * queue at index; play_queue() carries on with the queue restored from
+ * the last run. next/prev skip within it, wrapping when repeating all.
+ */
+int mp3_service_play(size_t index); /* Queues the listed tracks in order */
+int mp3_service_play_queue(void);
+int mp3_service_next(void);
+int mp3_service_prev(void);
+void mp3_service_set_shuffle(int on); /* Saved with the queue */
+int mp3_service_get_shuffle(void);
+void mp3_service_set_repeat(play_repeat mode);
+play_repeat mp3_service_get_repeat(void);
 void mp3_service_pause(void);
 void mp3_service_resume(void);
 void mp3_service_stop(void);
 playback_state mp3_service_get_state(void);
 int mp3_service_get_current_index(void);
 unsigned mp3_service_get_elapsed(void);
+unsigned long mp3_service_get_position_ms(void); /* Audible sample position */
+unsigned mp3_service_get_duration(void);		  /* 0 when not yet known */
+int mp3_service_seek_to_ms(unsigned long ms); /* -1 in the last moments of a track before the next */
+int mp3_service_seek(int delta_seconds);
 size_t mp3_service_get_visualizer(unsigned char *out_levels, size_t max_levels);
+void mp3_service_set_buffer_ms(unsigned ms); /* Applies from the next play */
+void mp3_service_get_stats(mp3_engine_stats *out);
+void mp3_service_set_volume(unsigned percent); /* 0..100, saved to settings */
+unsigned mp3_service_get_volume(void);
+int mp3_service_eq_preset_count(void);
+const char *mp3_service_eq_preset_name(int preset);
+int mp3_service_get_eq_preset(void);
+void mp3_service_set_eq_preset(int preset); /* Crossfades in, saved to settings */
 
 #endif
@@ -0,0 +1,814 @@
+#include "notes_index.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INDEX_MAGIC "BHNI"
+#define INDEX_VERSION 1
+#define QUERY_TERMS 8	   /* Query tokens after this are ignored */
+#define TITLE_WEIGHT 3	   /* A title word counts as this many body words */
+#define PREFIX_WEIGHT 0.8f /* A word the typed prefix completes, against the word itself */
+#define BM25_K1 1.2f
+#define BM25_B 0.75f
+
+/*
+ * File layout, host byte order like the other caches:
+ *
+ *   header
+ *   file_doc_t[docs]
+ *   file_term_t[terms]     sorted by text
+ *   strings                note names and term texts, NUL-terminated, padded to 8
+ *   postings               per term: for each note by id, varint id gap, count and
+ *                          title count; then for each note, varint position gaps
+ *
+ * A search reads only the counts; the positions are kept apart so it never
+ * has to step over them.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t docs;
+    uint32_t terms;
+    uint64_t strings_bytes;
+    uint64_t postings_bytes;
+} file_header_t;
+
+typedef struct {
+    int64_t mtime;
+    uint64_t size;
+    uint32_t name; /* Offset into strings */
+    uint32_t title_tokens;
+    uint32_t tokens;
+    uint32_t reserved;
+} file_doc_t;
+
+typedef struct {
+    uint32_t text;
+    uint32_t notes;
+    uint64_t postings;  /* Offset into postings of the counts */
+    uint64_t positions; /* and of the positions, which run to the next term's counts */
+} file_term_t;
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} byte_buf_t;
+
+static uint64_t hash_string(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int is_token_byte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+size_t notes_index_next_token(const char **text, char out[NOTES_INDEX_TOKEN_MAX + 1]) {
+    const unsigned char *p = (const unsigned char *)*text;
+    while (*p && !is_token_byte(*p)) p++;
+    size_t n = 0;
+    while (*p && is_token_byte(*p)) {
+        if (n < NOTES_INDEX_TOKEN_MAX) {
+            out[n++] = (char)((*p >= 'A' && *p <= 'Z') ? *p + ('a' - 'A') : *p);
+        }
+        p++;
+    }
+    out[n] = '\0';
+    *text = (const char *)p;
+    return n;
+}
+
+/* ── Byte buffers and varints ─────────────────────────────────────────── */
+
+static int buf_put(byte_buf_t *b, const void *data, size_t bytes) {
+    if (b->len + bytes > b->cap) {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + bytes) cap *= 2;
+        unsigned char *grown = realloc(b->data, cap);
+        if (!grown) return -1;
+        b->data = grown;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, data, bytes);
+    b->len += bytes;
+    return 0;
+}
+
+static int buf_varint(byte_buf_t *b, uint32_t v) {
+    unsigned char bytes[5];
+    size_t n = 0;
+    while (v >= 0x80) {
+        bytes[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    bytes[n++] = (unsigned char)v;
+    return buf_put(b, bytes, n);
+}
+
+/* Decode one varint below end; NULL on a truncated or overlong one. */
+static const unsigned char *read_varint(const unsigned char *p, const unsigned char *end, uint32_t *out) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        unsigned char c = *p++;
+        v |= (uint32_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            *out = v;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* One file posting: note id gap, count, title count. */
+static const unsigned char *read_entry(const unsigned char *p, const unsigned char *end, uint32_t e[3]) {
+    for (int k = 0; k < 3 && p; k++) p = read_varint(p, end, &e[k]);
+    return p;
+}
+
+/* ── Hash tables ──────────────────────────────────────────────────────── */
+
+static const char *doc_key(const notes_index_t *ix, uint32_t id) {
+    return ix->docs[id].name;
+}
+
+static const char *term_key(const notes_index_t *ix, uint32_t id) {
+    return ix->terms[id].text;
+}
+
+static long table_find(const notes_index_t *ix, const uint32_t *slots, size_t mask,
+                       const char *(*key)(const notes_index_t *, uint32_t), const char *s) {
+    if (!slots) return -1;
+    for (size_t i = hash_string(s) & mask;; i = (i + 1) & mask) {
+        if (slots[i] == 0) return -1;
+        if (strcmp(key(ix, slots[i] - 1), s) == 0) return (long)(slots[i] - 1);
+    }
+}
+
+/* Make room for one more entry at load <= 1/2, rehashing count existing ones. */
+static int table_reserve(notes_index_t *ix, uint32_t **slots, size_t *mask, size_t count,
+                         const char *(*key)(const notes_index_t *, uint32_t)) {
+    if (*slots && (count + 1) * 2 <= *mask + 1) return 0;
+    size_t size = *slots ? (*mask + 1) * 2 : 256;
+    uint32_t *grown = calloc(size, sizeof(*grown));
+    if (!grown) return -1;
+    for (uint32_t id = 0; id < count; id++) {
+        size_t i = hash_string(key(ix, id)) & (size - 1);
+        while (grown[i]) i = (i + 1) & (size - 1);
+        grown[i] = id + 1;
+    }
+    free(*slots);
+    *slots = grown;
+    *mask = size - 1;
+    return 0;
+}
+
+static void table_insert(notes_index_t *ix, uint32_t *slots, size_t mask, uint32_t id,
+                         const char *(*key)(const notes_index_t *, uint32_t)) {
+    size_t i = hash_string(key(ix, id)) & mask;
+    while (slots[i]) i = (i + 1) & mask;
+    slots[i] = id + 1;
+}
+
+static long add_doc(notes_index_t *ix, const char *name) {
+    if (ix->doc_count == ix->doc_capacity) {
+        size_t cap = ix->doc_capacity ? ix->doc_capacity * 2 : 64;
+        notes_index_doc_t *docs = realloc(ix->docs, cap * sizeof(*docs));
+        if (!docs) return -1;
+        ix->docs = docs;
+        ix->doc_capacity = cap;
+    }
+    if (table_reserve(ix, &ix->doc_slots, &ix->doc_mask, ix->doc_count, doc_key) != 0) return -1;
+    notes_index_doc_t *d = &ix->docs[ix->doc_count];
+    memset(d, 0, sizeof(*d));
+    if (!(d->name = strdup(name))) return -1;
+    table_insert(ix, ix->doc_slots, ix->doc_mask, (uint32_t)ix->doc_count, doc_key);
+    return (long)ix->doc_count++;
+}
+
+static long term_id(notes_index_t *ix, const char *text) {
+    long id = table_find(ix, ix->term_slots, ix->term_mask, term_key, text);
+    if (id >= 0) return id;
+    if (ix->term_count == ix->term_capacity) {
+        size_t cap = ix->term_capacity ? ix->term_capacity * 2 : 1024;
+        notes_index_term_t *terms = realloc(ix->terms, cap * sizeof(*terms));
+        if (!terms) return -1;
+        ix->terms = terms;
+        ix->term_capacity = cap;
+    }
+    if (table_reserve(ix, &ix->term_slots, &ix->term_mask, ix->term_count, term_key) != 0) return -1;
+    notes_index_term_t *t = &ix->terms[ix->term_count];
+    memset(t, 0, sizeof(*t));
+    if (!(t->text = strdup(text))) return -1;
+    table_insert(ix, ix->term_slots, ix->term_mask, (uint32_t)ix->term_count, term_key);
+    return (long)ix->term_count++;
+}
+
+/* ── Mapped file ──────────────────────────────────────────────────────── */
+
+static const file_term_t *file_term(const notes_index_t *ix, uint32_t i) {
+    return (const file_term_t *)ix->file_terms + i;
+}
+
+/* First file term not ordered before text. */
+static uint32_t file_lower_bound(const notes_index_t *ix, const char *text) {
+    uint32_t lo = 0;
+    uint32_t hi = ix->file_term_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(ix->file_strings + file_term(ix, mid)->text, text) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static long file_find(const notes_index_t *ix, const char *text) {
+    uint32_t i = file_lower_bound(ix, text);
+    if (i < ix->file_term_count && strcmp(ix->file_strings + file_term(ix, i)->text, text) == 0) return (long)i;
+    return -1;
+}
+
+static void file_postings(const notes_index_t *ix, uint32_t i, const unsigned char **p, const unsigned char **end) {
+    *p = ix->file_postings + file_term(ix, i)->postings;
+    *end = ix->file_postings + file_term(ix, i)->positions;
+}
+
+static void file_positions(const notes_index_t *ix, uint32_t i, const unsigned char **p, const unsigned char **end) {
+    uint64_t to = i + 1 < ix->file_term_count ? file_term(ix, i + 1)->postings : ix->file_postings_bytes;
+    *p = ix->file_postings + file_term(ix, i)->positions;
+    *end = ix->file_postings + to;
+}
+
+/* Check every offset in the file so a damaged one cannot be read past its end. */
+static int map_file(notes_index_t *ix, const unsigned char *map, size_t size) {
+    const file_header_t *h = (const file_header_t *)map;
+    if (size < sizeof(*h) || memcmp(h->magic, INDEX_MAGIC, 4) != 0 || h->version != INDEX_VERSION) return -1;
+    uint64_t strings_padded = (h->strings_bytes + 7) & ~(uint64_t)7;
+    uint64_t expect = sizeof(*h) + (uint64_t)h->docs * sizeof(file_doc_t) + (uint64_t)h->terms * sizeof(file_term_t) +
+                      strings_padded + h->postings_bytes;
+    if (expect != size || h->strings_bytes > UINT32_MAX) return -1;
+    if (h->strings_bytes > 0 && map[sizeof(*h) + h->docs * sizeof(file_doc_t) + h->terms * sizeof(file_term_t) +
+                                     h->strings_bytes - 1] != '\0') {
+        return -1;
+    }
+
+    const file_doc_t *docs = (const file_doc_t *)(map + sizeof(*h));
+    ix->file_terms = docs + h->docs;
+    ix->file_term_count = h->terms;
+    ix->file_strings = (const char *)((const file_term_t *)ix->file_terms + h->terms);
+    ix->file_postings = (const unsigned char *)ix->file_strings + strings_padded;
+    ix->file_postings_bytes = h->postings_bytes;
+
+    uint64_t last = 0;
+    for (uint32_t i = 0; i < h->terms; i++) {
+        const file_term_t *t = file_term(ix, i);
+        if (t->text >= h->strings_bytes || t->postings < last || t->positions < t->postings ||
+            t->positions > h->postings_bytes) {
+            return -1;
+        }
+        last = t->positions;
+    }
+    for (uint32_t i = 0; i < h->docs; i++) {
+        if (docs[i].name >= h->strings_bytes) return -1;
+        long id = add_doc(ix, ix->file_strings + docs[i].name);
+        if (id < 0) return -1;
+        notes_index_doc_t *d = &ix->docs[id];
+        d->mtime = docs[i].mtime;
+        d->size = docs[i].size;
+        d->title_tokens = docs[i].title_tokens;
+        d->tokens = docs[i].tokens;
+        d->live = 1;
+        d->in_file = 1;
+        ix->live_docs++;
+        ix->live_tokens += d->tokens;
+    }
+    /* A file listing one name twice is not one this code wrote. */
+    return ix->doc_count == h->docs ? 0 : -1;
+}
+
+int notes_index_open(notes_index_t *ix, const char *path) {
+    memset(ix, 0, sizeof(*ix));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    if (map_file(ix, map, (size_t)st.st_size) != 0) {
+        munmap(map, (size_t)st.st_size);
+        notes_index_close(ix);
+        return -1;
+    }
+    ix->map = map;
+    ix->map_size = (size_t)st.st_size;
+    return 0;
+}
+
+void notes_index_close(notes_index_t *ix) {
+    for (size_t i = 0; i < ix->doc_count; i++) {
+        free(ix->docs[i].name);
+        free(ix->docs[i].terms);
+    }
+    for (size_t i = 0; i < ix->term_count; i++) {
+        free(ix->terms[i].text);
+        free(ix->terms[i].postings);
+    }
+    free(ix->docs);
+    free(ix->doc_slots);
+    free(ix->terms);
+    free(ix->term_slots);
+    if (ix->map) munmap((void *)ix->map, ix->map_size);
+    memset(ix, 0, sizeof(*ix));
+}
+
+/* ── Updates ──────────────────────────────────────────────────────────── */
+
+/* Take a note out of the index, leaving its id for the name. */
+static void unindex(notes_index_t *ix, uint32_t id) {
+    notes_index_doc_t *d = &ix->docs[id];
+    for (size_t k = 0; k < d->term_count; k++) {
+        notes_index_term_t *t = &ix->terms[d->terms[k]];
+        for (size_t p = 0; p < t->len; p += 2 + t->postings[p + 1]) {
+            if (t->postings[p] != id) continue;
+            size_t entry = 2 + t->postings[p + 1];
+            memmove(t->postings + p, t->postings + p + entry, (t->len - p - entry) * sizeof(uint32_t));
+            t->len -= entry;
+            t->notes--;
+            break;
+        }
+    }
+    free(d->terms);
+    d->terms = NULL;
+    d->term_count = 0;
+    if (d->live) {
+        ix->live_docs--;
+        ix->live_tokens -= d->tokens;
+    }
+    d->live = 0;
+    d->in_file = 0;
+}
+
+typedef struct {
+    uint32_t term;
+    uint32_t pos;
+} token_hit_t;
+
+static int token_hit_cmp(const void *a, const void *b) {
+    const token_hit_t *x = a;
+    const token_hit_t *y = b;
+    if (x->term != y->term) return x->term < y->term ? -1 : 1;
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+static int collect_tokens(notes_index_t *ix, const char *text, token_hit_t **hits, size_t *count, size_t *cap) {
+    char token[NOTES_INDEX_TOKEN_MAX + 1];
+    while (text && notes_index_next_token(&text, token) > 0) {
+        long t = term_id(ix, token);
+        if (t < 0) return -1;
+        if (*count == *cap) {
+            size_t grown_cap = *cap ? *cap * 2 : 256;
+            token_hit_t *grown = realloc(*hits, grown_cap * sizeof(*grown));
+            if (!grown) return -1;
+            *hits = grown;
+            *cap = grown_cap;
+        }
+        (*hits)[*count] = (token_hit_t){ (uint32_t)t, (uint32_t)*count };
+        (*count)++;
+    }
+    return 0;
+}
+
+int notes_index_put(notes_index_t *ix, const char *name, int64_t mtime, uint64_t size, const char *title,
+                    const char *body) {
+    long id = table_find(ix, ix->doc_slots, ix->doc_mask, doc_key, name);
+    if (id < 0) id = add_doc(ix, name);
+    if (id < 0) return -1;
+    unindex(ix, (uint32_t)id);
+    ix->dirty = 1;
+
+    token_hit_t *hits = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    if (collect_tokens(ix, title, &hits, &count, &cap) != 0) goto fail;
+    size_t title_tokens = count;
+    if (collect_tokens(ix, body, &hits, &count, &cap) != 0) goto fail;
+    qsort(hits, count, sizeof(*hits), token_hit_cmp);
+
+    notes_index_doc_t *d = &ix->docs[id];
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; i++) distinct += i == 0 || hits[i].term != hits[i - 1].term;
+    d->terms = malloc((distinct ? distinct : 1) * sizeof(*d->terms));
+    if (!d->terms) goto fail;
+
+    for (size_t run = 0; run < count;) {
+        size_t end = run + 1;
+        while (end < count && hits[end].term == hits[run].term) end++;
+        notes_index_term_t *t = &ix->terms[hits[run].term];
+        size_t need = t->len + 2 + (end - run);
+        if (need > t->cap) {
+            size_t grown_cap = t->cap ? t->cap : 8;
+            while (grown_cap < need) grown_cap *= 2;
+            uint32_t *grown = realloc(t->postings, grown_cap * sizeof(*grown));
+            if (!grown) goto fail;
+            t->postings = grown;
+            t->cap = grown_cap;
+        }
+        t->postings[t->len++] = (uint32_t)id;
+        t->postings[t->len++] = (uint32_t)(end - run);
+        for (size_t k = run; k < end; k++) t->postings[t->len++] = hits[k].pos;
+        t->notes++;
+        d->terms[d->term_count++] = hits[run].term;
+        run = end;
+    }
+    free(hits);
+
+    d->mtime = mtime;
+    d->size = size;
+    d->title_tokens = (uint32_t)title_tokens;
+    d->tokens = (uint32_t)count;
+    d->live = 1;
+    ix->live_docs++;
+    ix->live_tokens += count;
+    return 0;
+
+fail:
+    free(hits);
+    unindex(ix, (uint32_t)id); /* Nothing half-indexed stays */
+    return -1;
+}
+
+void notes_index_remove(notes_index_t *ix, const char *name) {
+    long id = table_find(ix, ix->doc_slots, ix->doc_mask, doc_key, name);
+    if (id < 0 || !ix->docs[id].live) return;
+    unindex(ix, (uint32_t)id);
+    ix->dirty = 1;
+}
+
+int notes_index_stamp(const notes_index_t *ix, const char *name, int64_t *mtime, uint64_t *size) {
+    long id = table_find(ix, ix->doc_slots, ix->doc_mask, doc_key, name);
+    if (id < 0 || !ix->docs[id].live) return -1;
+    *mtime = ix->docs[id].mtime;
+    *size = ix->docs[id].size;
+    return 0;
+}
+
+/* ── Search ───────────────────────────────────────────────────────────── */
+
+typedef struct {
+    const notes_index_t *ix;
+    float *score;
+    uint8_t *matched; /* Query terms matched so far */
+    uint8_t term;	  /* Index of the query term being scored */
+    float avg_tokens;
+} search_state_t;
+
+static float idf(const search_state_t *s, uint32_t notes) {
+    float n = (float)s->ix->live_docs;
+    float df = (float)(notes < s->ix->live_docs ? notes : s->ix->live_docs);
+    return logf(1.0f + (n - df + 0.5f) / (df + 0.5f));
+}
+
+/* Score one note for the current term; notes that missed an earlier term are skipped. */
+static void score_note(search_state_t *s, uint32_t doc, uint32_t tf, uint32_t title_tf, float weight) {
+    uint8_t m = s->matched[doc];
+    if (m != s->term && m != s->term + 1) return;
+    const notes_index_doc_t *d = &s->ix->docs[doc];
+    float f = (float)(tf + (TITLE_WEIGHT - 1) * title_tf);
+    float norm = BM25_K1 * (1.0f - BM25_B + BM25_B * (float)d->tokens / s->avg_tokens);
+    s->score[doc] += weight * f * (BM25_K1 + 1.0f) / (f + norm);
+    s->matched[doc] = s->term + 1;
+}
+
+static void score_file_term(search_state_t *s, uint32_t i, float weight) {
+    const notes_index_t *ix = s->ix;
+    const unsigned char *p;
+    const unsigned char *end;
+    file_postings(ix, i, &p, &end);
+    uint32_t doc = 0;
+    int first = 1;
+    while (p < end) {
+        uint32_t e[3];
+        if (!(p = read_entry(p, end, e))) return;
+        doc = first ? e[0] : doc + e[0];
+        first = 0;
+        if (doc < ix->doc_count && ix->docs[doc].in_file) score_note(s, doc, e[1], e[2], weight);
+    }
+}
+
+static void score_memory_term(search_state_t *s, const notes_index_term_t *t, float weight) {
+    for (size_t p = 0; p < t->len; p += 2 + t->postings[p + 1]) {
+        uint32_t doc = t->postings[p];
+        uint32_t tf = t->postings[p + 1];
+        uint32_t title_tf = 0;
+        for (uint32_t k = 0; k < tf; k++) title_tf += t->postings[p + 2 + k] < s->ix->docs[doc].title_tokens;
+        score_note(s, doc, tf, title_tf, weight);
+    }
+}
+
+/* Score one dictionary word from either part, with its note count across both. */
+static void score_word(search_state_t *s, long file_i, long memory_i, float weight) {
+    uint32_t notes = 0;
+    if (file_i >= 0) notes += file_term(s->ix, (uint32_t)file_i)->notes;
+    if (memory_i >= 0) notes += s->ix->terms[memory_i].notes;
+    weight *= idf(s, notes);
+    if (file_i >= 0) score_file_term(s, (uint32_t)file_i, weight);
+    if (memory_i >= 0) score_memory_term(s, &s->ix->terms[memory_i], weight);
+}
+
+static void score_query_term(search_state_t *s, const char *token, int prefix) {
+    const notes_index_t *ix = s->ix;
+    if (!prefix) {
+        score_word(s, file_find(ix, token), table_find(ix, ix->term_slots, ix->term_mask, term_key, token), 1.0f);
+        return;
+    }
+
+    /* Every word starting with the prefix: the file's are one sorted run. */
+    size_t len = strlen(token);
+    for (uint32_t i = file_lower_bound(ix, token); i < ix->file_term_count; i++) {
+        const char *text = ix->file_strings + file_term(ix, i)->text;
+        if (strncmp(text, token, len) != 0) break;
+        score_word(s, i, table_find(ix, ix->term_slots, ix->term_mask, term_key, text),
+                   text[len] ? PREFIX_WEIGHT : 1.0f);
+    }
+    for (size_t i = 0; i < ix->term_count; i++) {
+        const char *text = ix->terms[i].text;
+        if (ix->terms[i].notes == 0 || strncmp(text, token, len) != 0 || file_find(ix, text) >= 0) continue;
+        score_word(s, -1, (long)i, text[len] ? PREFIX_WEIGHT : 1.0f);
+    }
+}
+
+static int hit_before(const notes_index_hit_t *a, const notes_index_hit_t *b) {
+    if (a->score != b->score) return a->score > b->score;
+    return a->mtime > b->mtime;
+}
+
+size_t notes_index_search(const notes_index_t *ix, const char *query, notes_index_hit_t *out, size_t max) {
+    char tokens[QUERY_TERMS][NOTES_INDEX_TOKEN_MAX + 1];
+    size_t count = 0;
+    const char *q = query;
+    while (count < QUERY_TERMS && notes_index_next_token(&q, tokens[count]) > 0) count++;
+    if (count == 0 || ix->live_docs == 0) return 0;
+    size_t qlen = strlen(query);
+    int typing = is_token_byte((unsigned char)query[qlen - 1]) && *q == '\0';
+
+    search_state_t s = { .ix = ix };
+    s.score = calloc(ix->doc_count, sizeof(*s.score));
+    s.matched = calloc(ix->doc_count, sizeof(*s.matched));
+    if (!s.score || !s.matched) {
+        free(s.score);
+        free(s.matched);
+        return 0;
+    }
+    s.avg_tokens = (float)ix->live_tokens / (float)ix->live_docs;
+    if (s.avg_tokens < 1.0f) s.avg_tokens = 1.0f;
+
+    for (size_t t = 0; t < count; t++) {
+        s.term = (uint8_t)t;
+        score_query_term(&s, tokens[t], typing && t == count - 1);
+    }
+
+    /* Keep the best max in order; there are rarely many. */
+    size_t matches = 0;
+    size_t kept = 0;
+    for (size_t doc = 0; doc < ix->doc_count; doc++) {
+        if (s.matched[doc] != count) continue;
+        matches++;
+        notes_index_hit_t hit = { ix->docs[doc].name, s.score[doc], ix->docs[doc].mtime };
+        size_t at = kept;
+        while (at > 0 && hit_before(&hit, &out[at - 1])) at--;
+        if (at >= max) continue;
+        if (kept < max) kept++;
+        memmove(out + at + 1, out + at, (kept - 1 - at) * sizeof(*out));
+        out[at] = hit;
+    }
+    free(s.score);
+    free(s.matched);
+    return matches;
+}
+
+/* ── Saving ───────────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t doc;
+    uint32_t title_tf;
+    size_t at; /* Entry start in the scratch list */
+} save_entry_t;
+
+static int save_entry_cmp(const void *a, const void *b) {
+    uint32_t x = ((const save_entry_t *)a)->doc;
+    uint32_t y = ((const save_entry_t *)b)->doc;
+    return (x > y) - (x < y);
+}
+
+static const notes_index_t *sort_ix; /* qsort has no context argument; saves run on one thread */
+
+static int memory_term_cmp(const void *a, const void *b) {
+    return strcmp(sort_ix->terms[*(const uint32_t *)a].text, sort_ix->terms[*(const uint32_t *)b].text);
+}
+
+typedef struct {
+    uint32_t *scratch; /* Entries as in memory postings, renumbered */
+    size_t len;
+    size_t cap;
+    save_entry_t *entries;
+    size_t count;
+    size_t entry_cap;
+} save_list_t;
+
+static int save_list_add(save_list_t *l, uint32_t doc, uint32_t tf) {
+    if (l->count == l->entry_cap) {
+        size_t cap = l->entry_cap ? l->entry_cap * 2 : 256;
+        save_entry_t *grown = realloc(l->entries, cap * sizeof(*grown));
+        if (!grown) return -1;
+        l->entries = grown;
+        l->entry_cap = cap;
+    }
+    if (l->len + 2 + tf > l->cap) {
+        size_t cap = l->cap ? l->cap : 1024;
+        while (cap < l->len + 2 + tf) cap *= 2;
+        uint32_t *grown = realloc(l->scratch, cap * sizeof(*grown));
+        if (!grown) return -1;
+        l->scratch = grown;
+        l->cap = cap;
+    }
+    l->entries[l->count++] = (save_entry_t){ doc, 0, l->len };
+    l->scratch[l->len++] = doc;
+    l->scratch[l->len++] = tf;
+    return 0;
+}
+
+/* One word's postings from both parts, renumbered and sorted by note. */
+static int gather_word(const notes_index_t *ix, const uint32_t *remap, long file_i, long memory_i, save_list_t *l) {
+    l->len = 0;
+    l->count = 0;
+    if (file_i >= 0) {
+        const unsigned char *p;
+        const unsigned char *end;
+        const unsigned char *pp;
+        const unsigned char *pend;
+        file_postings(ix, (uint32_t)file_i, &p, &end);
+        file_positions(ix, (uint32_t)file_i, &pp, &pend);
+        uint32_t doc = 0;
+        int first = 1;
+        while (p < end) {
+            uint32_t e[3];
+            if (!(p = read_entry(p, end, e))) return -1;
+            doc = first ? e[0] : doc + e[0];
+            first = 0;
+            int current = doc < ix->doc_count && ix->docs[doc].in_file;
+            if (current) {
+                if (save_list_add(l, remap[doc], e[1]) != 0) return -1;
+                l->entries[l->count - 1].title_tf = e[2];
+            }
+            uint32_t pos = 0;
+            for (uint32_t k = 0; k < e[1]; k++) {
+                uint32_t g;
+                if (!(pp = read_varint(pp, pend, &g))) return -1;
+                pos = k == 0 ? g : pos + g;
+                if (current) l->scratch[l->len++] = pos;
+            }
+        }
+    }
+    if (memory_i >= 0) {
+        const notes_index_term_t *t = &ix->terms[memory_i];
+        for (size_t p = 0; p < t->len; p += 2 + t->postings[p + 1]) {
+            uint32_t tf = t->postings[p + 1];
+            uint32_t title_tokens = ix->docs[t->postings[p]].title_tokens;
+            if (save_list_add(l, remap[t->postings[p]], tf) != 0) return -1;
+            for (uint32_t k = 0; k < tf; k++) {
+                uint32_t pos = t->postings[p + 2 + k];
+                l->entries[l->count - 1].title_tf += pos < title_tokens;
+                l->scratch[l->len++] = pos;
+            }
+        }
+    }
+    qsort(l->entries, l->count, sizeof(*l->entries), save_entry_cmp);
+    return 0;
+}
+
+/* Counts, then positions; returns the offset where the positions start, or -1. */
+static long long encode_word(byte_buf_t *postings, const save_list_t *l) {
+    uint32_t last_doc = 0;
+    for (size_t e = 0; e < l->count; e++) {
+        const uint32_t *entry = l->scratch + l->entries[e].at;
+        if (buf_varint(postings, entry[0] - last_doc) != 0 || buf_varint(postings, entry[1]) != 0 ||
+            buf_varint(postings, l->entries[e].title_tf) != 0) {
+            return -1;
+        }
+        last_doc = entry[0];
+    }
+    long long positions = (long long)postings->len;
+    for (size_t e = 0; e < l->count; e++) {
+        const uint32_t *entry = l->scratch + l->entries[e].at;
+        uint32_t last_pos = 0;
+        for (uint32_t k = 0; k < entry[1]; k++) {
+            if (buf_varint(postings, entry[2 + k] - last_pos) != 0) return -1;
+            last_pos = entry[2 + k];
+        }
+    }
+    return positions;
+}
+
+int notes_index_save(const notes_index_t *ix, const char *path) {
+    byte_buf_t docs = { 0 };
+    byte_buf_t terms = { 0 };
+    byte_buf_t strings = { 0 };
+    byte_buf_t postings = { 0 };
+    save_list_t list = { 0 };
+    uint32_t *remap = malloc((ix->doc_count ? ix->doc_count : 1) * sizeof(*remap));
+    uint32_t *order = malloc((ix->term_count ? ix->term_count : 1) * sizeof(*order));
+    int ok = remap && order;
+
+    uint32_t doc_total = 0;
+    for (size_t i = 0; ok && i < ix->doc_count; i++) {
+        const notes_index_doc_t *d = &ix->docs[i];
+        remap[i] = d->live ? doc_total : UINT32_MAX;
+        if (!d->live) continue;
+        file_doc_t fd = { d->mtime, d->size, (uint32_t)strings.len, d->title_tokens, d->tokens, 0 };
+        ok = buf_put(&docs, &fd, sizeof(fd)) == 0 && buf_put(&strings, d->name, strlen(d->name) + 1) == 0;
+        doc_total++;
+    }
+
+    /* Merge the file's sorted words with the memory part's, sorted here. */
+    size_t memory_words = 0;
+    for (size_t i = 0; ok && i < ix->term_count; i++) {
+        if (ix->terms[i].notes > 0) order[memory_words++] = (uint32_t)i;
+    }
+    sort_ix = ix;
+    if (ok) qsort(order, memory_words, sizeof(*order), memory_term_cmp);
+
+    uint32_t term_total = 0;
+    uint32_t fi = 0;
+    size_t mi = 0;
+    while (ok && (fi < ix->file_term_count || mi < memory_words)) {
+        const char *ftext = fi < ix->file_term_count ? ix->file_strings + file_term(ix, fi)->text : NULL;
+        const char *mtext = mi < memory_words ? ix->terms[order[mi]].text : NULL;
+        int c = !ftext ? 1 : !mtext ? -1 : strcmp(ftext, mtext);
+        long file_i = c <= 0 ? (long)fi++ : -1;
+        long memory_i = c >= 0 ? (long)order[mi++] : -1;
+        const char *text = c <= 0 ? ftext : mtext;
+
+        if (gather_word(ix, remap, file_i, memory_i, &list) != 0) {
+            ok = 0;
+            break;
+        }
+        if (list.count == 0) continue;
+        file_term_t ft = { (uint32_t)strings.len, (uint32_t)list.count, postings.len, 0 };
+        long long positions = encode_word(&postings, &list);
+        ft.positions = (uint64_t)positions;
+        ok = positions >= 0 && buf_put(&strings, text, strlen(text) + 1) == 0 && buf_put(&terms, &ft, sizeof(ft)) == 0;
+        term_total++;
+    }
+
+    file_header_t h = { { 0 }, INDEX_VERSION, doc_total, term_total, strings.len, postings.len };
+    memcpy(h.magic, INDEX_MAGIC, 4);
+    static const unsigned char pad[8];
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = ok ? fopen(tmp, "wb") : NULL;
+    if (f) {
+        ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(docs.data, 1, docs.len, f) == docs.len &&
+             fwrite(terms.data, 1, terms.len, f) == terms.len && fwrite(strings.data, 1, strings.len, f) == strings.len &&
+             fwrite(pad, 1, (8 - strings.len % 8) % 8, f) == (8 - strings.len % 8) % 8 &&
+             fwrite(postings.data, 1, postings.len, f) == postings.len;
+        if (fclose(f) != 0) ok = 0;
+        if (!ok || rename(tmp, path) != 0) {
+            remove(tmp);
+            ok = 0;
+        }
+    } else {
+        ok = 0;
+    }
+
+    free(docs.data);
+    free(terms.data);
+    free(strings.data);
+    free(postings.data);
+    free(list.scratch);
+    free(list.entries);
+    free(remap);
+    free(order);
+    return ok ? 0 : -1;
+}
+
+int notes_index_reload(notes_index_t *ix, const char *path) {
+    notes_index_close(ix);
+    return notes_index_open(ix, path);
+}
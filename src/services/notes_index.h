@@ -0,0 +1,114 @@
+#ifndef NOTES_INDEX_H
+#define NOTES_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * notes_index.h
+ *
+ * Full-text index over the notes: for every token, the notes holding it
+ * and the token positions within each note. A token is a run of ASCII
+ * letters and digits, folded to lower case, or of non-ASCII (UTF-8)
+ * bytes, which are kept as they are. A note's title comes first, so
+ * positions below its title_tokens are title words.
+ *
+ * The index has two parts. The saved part is a file mapped read-only and
+ * searched in place: a sorted term table and, per term, a posting list of
+ * varint-coded note id gaps, counts and position gaps. Notes added or
+ * changed since it was written live in memory, and their postings in the
+ * file are masked out. notes_index_save() merges both into a new file and
+ * notes_index_reload() maps it in place of the memory part.
+ *
+ * Not thread-safe; the caller serializes access. Searching does not
+ * modify the index, so searches may run alongside notes_index_save().
+ */
+
+#define NOTES_INDEX_TOKEN_MAX 32 /* Bytes; longer tokens are cut */
+
+typedef struct
+{
+	char *name;			/* Note file name, owned */
+	int64_t mtime;		/* File stamp when indexed */
+	uint64_t size;
+	uint32_t title_tokens;
+	uint32_t tokens;
+	uint32_t *terms;	/* Memory terms holding this note */
+	size_t term_count;
+	uint8_t live;
+	uint8_t in_file;	/* Its postings in the mapped file are current */
+} notes_index_doc_t;
+
+typedef struct
+{
+	char *text;
+	uint32_t *postings; /* Per note: id, count, positions */
+	size_t len;
+	size_t cap;
+	uint32_t notes;
+} notes_index_term_t;
+
+typedef struct
+{
+	/* Mapped file */
+	const unsigned char *map;
+	size_t map_size;
+	const void *file_terms;
+	uint32_t file_term_count;
+	const char *file_strings;
+	const unsigned char *file_postings;
+	uint64_t file_postings_bytes;
+
+	/* Every note, mapped or not; the id is the index */
+	notes_index_doc_t *docs;
+	size_t doc_count;
+	size_t doc_capacity;
+	uint32_t *doc_slots; /* Hash by name: id + 1, 0 when empty */
+	size_t doc_mask;
+	size_t live_docs;
+	uint64_t live_tokens;
+
+	notes_index_term_t *terms;
+	size_t term_count;
+	size_t term_capacity;
+	uint32_t *term_slots;
+	size_t term_mask;
+
+	int dirty; /* Changed since the file was written */
+} notes_index_t;
+
+typedef struct
+{
+	const char *name; /* Valid until the index changes */
+	float score;
+	int64_t mtime;
+} notes_index_hit_t;
+
+/* Map the file at path if it is a valid index, else start empty. */
+int notes_index_open(notes_index_t *ix, const char *path);
+void notes_index_close(notes_index_t *ix);
+
+/* Index a note's text, replacing what was indexed under name. */
+int notes_index_put(notes_index_t *ix, const char *name, int64_t mtime, uint64_t size, const char *title,
+					const char *body);
+void notes_index_remove(notes_index_t *ix, const char *name);
+
+/* The file stamp name was indexed with; -1 if it is not indexed. */
+int notes_index_stamp(const notes_index_t *ix, const char *name, int64_t *mtime, uint64_t *size);
+
+/* Write everything to path (through path.tmp), then map it back in place of the memory part. */
+int notes_index_save(const notes_index_t *ix, const char *path);
+int notes_index_reload(notes_index_t *ix, const char *path);
+
+/*
+ * Notes holding every token of query, best first (BM25, title words
+ * counting triple). While the user is typing, the last token also
+ * matches as a prefix. Fills up to max hits; returns the number of
+ * matching notes.
+ */
+size_t notes_index_search(const notes_index_t *ix, const char *query, notes_index_hit_t *out, size_t max);
+
+/* Next token of *text into out (NUL-terminated); 0 at the end of the text. */
+size_t notes_index_next_token(const char **text, char out[NOTES_INDEX_TOKEN_MAX + 1]);
+
+#endif
@@ -1,20 +1,112 @@
 #include "notes_service.h"
+#include "notes_index.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <time.h>
+#include <unistd.h>
 
 #define INITIAL_NOTES_CAPACITY 16
 #define MAX_LINE_LENGTH 256
+#define NOTE_HEADER_BYTES 512			/* Read at startup: the Title and Created lines */
+#define NOTES_CACHE_BYTES (256 * 1024)	/* Note bodies kept in memory */
+#define INDEX_SAVE_DELAY_SEC 2			/* Quiet time before the search index is written */
 
 static Note **notes_index = NULL;
 static size_t notes_count = 0;
 static size_t notes_capacity = 0;
 static const char *NOTES_PATH = "./Notes";
 
+/* Loaded bodies, most recently used at the head. */
+static Note *lru_head = NULL;
+static Note *lru_tail = NULL;
+static size_t cache_bytes = 0;
+
+/*
+ * Search index, kept up to date by a background thread working through
+ * a queue of changed notes. Only that thread changes search_index; it
+ * holds index_lock while doing so, and searches hold it while reading.
+ */
+typedef enum
+{
+	INDEX_JOB_PUT,		/* Index the text given, or the file if it changed */
+	INDEX_JOB_REMOVE,
+	INDEX_JOB_PRUNE,	/* Drop indexed notes whose file is gone */
+} index_job_kind;
+
+typedef struct index_job
+{
+	index_job_kind kind;
+	char *filename;
+	char *title;		/* PUT: both NULL to read the file */
+	char *body;
+	int64_t mtime;
+	uint64_t size;
+	struct index_job *next;
+} index_job;
+
+static notes_index_t search_index;
+static char index_path[1024];
+static pthread_t index_thread;
+static int index_started = 0;
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t index_wake = PTHREAD_COND_INITIALIZER;
+static index_job *job_head = NULL;		/* Under index_lock */
+static index_job *job_tail = NULL;
+static atomic_int index_quit;
+static int index_ready = 0;
+
+/*
+ * Note files are written by a second background thread, so the UI thread
+ * never waits on storage. Saves queued for a note that has not been
+ * written yet are merged into one write. Each write goes to a temporary
+ * file that is synced and renamed over the note, so a crash leaves either
+ * the old text or the new, never a torn file. Finished writes are handed
+ * back through notes_service_poll().
+ */
+typedef enum
+{
+	WRITE_JOB_SAVE,
+	WRITE_JOB_DELETE,
+} write_job_kind;
+
+typedef struct save_done
+{
+	char *filename;
+	unsigned saves;		/* notes_service saves merged into this write */
+	int error;			/* 0 or an errno value */
+	time_t modified;
+	size_t size;
+	struct save_done *next;
+} save_done;
+
+typedef struct write_job
+{
+	write_job_kind kind;
+	char *filename;
+	char *title;
+	char *created_at;
+	char *body;			/* NULL: keep the text already on disk */
+	save_done *done;	/* Outcome, made up front so reporting cannot fail */
+	struct write_job *next;
+} write_job;
+
+static pthread_t writer_thread;
+static int writer_started = 0;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t write_wake = PTHREAD_COND_INITIALIZER;
+static write_job *write_head = NULL;	/* Under write_lock */
+static write_job *write_tail = NULL;
+static save_done *done_head = NULL;		/* Under write_lock, newest first */
+static int writer_quit = 0;
+
 /* Ensure notes_index has room for at least one more entry.
  * Returns 0 on success, -1 on allocation failure. */
 static int ensure_capacity(void)
@@ -34,6 +126,605 @@ static int ensure_capacity(void)
 	return 0;
 }
 
+static void lru_unlink(Note *n)
+{
+	if (n->lru_prev)
+		n->lru_prev->lru_next = n->lru_next;
+	else if (lru_head == n)
+		lru_head = n->lru_next;
+	if (n->lru_next)
+		n->lru_next->lru_prev = n->lru_prev;
+	else if (lru_tail == n)
+		lru_tail = n->lru_prev;
+	n->lru_prev = NULL;
+	n->lru_next = NULL;
+}
+
+static void lru_push_front(Note *n)
+{
+	n->lru_next = lru_head;
+	if (lru_head)
+		lru_head->lru_prev = n;
+	lru_head = n;
+	if (!lru_tail)
+		lru_tail = n;
+}
+
+/* Free a note's cached body. */
+static void drop_content(Note *n)
+{
+	if (!n->content)
+		return;
+	cache_bytes -= n->cached;
+	free(n->content);
+	n->content = NULL;
+	n->cached = 0;
+	lru_unlink(n);
+}
+
+/*
+ * Drop bodies, least recently used first, until at most keep bytes are
+ * cached. keep_note stays even if it alone is over the limit, and so does
+ * any note still being saved or whose last save failed: its file does not
+ * hold that text yet.
+ */
+static void evict_to(size_t keep, const Note *keep_note)
+{
+	Note *victim = lru_tail;
+	while (cache_bytes > keep && victim)
+	{
+		Note *prev = victim->lru_prev;
+		if (victim != keep_note && victim->saving == 0 && victim->save_error == 0)
+			drop_content(victim);
+		victim = prev;
+	}
+}
+
+/* Take ownership of body as n's content, most recently used. */
+static void cache_content(Note *n, char *body)
+{
+	drop_content(n);
+	n->content = body;
+	n->cached = strlen(body) + 1;
+	cache_bytes += n->cached;
+	lru_push_front(n);
+
+	evict_to(NOTES_CACHE_BYTES, n);
+}
+
+/* Offset past the Title and Created lines and the blank line written after them. */
+static size_t body_offset(const char *text, size_t len)
+{
+	size_t pos = 0;
+	for (int line = 0; line < 2 && pos < len; line++)
+	{
+		const char *eol = memchr(text + pos, '\n', len - pos);
+		pos = eol ? (size_t)(eol - text) + 1 : len;
+	}
+	if (pos < len && text[pos] == '\n')
+		pos++;
+	else if (pos + 1 < len && text[pos] == '\r' && text[pos + 1] == '\n')
+		pos += 2;
+	return pos;
+}
+
+/* The whole file at filepath, NUL-terminated, or NULL. */
+static char *read_note_text(const char *filepath, size_t *len, struct stat *st)
+{
+	int fd = open(filepath, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	char *text = NULL;
+	*len = 0;
+	if (fstat(fd, st) == 0 && (text = malloc((size_t)st->st_size + 1)) != NULL)
+	{
+		while (*len < (size_t)st->st_size)
+		{
+			ssize_t got = read(fd, text + *len, (size_t)st->st_size - *len);
+			if (got <= 0)
+				break;
+			*len += (size_t)got;
+		}
+		text[*len] = '\0';
+	}
+	close(fd);
+	return text;
+}
+
+/* Read n's file and return its body, or NULL. */
+static char *load_content(Note *n)
+{
+	char filepath[1024];
+	snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, n->filename);
+	struct stat st;
+	size_t len;
+	char *text = read_note_text(filepath, &len, &st);
+	if (!text)
+		return NULL;
+	n->size = len;
+	n->modified = st.st_mtime;
+
+	size_t skip = body_offset(text, len);
+	memmove(text, text + skip, len - skip);
+	text[len - skip] = '\0';
+	return text;
+}
+
+/* Copy the text of one header line after prefix, or NULL if it is not there. */
+static char *header_field(const char *line, size_t len, const char *prefix)
+{
+	size_t plen = strlen(prefix);
+	if (len < plen || strncmp(line, prefix, plen) != 0)
+		return NULL;
+	size_t n = len - plen;
+	if (n > 0 && line[plen + n - 1] == '\r')
+		n--;
+	if (n >= MAX_LINE_LENGTH)
+		n = MAX_LINE_LENGTH - 1;
+	char *out = malloc(n + 1);
+	if (out)
+	{
+		memcpy(out, line + plen, n);
+		out[n] = '\0';
+	}
+	return out;
+}
+
+static void free_job(index_job *job)
+{
+	free(job->filename);
+	free(job->title);
+	free(job->body);
+	free(job);
+}
+
+/* Queue a change for the index thread, which takes over title and body. */
+static void index_enqueue(index_job_kind kind, const char *filename, char *title, char *body, int64_t mtime,
+						  uint64_t size)
+{
+	index_job *job = index_started ? calloc(1, sizeof(*job)) : NULL;
+	if (!job)
+	{
+		free(title);
+		free(body);
+		return;
+	}
+	job->kind = kind;
+	job->filename = filename ? strdup(filename) : NULL;
+	job->title = title;
+	job->body = body;
+	job->mtime = mtime;
+	job->size = size;
+	if (filename && !job->filename)
+	{
+		free_job(job);
+		return;
+	}
+
+	pthread_mutex_lock(&index_lock);
+	for (index_job *pending = job_head; body && pending; pending = pending->next)
+	{
+		if (pending->kind != INDEX_JOB_PUT || !pending->body || strcmp(pending->filename, filename) != 0)
+			continue;
+		/* A newer text of a note still waiting to be indexed replaces it. */
+		free(pending->title);
+		free(pending->body);
+		pending->title = job->title;
+		pending->body = job->body;
+		pending->mtime = mtime;
+		pending->size = size;
+		job->title = NULL;
+		job->body = NULL;
+		pthread_mutex_unlock(&index_lock);
+		free_job(job);
+		return;
+	}
+	if (job_tail)
+		job_tail->next = job;
+	else
+		job_head = job;
+	job_tail = job;
+	pthread_cond_signal(&index_wake);
+	pthread_mutex_unlock(&index_lock);
+}
+
+static void run_job(index_job *job)
+{
+	if (job->kind == INDEX_JOB_PRUNE)
+	{
+		/* This thread is the only writer, so it reads the index unlocked. */
+		for (size_t i = 0; i < search_index.doc_count && !atomic_load(&index_quit); i++)
+		{
+			if (!search_index.docs[i].live)
+				continue;
+			char filepath[1024];
+			struct stat st;
+			snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, search_index.docs[i].name);
+			if (stat(filepath, &st) == 0)
+				continue;
+			pthread_mutex_lock(&index_lock);
+			notes_index_remove(&search_index, search_index.docs[i].name);
+			pthread_mutex_unlock(&index_lock);
+		}
+		return;
+	}
+	if (job->kind == INDEX_JOB_REMOVE)
+	{
+		pthread_mutex_lock(&index_lock);
+		notes_index_remove(&search_index, job->filename);
+		pthread_mutex_unlock(&index_lock);
+		return;
+	}
+
+	if (!job->body)
+	{
+		/* Startup check; at shutdown it is left for the next run. */
+		char filepath[1024];
+		snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, job->filename);
+		struct stat st;
+		int64_t mtime;
+		uint64_t size;
+		if (atomic_load(&index_quit) || stat(filepath, &st) != 0)
+			return;
+		if (notes_index_stamp(&search_index, job->filename, &mtime, &size) == 0 &&
+			mtime == (int64_t)st.st_mtime && size == (uint64_t)st.st_size)
+			return;
+
+		size_t len;
+		char *text = read_note_text(filepath, &len, &st);
+		if (!text)
+			return;
+		const char *eol = memchr(text, '\n', len);
+		job->title = header_field(text, eol ? (size_t)(eol - text) : len, "Title: ");
+		size_t skip = body_offset(text, len);
+		memmove(text, text + skip, len - skip);
+		text[len - skip] = '\0';
+		job->body = text;
+		job->mtime = st.st_mtime;
+		job->size = (uint64_t)st.st_size;
+	}
+
+	pthread_mutex_lock(&index_lock);
+	notes_index_put(&search_index, job->filename, job->mtime, job->size, job->title, job->body);
+	pthread_mutex_unlock(&index_lock);
+}
+
+/* Write the index out and map the file in place of the in-memory part. */
+static void save_index(void)
+{
+	/* Searches only read, so they may run while the file is written. */
+	int saved = notes_index_save(&search_index, index_path) == 0;
+	pthread_mutex_lock(&index_lock);
+	if (saved)
+		notes_index_reload(&search_index, index_path);
+	else
+		search_index.dirty = 0; /* Tried again after the next change */
+	pthread_mutex_unlock(&index_lock);
+}
+
+static void *index_main(void *arg)
+{
+	(void)arg;
+	notes_index_t opened;
+	notes_index_open(&opened, index_path);
+	pthread_mutex_lock(&index_lock);
+	search_index = opened;
+
+	while (1)
+	{
+		if (job_head)
+		{
+			index_job *job = job_head;
+			job_head = job->next;
+			if (!job_head)
+				job_tail = NULL;
+			pthread_mutex_unlock(&index_lock);
+			run_job(job);
+			free_job(job);
+			pthread_mutex_lock(&index_lock);
+			continue;
+		}
+
+		index_ready = 1;
+		if (atomic_load(&index_quit))
+			break;
+		if (!search_index.dirty)
+		{
+			pthread_cond_wait(&index_wake, &index_lock);
+			continue;
+		}
+
+		/* Save once edits have paused, not after every one. */
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += INDEX_SAVE_DELAY_SEC;
+		if (pthread_cond_timedwait(&index_wake, &index_lock, &until) == ETIMEDOUT && !job_head)
+		{
+			pthread_mutex_unlock(&index_lock);
+			save_index();
+			pthread_mutex_lock(&index_lock);
+		}
+	}
+	pthread_mutex_unlock(&index_lock);
+
+	if (search_index.dirty)
+		save_index();
+	return NULL;
+}
+
+static void free_write_job(write_job *job)
+{
+	if (job->done)
+	{
+		free(job->done->filename);
+		free(job->done);
+	}
+	free(job->filename);
+	free(job->title);
+	free(job->created_at);
+	free(job->body);
+	free(job);
+}
+
+static int write_all(int fd, const char *data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t put = write(fd, data, len);
+		if (put < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += put;
+		len -= (size_t)put;
+	}
+	return 0;
+}
+
+/* Write the note through a synced temporary file renamed over it; the outcome goes in job->done. */
+static void run_write(write_job *job)
+{
+	char filepath[1024];
+	snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, job->filename);
+	if (job->kind == WRITE_JOB_DELETE)
+	{
+		remove(filepath);
+		index_enqueue(INDEX_JOB_REMOVE, job->filename, NULL, NULL, 0, 0);
+		return;
+	}
+
+	save_done *done = job->done;
+	if (!job->body)
+	{
+		/* Only the title changed: carry the text over from the file. */
+		struct stat st;
+		size_t len;
+		char *text = read_note_text(filepath, &len, &st);
+		if (text)
+		{
+			size_t skip = body_offset(text, len);
+			memmove(text, text + skip, len - skip);
+			text[len - skip] = '\0';
+		}
+		job->body = text ? text : strdup("");
+		if (!job->body)
+		{
+			done->error = ENOMEM;
+			return;
+		}
+	}
+
+	char tmppath[1100];
+	snprintf(tmppath, sizeof(tmppath), "%s/.%s.tmp", NOTES_PATH, job->filename);
+	int fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	int ok = fd >= 0 &&
+			 write_all(fd, "Title: ", 7) == 0 &&
+			 write_all(fd, job->title, strlen(job->title)) == 0 &&
+			 write_all(fd, "\nCreated: ", 10) == 0 &&
+			 write_all(fd, job->created_at, strlen(job->created_at)) == 0 &&
+			 write_all(fd, "\n\n", 2) == 0 &&
+			 write_all(fd, job->body, strlen(job->body)) == 0 &&
+			 fsync(fd) == 0;
+	int err = ok ? 0 : errno;
+	if (fd >= 0 && close(fd) != 0 && ok)
+	{
+		ok = 0;
+		err = errno;
+	}
+	if (ok && rename(tmppath, filepath) != 0)
+	{
+		ok = 0;
+		err = errno;
+	}
+	if (!ok)
+	{
+		unlink(tmppath);
+		done->error = err ? err : EIO;
+		return;
+	}
+
+	/* The rename is only durable once the directory is synced too. */
+	int dir = open(NOTES_PATH, O_RDONLY | O_DIRECTORY);
+	if (dir >= 0)
+	{
+		fsync(dir);
+		close(dir);
+	}
+
+	struct stat st;
+	if (stat(filepath, &st) == 0)
+	{
+		done->modified = st.st_mtime;
+		done->size = (size_t)st.st_size;
+	}
+	index_enqueue(INDEX_JOB_PUT, job->filename, job->title, job->body, done->modified, done->size);
+	job->title = NULL;
+	job->body = NULL;
+}
+
+/* Run a job and file its outcome for notes_service_poll(). */
+static void finish_write(write_job *job)
+{
+	run_write(job);
+	save_done *done = job->done;
+	job->done = NULL;
+	free_write_job(job);
+	if (!done)
+		return;
+	pthread_mutex_lock(&write_lock);
+	done->next = done_head;
+	done_head = done;
+	pthread_mutex_unlock(&write_lock);
+}
+
+static void *writer_main(void *arg)
+{
+	(void)arg;
+	pthread_mutex_lock(&write_lock);
+	while (1)
+	{
+		if (!write_head)
+		{
+			/* Everything queued is written before the thread ends. */
+			if (writer_quit)
+				break;
+			pthread_cond_wait(&write_wake, &write_lock);
+			continue;
+		}
+		write_job *job = write_head;
+		write_head = job->next;
+		if (!write_head)
+			write_tail = NULL;
+		pthread_mutex_unlock(&write_lock);
+		finish_write(job);
+		pthread_mutex_lock(&write_lock);
+	}
+	pthread_mutex_unlock(&write_lock);
+	return NULL;
+}
+
+/* Append a job; called with write_lock held. */
+static void write_push(write_job *job)
+{
+	if (write_tail)
+		write_tail->next = job;
+	else
+		write_head = job;
+	write_tail = job;
+	pthread_cond_signal(&write_wake);
+}
+
+/* Queue a save of n as it is now. Returns -1 if it could not be queued. */
+static int write_enqueue(const Note *n)
+{
+	write_job *job = calloc(1, sizeof(*job));
+	save_done *done = calloc(1, sizeof(*done));
+	if (job)
+	{
+		job->done = done;
+		job->filename = strdup(n->filename);
+		job->title = strdup(n->title ? n->title : "Untitled");
+		job->created_at = strdup(n->created_at ? n->created_at : "Unknown");
+		job->body = n->content ? strdup(n->content) : NULL;
+	}
+	if (done)
+	{
+		done->filename = strdup(n->filename);
+		done->saves = 1;
+	}
+	if (!job || !done || !done->filename || !job->filename || !job->title || !job->created_at ||
+		(n->content && !job->body))
+	{
+		if (job)
+			free_write_job(job);
+		else if (done)
+		{
+			free(done->filename);
+			free(done);
+		}
+		return -1;
+	}
+
+	if (!writer_started)
+	{
+		finish_write(job);
+		return 0;
+	}
+
+	pthread_mutex_lock(&write_lock);
+	for (write_job *pending = write_head; pending; pending = pending->next)
+	{
+		if (pending->kind != WRITE_JOB_SAVE || strcmp(pending->filename, n->filename) != 0)
+			continue;
+		/* Not written yet: write this version instead, once. */
+		free(pending->title);
+		pending->title = job->title;
+		free(pending->created_at);
+		pending->created_at = job->created_at;
+		if (job->body)
+		{
+			free(pending->body);
+			pending->body = job->body;
+		}
+		pending->done->saves++;
+		pthread_mutex_unlock(&write_lock);
+		job->title = NULL;
+		job->created_at = NULL;
+		job->body = NULL;
+		free_write_job(job);
+		return 0;
+	}
+	write_push(job);
+	pthread_mutex_unlock(&write_lock);
+	return 0;
+}
+
+/* Queue removal of a note's file, dropping its saves not yet written. */
+static void write_delete(const char *filename)
+{
+	write_job *job = calloc(1, sizeof(*job));
+	if (job)
+	{
+		job->kind = WRITE_JOB_DELETE;
+		job->filename = strdup(filename);
+	}
+
+	pthread_mutex_lock(&write_lock);
+	write_job **link = &write_head;
+	write_tail = NULL;
+	while (*link)
+	{
+		write_job *pending = *link;
+		if (pending->kind == WRITE_JOB_SAVE && strcmp(pending->filename, filename) == 0)
+		{
+			*link = pending->next;
+			free_write_job(pending);
+			continue;
+		}
+		write_tail = pending;
+		link = &pending->next;
+	}
+	if (job && job->filename && writer_started)
+	{
+		write_push(job);
+		job = NULL;
+	}
+	pthread_mutex_unlock(&write_lock);
+
+	if (job)
+	{
+		/* No writer or no memory: delete it here. */
+		char filepath[1024];
+		snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, filename);
+		remove(filepath);
+		index_enqueue(INDEX_JOB_REMOVE, filename, NULL, NULL, 0, 0);
+		free_write_job(job);
+	}
+}
+
 /* Insert a note at index 0 (newest-first) */
 static void insert_at_front(Note *note)
 {
@@ -89,79 +780,48 @@ void notes_service_init(void)
 		char filepath[1024];
 		snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, entry->d_name);
 
-		// Open file
-		FILE *f = fopen(filepath, "r");
-		if (!f)
+		// Read only the header; the body is loaded when the note is opened
+		int fd = open(filepath, O_RDONLY);
+		if (fd < 0)
 		{
 			perror("Failed to open note file");
 			continue;
 		}
+		char header[NOTE_HEADER_BYTES];
+		ssize_t got = read(fd, header, sizeof(header));
+		struct stat file_st;
+		int stat_ok = fstat(fd, &file_st) == 0;
+		close(fd);
 
-		Note *new_note = malloc(sizeof(Note));
+		Note *new_note = calloc(1, sizeof(Note));
 		if (!new_note)
-		{
-			fclose(f);
 			continue;
-		}
 
 		new_note->filename = strdup(entry->d_name);
-		new_note->title = strdup("Untitled");
-		new_note->created_at = strdup("Unknown");
-		new_note->content = strdup("");
-
-		char line[MAX_LINE_LENGTH];
-
-		// Read title line
-		if (fgets(line, sizeof(line), f))
-		{
-			line[strcspn(line, "\r\n")] = '\0';
-			if (strncmp(line, "Title: ", 7) == 0)
-			{
-				free(new_note->title);
-				new_note->title = strdup(line + 7);
-			}
-		}
+		new_note->size = stat_ok ? (size_t)file_st.st_size : 0;
+		new_note->modified = stat_ok ? file_st.st_mtime : 0;
 
-		// Read created_at line
-		if (fgets(line, sizeof(line), f))
+		size_t len = got > 0 ? (size_t)got : 0;
+		const char *eol = memchr(header, '\n', len);
+		size_t first = eol ? (size_t)(eol - header) : len;
+		new_note->title = header_field(header, first, "Title: ");
+		if (eol)
 		{
-			line[strcspn(line, "\r\n")] = '\0';
-			if (strncmp(line, "Created: ", 9) == 0)
-			{
-				free(new_note->created_at);
-				new_note->created_at = strdup(line + 9);
-			}
+			const char *second = eol + 1;
+			const char *eol2 = memchr(second, '\n', len - first - 1);
+			size_t second_len = eol2 ? (size_t)(eol2 - second) : len - first - 1;
+			new_note->created_at = header_field(second, second_len, "Created: ");
 		}
-
-		// Read remaining content
-		long current_pos = ftell(f);
-		fseek(f, 0, SEEK_END);
-		long total_size = ftell(f);
-		long content_len = total_size - current_pos;
-		if (content_len < 0)
-			content_len = 0;
-		fseek(f, current_pos, SEEK_SET);
-
-		free(new_note->content);
-		new_note->content = malloc(content_len + 1);
-		if (new_note->content)
-		{
-			size_t read_bytes = fread(new_note->content, 1, content_len, f);
-			new_note->content[read_bytes] = '\0';
-		}
-		else
-		{
-			new_note->content = strdup("");
-		}
-
-		fclose(f);
+		if (!new_note->title)
+			new_note->title = strdup("Untitled");
+		if (!new_note->created_at)
+			new_note->created_at = strdup("Unknown");
 
 		if (ensure_capacity() != 0)
 		{
 			free(new_note->filename);
 			free(new_note->title);
 			free(new_note->created_at);
-			free(new_note->content);
 			free(new_note);
 			continue;
 		}
@@ -169,11 +829,36 @@ void notes_service_init(void)
 	}
 
 	closedir(dir);
+
+	writer_quit = 0;
+	writer_started = pthread_create(&writer_thread, NULL, writer_main, NULL) == 0;
+
+	/* Build or catch up the search index in the background. */
+	snprintf(index_path, sizeof(index_path), "%s/.index", NOTES_PATH);
+	atomic_store(&index_quit, 0);
+	index_ready = 0;
+	index_started = 1;
+	for (size_t i = notes_count; i > 0; i--)
+		index_enqueue(INDEX_JOB_PUT, notes_index[i - 1]->filename, NULL, NULL, 0, 0);
+	index_enqueue(INDEX_JOB_PRUNE, NULL, NULL, NULL, 0, 0);
+	if (pthread_create(&index_thread, NULL, index_main, NULL) != 0)
+	{
+		index_started = 0;
+		pthread_mutex_lock(&index_lock);
+		while (job_head)
+		{
+			index_job *job = job_head;
+			job_head = job->next;
+			free_job(job);
+		}
+		job_tail = NULL;
+		pthread_mutex_unlock(&index_lock);
+	}
 }
 
 Note *notes_service_create(const char *title, const char *content)
 {
-	Note *new_note = malloc(sizeof(Note));
+	Note *new_note = calloc(1, sizeof(Note));
 	if (!new_note)
 	{
 		fprintf(stderr, "Failed to create a new notes\n");
@@ -198,34 +883,27 @@ Note *notes_service_create(const char *title, const char *content)
 	new_note->filename = strdup(filename);
 	new_note->created_at = strdup(created);
 	new_note->title = strdup(title ? title : "Untitled");
-	new_note->content = strdup(content ? content : "");
+	char *body = strdup(content ? content : "");
 
-	if (ensure_capacity() != 0)
+	if (ensure_capacity() != 0 || !body)
 	{
 		free(new_note->filename);
 		free(new_note->title);
 		free(new_note->created_at);
-		free(new_note->content);
+		free(body);
 		free(new_note);
 		return NULL;
 	}
 	insert_at_front(new_note);
+	cache_content(new_note, body);
 
-	char filepath[1024];
-	snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, new_note->filename);
-
-	FILE *f = fopen(filepath, "w");
-	if (!f)
+	/* Written in the background; the note stays in memory meanwhile. */
+	new_note->saving = 1;
+	if (write_enqueue(new_note) != 0)
 	{
-		fprintf(stderr, "Failed to open file for writing: %s\n", filepath);
-		return new_note; // note still in memory
+		new_note->saving = 0;
+		new_note->save_error = ENOMEM;
 	}
-
-	fprintf(f, "Title: %s\n", new_note->title);
-	fprintf(f, "Created: %s\n\n", new_note->created_at);
-	fprintf(f, "%s", new_note->content);
-	fclose(f);
-
 	return new_note;
 }
 
@@ -252,16 +930,14 @@ int notes_service_delete_note(const Note *n)
 		Note *note = notes_index[i];
 		if (strcmp(note->filename, n->filename) == 0)
 		{
-			// Delete file from disk
-			char filepath[1024];
-			snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, note->filename);
-			remove(filepath);
+			// Delete file from disk, after any write already under way
+			write_delete(note->filename);
 
 			// Free all fields
+			drop_content(note);
 			free(note->filename);
 			free(note->title);
 			free(note->created_at);
-			free(note->content);
 			free(note);
 
 			// Shift remaining notes down
@@ -287,14 +963,24 @@ int notes_service_update_note(Note *n)
 			/* Guard against use-after-free when n == note */
 			if (n != note)
 			{
+				/* Copy before freeing: n may share these strings with note. */
+				char *title = strdup(n->title ? n->title : "Untitled");
 				free(note->title);
-				note->title = strdup(n->title ? n->title : "Untitled");
+				note->title = title;
 
+				char *created = strdup(n->created_at ? n->created_at : "Unknown");
 				free(note->created_at);
-				note->created_at = strdup(n->created_at ? n->created_at : "Unknown");
+				note->created_at = created;
 
-				free(note->content);
-				note->content = strdup(n->content ? n->content : "");
+				char *body = strdup(n->content ? n->content : "");
+				if (body)
+					cache_content(note, body);
+			}
+			else if (note->content)
+			{
+				/* Edited in place: recount it */
+				cache_bytes += strlen(note->content) + 1 - note->cached;
+				note->cached = strlen(note->content) + 1;
 			}
 
 			if (i != 0)
@@ -305,23 +991,111 @@ int notes_service_update_note(Note *n)
 				notes_index[0] = tmp;
 			}
 
-			/* Write updated note to disk */
-			char filepath[1024];
-			snprintf(filepath, sizeof(filepath), "%s/%s", NOTES_PATH, note->filename);
-			FILE *f = fopen(filepath, "w");
-			if (f)
+			/*
+			 * Write updated note to disk in the background. A body that is
+			 * not cached has not changed, so the writer keeps the file's.
+			 */
+			note->saving++;
+			if (write_enqueue(note) != 0)
 			{
-				fprintf(f, "Title: %s\n", note->title);
-				fprintf(f, "Created: %s\n\n", note->created_at);
-				fprintf(f, "%s", note->content);
-				fclose(f);
+				note->saving--;
+				note->save_error = ENOMEM;
+				return 1;
 			}
-
 			return 0;
 		}
 	}
 	return 1;
 }
+const char *notes_service_content(Note *n)
+{
+	if (!n)
+		return "";
+	if (n->content)
+	{
+		lru_unlink(n);
+		lru_push_front(n);
+		return n->content;
+	}
+	char *body = load_content(n);
+	if (!body)
+		return "";
+	cache_content(n, body);
+	return n->content;
+}
+
+void notes_service_trim_cache(size_t keep_bytes)
+{
+	evict_to(keep_bytes, NULL);
+}
+
+size_t notes_service_poll(void)
+{
+	pthread_mutex_lock(&write_lock);
+	save_done *newest = done_head;
+	done_head = NULL;
+	pthread_mutex_unlock(&write_lock);
+
+	/* Oldest first, so a note ends up with its latest outcome. */
+	save_done *done = NULL;
+	while (newest)
+	{
+		save_done *next = newest->next;
+		newest->next = done;
+		done = newest;
+		newest = next;
+	}
+
+	size_t finished = 0;
+	while (done)
+	{
+		save_done *next = done->next;
+		Note *n = (Note *)notes_service_get_note_by_filename(done->filename);
+		if (n)
+		{
+			n->saving = n->saving > done->saves ? n->saving - done->saves : 0;
+			n->save_error = done->error;
+			if (!done->error)
+			{
+				n->modified = done->modified;
+				n->size = done->size;
+			}
+		}
+		finished++;
+		free(done->filename);
+		free(done);
+		done = next;
+	}
+	return finished;
+}
+
+size_t notes_service_search(const char *query, Note **out, size_t max, int *ready)
+{
+	if (ready)
+		*ready = 1;
+	if (!index_started || !query || max == 0)
+		return 0;
+	notes_index_hit_t *hits = malloc(max * sizeof(*hits));
+	if (!hits)
+		return 0;
+
+	size_t found = 0;
+	pthread_mutex_lock(&index_lock);
+	if (ready)
+		*ready = index_ready;
+	size_t matches = notes_index_search(&search_index, query, hits, max);
+	for (size_t h = 0; h < matches && h < max; h++)
+	{
+		/* A note deleted but not yet dropped from the index is skipped. */
+		Note *n = (Note *)notes_service_get_note_by_filename(hits[h].name);
+		if (n)
+			out[found++] = n;
+	}
+	pthread_mutex_unlock(&index_lock);
+	free(hits);
+	return found;
+}
+
 size_t notes_service_note_count(void)
 {
 	return notes_count;
@@ -334,6 +1108,30 @@ Note **notes_service_list_all(size_t *out_count)
 }
 void notes_service_shutdown(void)
 {
+	if (writer_started)
+	{
+		/* Every queued save reaches the disk before the notes go. */
+		pthread_mutex_lock(&write_lock);
+		writer_quit = 1;
+		pthread_cond_signal(&write_wake);
+		pthread_mutex_unlock(&write_lock);
+		pthread_join(writer_thread, NULL);
+		writer_started = 0;
+	}
+	notes_service_poll();
+
+	if (index_started)
+	{
+		/* Queued changes are indexed and the index saved before the thread ends. */
+		pthread_mutex_lock(&index_lock);
+		atomic_store(&index_quit, 1);
+		pthread_cond_signal(&index_wake);
+		pthread_mutex_unlock(&index_lock);
+		pthread_join(index_thread, NULL);
+		notes_index_close(&search_index);
+		index_started = 0;
+	}
+
 	if (!notes_index)
 		return;
 
@@ -343,9 +1141,9 @@ void notes_service_shutdown(void)
 		if (!n)
 			continue;
 
+		drop_content(n);
 		free(n->filename);
 		free(n->title);
-		free(n->content);
 		free(n->created_at);
 		free(n);
 	}
@@ -1,6 +1,7 @@
 #ifndef NOTES_SERVICE_H
 #define NOTES_SERVICE_H
 #include <stddef.h>
+#include <time.h>
 /*
  * notes_service.h
  *
@@ -11,22 +12,66 @@
  */
 
 
- typedef struct {
+ typedef struct Note {
     char *filename;
     char *title;
-    char *content;
+    char *content;		/* NULL until loaded; read it through notes_service_content() */
     char* created_at;
+    size_t size;		/* File size and mtime as of the last read or write */
+    time_t modified;
 
+    /* Content cache, most recently used first */
+    size_t cached;		/* Bytes of content counted against the cache */
+    struct Note *lru_prev;
+    struct Note *lru_next;
+
+    unsigned saving;	/* Saves not yet on disk; the content stays cached until then */
+    int save_error;		/* errno of the last finished save, 0 if it was written; the content stays cached while set */
  } Note;
  
 
+/* Reads only each note's title and date; content is loaded on first use. */
 void notes_service_init(void);
+
+/*
+ * Create, update and delete return without touching the disk: a
+ * background writer saves each note to a temporary file, syncs it and
+ * renames it into place. Saves of a note still waiting are merged.
+ */
 Note* notes_service_create(const char* title, const char* content);
 const Note* notes_service_get_note_by_filename(const char* filename);
 int notes_service_delete_note(const Note* n);
 int notes_service_update_note(Note* n);
 size_t notes_service_note_count(void);
 Note** notes_service_list_all(size_t* out_count);
+
+/*
+ * The note's body, loaded from disk if it is not cached ("" if it cannot
+ * be read). Valid until the next notes_service call. Loaded bodies are
+ * kept in an LRU cache bounded in bytes.
+ */
+const char* notes_service_content(Note* n);
+
+/*
+ * Notes holding every word of query, best first, up to max. The last
+ * word also matches as a prefix while it is still being typed. The index
+ * is built and kept current in the background; *ready is 0 until it has
+ * caught up with the notes on disk.
+ */
+size_t notes_service_search(const char* query, Note** out, size_t max, int* ready);
+
+/*
+ * Apply finished saves to their notes (saving, save_error, size,
+ * modified). Call once per frame; returns how many finished.
+ */
+size_t notes_service_poll(void);
+
+/*
+ * Drop cached bodies, least recently used first, down to keep_bytes. The
+ * cache bounds itself; this is for a low-memory signal.
+ */
+void notes_service_trim_cache(size_t keep_bytes);
+
 void notes_service_shutdown(void);
 
 #endif
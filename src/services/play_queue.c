@@ -0,0 +1,240 @@
+#include "play_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PLAY_QUEUE_MAGIC "BHPQ"
+#define PLAY_QUEUE_VERSION 1u
+#define PLAY_QUEUE_MAX_LEN (1u << 24)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t len;
+    uint32_t pos;
+    uint8_t shuffle;
+    uint8_t repeat;
+    uint16_t reserved;
+} play_queue_header_t;
+
+/* List entry i and play order entry i. */
+typedef struct {
+    uint64_t id;
+    uint32_t hint;  /* Library index when saved */
+    uint32_t order; /* List position played i-th */
+} play_queue_record_t;
+
+/* xorshift64*: plenty for shuffling, and seedable without libc state. */
+static uint32_t next_random(play_queue_t *q) {
+    q->rng ^= q->rng >> 12;
+    q->rng ^= q->rng << 25;
+    q->rng ^= q->rng >> 27;
+    return (uint32_t)((q->rng * 2685821657736338717ULL) >> 32);
+}
+
+static uint32_t random_below(play_queue_t *q, uint32_t n) {
+    return (uint32_t)(((uint64_t)next_random(q) * n) >> 32);
+}
+
+/* Identity order, or the current track first and the rest shuffled. */
+static void build_order(play_queue_t *q, size_t first) {
+    for (size_t i = 0; i < q->len; i++) q->order[i] = (uint32_t)i;
+    q->pos = first;
+    if (!q->shuffle || q->len == 0) return;
+
+    q->order[0] = (uint32_t)first;
+    q->order[first] = 0;
+    for (size_t i = q->len - 1; i > 1; i--) {
+        size_t j = 1 + random_below(q, (uint32_t)i);
+        uint32_t t = q->order[i];
+        q->order[i] = q->order[j];
+        q->order[j] = t;
+    }
+    q->pos = 0;
+}
+
+static int resize(play_queue_t *q, size_t len) {
+    uint32_t *list = realloc(q->list, (len ? len : 1) * sizeof(*list));
+    if (!list) return -1;
+    q->list = list;
+    uint32_t *order = realloc(q->order, (len ? len : 1) * sizeof(*order));
+    if (!order) return -1;
+    q->order = order;
+    return 0;
+}
+
+void play_queue_init(play_queue_t *q) {
+    memset(q, 0, sizeof(*q));
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    q->rng = ((uint64_t)ts.tv_sec << 32 ^ (uint64_t)ts.tv_nsec) | 1;
+}
+
+void play_queue_free(play_queue_t *q) {
+    free(q->list);
+    free(q->order);
+    q->list = NULL;
+    q->order = NULL;
+    q->len = 0;
+    q->pos = 0;
+}
+
+int play_queue_copy(play_queue_t *dst, const play_queue_t *src) {
+    if (resize(dst, src->len) != 0) return -1;
+    memcpy(dst->list, src->list, src->len * sizeof(*src->list));
+    memcpy(dst->order, src->order, src->len * sizeof(*src->order));
+    dst->len = src->len;
+    dst->pos = src->pos;
+    dst->shuffle = src->shuffle;
+    dst->repeat = src->repeat;
+    return 0;
+}
+
+int play_queue_assign(play_queue_t *q, const uint32_t *list, size_t len, size_t start) {
+    if (len == 0 || start >= len || len > PLAY_QUEUE_MAX_LEN) return -1;
+    if (resize(q, len) != 0) return -1;
+    memcpy(q->list, list, len * sizeof(*list));
+    q->len = len;
+    build_order(q, start);
+    return 0;
+}
+
+int play_queue_at(const play_queue_t *q, size_t pos) {
+    if (pos >= q->len) return -1;
+    return (int)q->list[q->order[pos]];
+}
+
+int play_queue_next(const play_queue_t *q, size_t pos, size_t *out) {
+    if (pos >= q->len) return -1;
+    if (q->repeat == PLAY_REPEAT_ONE) {
+        *out = pos;
+        return 0;
+    }
+    return play_queue_skip(q, pos, 1, out);
+}
+
+int play_queue_skip(const play_queue_t *q, size_t pos, int dir, size_t *out) {
+    if (pos >= q->len) return -1;
+    if (dir >= 0 && pos + 1 < q->len) {
+        *out = pos + 1;
+    } else if (dir < 0 && pos > 0) {
+        *out = pos - 1;
+    } else if (q->repeat == PLAY_REPEAT_ALL) {
+        *out = dir >= 0 ? 0 : q->len - 1;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+size_t play_queue_set_shuffle(play_queue_t *q, int on) {
+    size_t current = q->pos < q->len ? q->order[q->pos] : 0;
+    q->shuffle = on ? 1 : 0;
+    build_order(q, current);
+    return q->pos;
+}
+
+int play_queue_find(const play_queue_t *q, uint32_t index) {
+    for (size_t i = 0; i < q->len; i++) {
+        if (q->list[q->order[i]] == index) return (int)i;
+    }
+    return -1;
+}
+
+int play_queue_save(const play_queue_t *q, const char *path, play_queue_id_fn id_of, void *ctx) {
+    play_queue_record_t *records = malloc((q->len ? q->len : 1) * sizeof(*records));
+    if (!records) return -1;
+    for (size_t i = 0; i < q->len; i++) {
+        records[i].id = id_of(q->list[i], ctx);
+        records[i].hint = q->list[i];
+        records[i].order = q->order[i];
+    }
+
+    play_queue_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PLAY_QUEUE_MAGIC, 4);
+    hdr.version = PLAY_QUEUE_VERSION;
+    hdr.len = (uint32_t)q->len;
+    hdr.pos = (uint32_t)q->pos;
+    hdr.shuffle = (uint8_t)q->shuffle;
+    hdr.repeat = (uint8_t)q->repeat;
+
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        free(records);
+        return -1;
+    }
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+             fwrite(records, sizeof(*records), q->len, f) == q->len;
+    if (fclose(f) != 0) ok = 0;
+    free(records);
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int play_queue_load(play_queue_t *q, const char *path, play_queue_find_fn find, void *ctx) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    play_queue_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, PLAY_QUEUE_MAGIC, 4) != 0 ||
+        hdr.version != PLAY_QUEUE_VERSION || hdr.len == 0 || hdr.len > PLAY_QUEUE_MAX_LEN ||
+        hdr.pos >= hdr.len || hdr.repeat >= PLAY_REPEAT_COUNT) {
+        fclose(f);
+        return -1;
+    }
+
+    /* One block: the records, then old list position -> new, or -1. */
+    size_t len = hdr.len;
+    void *block = malloc(len * (sizeof(play_queue_record_t) + sizeof(int32_t)));
+    if (!block || fread(block, sizeof(play_queue_record_t), len, f) != len || resize(q, len) != 0) {
+        free(block);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    play_queue_record_t *records = block;
+    int32_t *remap = (int32_t *)(records + len);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < len; i++) {
+        int index = find(records[i].id, records[i].hint, ctx);
+        remap[i] = index >= 0 ? (int32_t)kept : -1;
+        if (index >= 0) q->list[kept++] = (uint32_t)index;
+    }
+
+    /* Rebuild the play order over the survivors; a damaged order is rejected. */
+    size_t played = 0;
+    size_t pos = 0;
+    int ok = 1;
+    for (size_t i = 0; i < len && ok; i++) {
+        uint32_t at = records[i].order;
+        if (at >= len) {
+            ok = 0;
+        } else if (remap[at] >= 0) {
+            if (i == hdr.pos) pos = played;
+            q->order[played++] = (uint32_t)remap[at];
+            remap[at] = -1; /* Each list position plays once */
+        } else if (i == hdr.pos) {
+            pos = played; /* Current track is gone: resume at the one after it */
+        }
+    }
+    free(block);
+    if (!ok || played != kept || kept == 0) {
+        q->len = 0;
+        return -1;
+    }
+
+    q->len = kept;
+    q->pos = pos < kept ? pos : kept - 1;
+    q->shuffle = hdr.shuffle ? 1 : 0;
+    q->repeat = (play_repeat)hdr.repeat;
+    return 0;
+}
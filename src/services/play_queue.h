@@ -0,0 +1,79 @@
+#ifndef PLAY_QUEUE_H
+#define PLAY_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * play_queue.h
+ *
+ * Play order for the music player: a list of library tracks, the order
+ * they play in, and where playback is. Owned by mp3_service, which does
+ * the locking.
+ *
+ * Shuffle is a Fisher-Yates permutation of list positions with the
+ * current track moved first, so nothing repeats until every track has
+ * played; repeat-all then plays the same permutation again. Turning
+ * shuffle off goes back to list order at the current track.
+ *
+ * The queue is saved by stable track id rather than library index, so a
+ * rescan that adds, removes or reorders files keeps it valid: tracks that
+ * are gone are dropped on load. Each id is stored with the index it had
+ * when saved, which is right unless the library changed, so a restore is
+ * one sequential read and mostly O(1) lookups.
+ */
+
+typedef enum
+{
+	PLAY_REPEAT_OFF = 0,
+	PLAY_REPEAT_ALL,
+	PLAY_REPEAT_ONE,
+	PLAY_REPEAT_COUNT
+} play_repeat;
+
+typedef struct
+{
+	uint32_t *list;	 /* Library indices in list order */
+	uint32_t *order; /* Play order, as positions in list */
+	size_t len;
+	size_t pos; /* Position in order of the current track */
+	int shuffle;
+	play_repeat repeat;
+	uint64_t rng;
+} play_queue_t;
+
+/* Stable id of a library index, and the reverse (-1 if gone). */
+typedef uint64_t (*play_queue_id_fn)(uint32_t index, void *ctx);
+typedef int (*play_queue_find_fn)(uint64_t id, uint32_t hint, void *ctx);
+
+void play_queue_init(play_queue_t *q);
+void play_queue_free(play_queue_t *q);
+
+/* dst gets its own copy of src, e.g. to save it outside a lock. */
+int play_queue_copy(play_queue_t *dst, const play_queue_t *src);
+
+/* Replace the queue with list, starting at list[start]. Keeps the modes. */
+int play_queue_assign(play_queue_t *q, const uint32_t *list, size_t len, size_t start);
+
+/* Library index at a play position, or -1. */
+int play_queue_at(const play_queue_t *q, size_t pos);
+
+/*
+ * Position after pos when a track ends (repeat-one stays put), or when
+ * the user skips (dir 1 or -1; repeat-one is ignored). -1 past either end
+ * unless repeating all.
+ */
+int play_queue_next(const play_queue_t *q, size_t pos, size_t *out);
+int play_queue_skip(const play_queue_t *q, size_t pos, int dir, size_t *out);
+
+/* Reorders around the current track; returns its new position. */
+size_t play_queue_set_shuffle(play_queue_t *q, int on);
+
+/* Position of a library index in play order, or -1. */
+int play_queue_find(const play_queue_t *q, uint32_t index);
+
+/* Written to a temporary file and renamed over path. */
+int play_queue_save(const play_queue_t *q, const char *path, play_queue_id_fn id_of, void *ctx);
+int play_queue_load(play_queue_t *q, const char *path, play_queue_find_fn find, void *ctx);
+
+#endif
@@ -13,9 +13,34 @@ static setting_item_t g_items[] = {
     { "night_mode", "Night Mode", false },
     { "bluetooth",  "Bluetooth",  false },
     { "wifi",       "WiFi",       true  },
+    { "replay_gain", "ReplayGain", true },
+};
+
+typedef struct {
+    const char *key;
+    int value;
+    int min;
+    int max;
+} setting_value_t;
+
+static setting_value_t g_values[] = {
+    { "volume", 80, 0, 100 },
+    { "eq_preset", 0, 0, 5 },
+    { "library_sort", 0, 0, 3 },
+    { "eq_31", 0, -12, 12 },
+    { "eq_62", 0, -12, 12 },
+    { "eq_125", 0, -12, 12 },
+    { "eq_250", 0, -12, 12 },
+    { "eq_500", 0, -12, 12 },
+    { "eq_1k", 0, -12, 12 },
+    { "eq_2k", 0, -12, 12 },
+    { "eq_4k", 0, -12, 12 },
+    { "eq_8k", 0, -12, 12 },
+    { "eq_16k", 0, -12, 12 },
 };
 
 static const int g_item_count = (int)(sizeof(g_items) / sizeof(g_items[0]));
+static const int g_value_count = (int)(sizeof(g_values) / sizeof(g_values[0]));
 static const char *SETTINGS_FILE = "settings.conf";
 
 static int find_index_by_key(const char *key) {
@@ -25,6 +50,19 @@ static int find_index_by_key(const char *key) {
     return -1;
 }
 
+static int find_value_by_key(const char *key) {
+    for (int i = 0; i < g_value_count; i++) {
+        if (strcmp(g_values[i].key, key) == 0) return i;
+    }
+    return -1;
+}
+
+static int clamp_value(const setting_value_t *v, int value) {
+    if (value < v->min) return v->min;
+    if (value > v->max) return v->max;
+    return value;
+}
+
 static void settings_service_load(void) {
     FILE *f = fopen(SETTINGS_FILE, "r");
     if (!f) return;
@@ -32,11 +70,14 @@ static void settings_service_load(void) {
     char line[128];
     while (fgets(line, sizeof(line), f)) {
         char key[64];
-        int enabled;
-        if (sscanf(line, "%63[^=]=%d", key, &enabled) != 2) continue;
+        int value;
+        if (sscanf(line, "%63[^=]=%d", key, &value) != 2) continue;
 
         int index = find_index_by_key(key);
-        if (index >= 0) g_items[index].enabled = (enabled != 0);
+        if (index >= 0) g_items[index].enabled = (value != 0);
+
+        int value_index = find_value_by_key(key);
+        if (value_index >= 0) g_values[value_index].value = clamp_value(&g_values[value_index], value);
     }
 
     fclose(f);
@@ -49,6 +90,9 @@ static void settings_service_save(void) {
     for (int i = 0; i < g_item_count; i++) {
         fprintf(f, "%s=%d\n", g_items[i].key, g_items[i].enabled ? 1 : 0);
     }
+    for (int i = 0; i < g_value_count; i++) {
+        fprintf(f, "%s=%d\n", g_values[i].key, g_values[i].value);
+    }
 
     fclose(f);
 }
@@ -92,3 +136,18 @@ bool settings_service_get_bool(const char *key){
     if (index < 0) return false;
     return g_items[index].enabled;
 }
+
+int settings_service_get_int(const char *key) {
+    int index = find_value_by_key(key);
+    if (index < 0) return 0;
+    return g_values[index].value;
+}
+
+void settings_service_set_int(const char *key, int value) {
+    int index = find_value_by_key(key);
+    if (index < 0) return;
+    value = clamp_value(&g_values[index], value);
+    if (value == g_values[index].value) return;
+    g_values[index].value = value;
+    settings_service_save();
+}
@@ -14,4 +14,8 @@ void settings_service_toggle(int index);
 bool settings_service_get_bool(const char *key);
 void settings_service_toggle_by_key(const char *key);
 
+/* Numeric settings: not shown as toggles, values are clamped to their range. */
+int settings_service_get_int(const char *key);
+void settings_service_set_int(const char *key, int value);
+
 #endif
@@ -0,0 +1,311 @@
+#include "sound_service.h"
+#include "mixer_service.h"
+#include "audio/audio_resample.h"
+#include "audio/audio_wav.h"
+
+#include <mpg123.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SOUND_DIR "./Sounds"
+#define SOUND_CACHE_BYTES (8u * 1024u * 1024u) /* ~47 s of mixer-format PCM */
+#define SOUND_MAX_SEC 30					   /* Longer files are cut here */
+#define SOUND_READ_FRAMES 4096
+#define SOUND_RELEASE_WAIT_US 5000
+
+typedef enum {
+    SOUND_UNLOADED = 0,
+    SOUND_LOADED,
+    SOUND_MISSING /* No file, or it failed to decode */
+} sound_state;
+
+typedef struct {
+    const char *name;
+    audio_source_id source;
+    int loop;
+    sound_state state;
+    audio_clip_t clip;
+    unsigned long last_used;
+    int load_requested;
+    int play_when_loaded;
+} sound_entry_t;
+
+static sound_entry_t g_sounds[SOUND_COUNT] = {
+    [SOUND_RINGTONE] = { "ringtone", AUDIO_SOURCE_RINGTONE, 1 },
+    [SOUND_NOTIFICATION] = { "notification", AUDIO_SOURCE_UI, 0 },
+    [SOUND_MESSAGE] = { "message", AUDIO_SOURCE_UI, 0 },
+    [SOUND_CLICK] = { "click", AUDIO_SOURCE_UI, 0 },
+};
+
+static pthread_mutex_t sound_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sound_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t loader_thread;
+static int loader_started = 0;
+static int loader_quit = 0;
+static size_t cache_bytes = 0;
+static unsigned long use_clock = 0;
+
+/* Growable PCM buffer in the mixer format, capped at SOUND_MAX_SEC. */
+typedef struct {
+    int16_t *pcm;
+    size_t frames;
+    size_t cap;
+} pcm_buffer_t;
+
+static int append_converted(pcm_buffer_t *b, audio_resampler_t *rs, const int16_t *in, size_t frames, int flush) {
+    const size_t max_frames = (size_t)SOUND_MAX_SEC * AUDIO_MIXER_RATE;
+    size_t need = b->frames + audio_resampler_max_out(rs, frames);
+    if (need > b->cap) {
+        size_t cap = b->cap ? b->cap : AUDIO_MIXER_RATE;
+        while (cap < need) cap *= 2;
+        int16_t *grown = realloc(b->pcm, cap * AUDIO_MIXER_FRAME_BYTES);
+        if (!grown) return -1;
+        b->pcm = grown;
+        b->cap = cap;
+    }
+
+    int16_t *out = b->pcm + b->frames * AUDIO_MIXER_CHANNELS;
+    b->frames += flush ? audio_resampler_flush(rs, out) : audio_resampler_process(rs, in, frames, out);
+    if (b->frames >= max_frames) {
+        b->frames = max_frames;
+        return 1;
+    }
+    return 0;
+}
+
+static int decode_wav(const char *path, pcm_buffer_t *b) {
+    audio_wav_t wav;
+    if (audio_wav_open(&wav, path) != 0) return -1;
+
+    audio_resampler_t rs;
+    if (audio_resampler_init(&rs, wav.rate, wav.channels, AUDIO_MIXER_RATE, AUDIO_MIXER_CHANNELS) != 0) {
+        audio_wav_close(&wav);
+        return -1;
+    }
+
+    int16_t in[SOUND_READ_FRAMES * 2];
+    int result = 0;
+    size_t frames;
+    while (result == 0 && (frames = audio_wav_read(&wav, in, SOUND_READ_FRAMES)) > 0) {
+        result = append_converted(b, &rs, in, frames, 0);
+    }
+    if (result == 0) result = append_converted(b, &rs, NULL, 0, 1);
+
+    audio_resampler_free(&rs);
+    audio_wav_close(&wav);
+    return result < 0 ? -1 : 0;
+}
+
+static int decode_mp3(const char *path, pcm_buffer_t *b) {
+    int err = 0;
+    mpg123_handle *mh = mpg123_new(NULL, &err);
+    if (!mh) return -1;
+
+    const long *rates = NULL;
+    size_t rate_count = 0;
+    mpg123_rates(&rates, &rate_count);
+    mpg123_format_none(mh);
+    for (size_t i = 0; i < rate_count; i++) {
+        mpg123_format(mh, rates[i], MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
+    }
+
+    long rate;
+    int channels, encoding;
+    audio_resampler_t rs;
+    if (mpg123_open(mh, path) != MPG123_OK || mpg123_getformat(mh, &rate, &channels, &encoding) != MPG123_OK ||
+        audio_resampler_init(&rs, rate, channels, AUDIO_MIXER_RATE, AUDIO_MIXER_CHANNELS) != 0) {
+        mpg123_delete(mh);
+        return -1;
+    }
+
+    int16_t in[SOUND_READ_FRAMES * 2];
+    int result = 0;
+    while (result == 0) {
+        size_t done = 0;
+        int r = mpg123_read(mh, (unsigned char *)in, (size_t)channels * sizeof(int16_t) * SOUND_READ_FRAMES, &done);
+        if (r == MPG123_NEW_FORMAT) continue;
+        if (r != MPG123_OK && r != MPG123_DONE) {
+            result = -1;
+            break;
+        }
+        result = append_converted(b, &rs, in, done / ((size_t)channels * sizeof(int16_t)), 0);
+        if (r == MPG123_DONE) break;
+    }
+    if (result == 0) result = append_converted(b, &rs, NULL, 0, 1);
+
+    audio_resampler_free(&rs);
+    mpg123_close(mh);
+    mpg123_delete(mh);
+    return result < 0 ? -1 : 0;
+}
+
+static int decode_sound(const sound_entry_t *s, pcm_buffer_t *b) {
+    char path[256];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s.wav", SOUND_DIR, s->name);
+    if (stat(path, &st) == 0) return decode_wav(path, b);
+    snprintf(path, sizeof(path), "%s/%s.mp3", SOUND_DIR, s->name);
+    if (stat(path, &st) == 0) return decode_mp3(path, b);
+    return -1;
+}
+
+/*
+ * Make room for bytes by dropping the least recently played sounds the
+ * mixer is not reading. Called with sound_lock held, which keeps them
+ * from being started meanwhile. Returns -1 if there is no room.
+ */
+static int evict_for(size_t bytes, int keep) {
+    audio_mixer_t *mixer = mixer_service_get();
+    while (cache_bytes + bytes > SOUND_CACHE_BYTES) {
+        int victim = -1;
+        for (int i = 0; i < SOUND_COUNT; i++) {
+            sound_entry_t *s = &g_sounds[i];
+            if (i == keep || s->state != SOUND_LOADED) continue;
+            if (mixer && audio_mixer_clip_in_use(mixer, &s->clip)) continue;
+            if (victim < 0 || s->last_used < g_sounds[victim].last_used) victim = i;
+        }
+        if (victim < 0) return -1;
+
+        sound_entry_t *s = &g_sounds[victim];
+        free((void *)s->clip.pcm);
+        cache_bytes -= s->clip.frames * AUDIO_MIXER_FRAME_BYTES;
+        s->clip.pcm = NULL;
+        s->clip.frames = 0;
+        s->state = SOUND_UNLOADED;
+    }
+    return 0;
+}
+
+static void start_clip(sound_entry_t *s) {
+    audio_mixer_t *mixer = mixer_service_get();
+    if (!mixer) return;
+    s->last_used = ++use_clock;
+    audio_mixer_play_clip(mixer, s->source, &s->clip);
+}
+
+/* Loader thread: decodes requested sounds off the UI and audio threads. */
+static void *loader_thread_fn(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&sound_lock);
+    while (!loader_quit) {
+        int next = -1;
+        for (int i = 0; i < SOUND_COUNT && next < 0; i++) {
+            if (g_sounds[i].load_requested) next = i;
+        }
+        if (next < 0) {
+            pthread_cond_wait(&sound_cond, &sound_lock);
+            continue;
+        }
+
+        sound_entry_t *s = &g_sounds[next];
+        s->load_requested = 0;
+        if (s->state != SOUND_UNLOADED) continue;
+
+        pthread_mutex_unlock(&sound_lock);
+        pcm_buffer_t b = { 0 };
+        int ok = decode_sound(s, &b) == 0 && b.frames > 0;
+        pthread_mutex_lock(&sound_lock);
+
+        size_t bytes = b.frames * AUDIO_MIXER_FRAME_BYTES;
+        if (!ok || evict_for(bytes, next) != 0) {
+            /* Without room it stays unloaded and is tried again on its next play. */
+            free(b.pcm);
+            s->state = ok ? SOUND_UNLOADED : SOUND_MISSING;
+            s->play_when_loaded = 0;
+            continue;
+        }
+
+        /* Trim the growth slack; the cache budget counts what is kept. */
+        int16_t *fit = realloc(b.pcm, bytes);
+        s->clip.pcm = fit ? fit : b.pcm;
+        s->clip.frames = b.frames;
+        s->clip.loop = s->loop;
+        s->state = SOUND_LOADED;
+        cache_bytes += bytes;
+        if (s->play_when_loaded) {
+            s->play_when_loaded = 0;
+            start_clip(s);
+        }
+    }
+    pthread_mutex_unlock(&sound_lock);
+    return NULL;
+}
+
+void sound_service_init(void) {
+    pthread_mutex_lock(&sound_lock);
+    loader_quit = 0;
+    for (int i = 0; i < SOUND_COUNT; i++) g_sounds[i].load_requested = 1;
+    pthread_mutex_unlock(&sound_lock);
+
+    if (pthread_create(&loader_thread, NULL, loader_thread_fn, NULL) == 0) loader_started = 1;
+}
+
+void sound_service_shutdown(void) {
+    audio_mixer_t *mixer = mixer_service_get();
+    for (int i = 0; i < SOUND_COUNT; i++) sound_service_stop((sound_id)i);
+
+    pthread_mutex_lock(&sound_lock);
+    loader_quit = 1;
+    pthread_cond_signal(&sound_cond);
+    pthread_mutex_unlock(&sound_lock);
+    if (loader_started) {
+        pthread_join(loader_thread, NULL);
+        loader_started = 0;
+    }
+
+    for (int i = 0; i < SOUND_COUNT; i++) {
+        sound_entry_t *s = &g_sounds[i];
+        while (mixer && audio_mixer_clip_in_use(mixer, &s->clip)) usleep(SOUND_RELEASE_WAIT_US);
+        free((void *)s->clip.pcm);
+        s->clip.pcm = NULL;
+        s->clip.frames = 0;
+        s->state = SOUND_UNLOADED;
+    }
+    cache_bytes = 0;
+}
+
+int sound_service_play(sound_id id) {
+    if (id < 0 || id >= SOUND_COUNT) return -1;
+    sound_entry_t *s = &g_sounds[id];
+
+    pthread_mutex_lock(&sound_lock);
+    int result = 0;
+    if (s->state == SOUND_LOADED) {
+        start_clip(s);
+    } else if (s->state == SOUND_UNLOADED) {
+        s->load_requested = 1;
+        s->play_when_loaded = 1;
+        pthread_cond_signal(&sound_cond);
+    } else {
+        result = -1;
+    }
+    pthread_mutex_unlock(&sound_lock);
+    return result;
+}
+
+void sound_service_stop(sound_id id) {
+    if (id < 0 || id >= SOUND_COUNT) return;
+    sound_entry_t *s = &g_sounds[id];
+    audio_mixer_t *mixer = mixer_service_get();
+
+    pthread_mutex_lock(&sound_lock);
+    s->play_when_loaded = 0;
+    /* Only stop the source if this sound is what it is playing. */
+    if (mixer && s->state == SOUND_LOADED && audio_mixer_clip_in_use(mixer, &s->clip)) {
+        audio_mixer_play_clip(mixer, s->source, NULL);
+    }
+    pthread_mutex_unlock(&sound_lock);
+}
+
+int sound_service_ready(sound_id id) {
+    if (id < 0 || id >= SOUND_COUNT) return 0;
+    pthread_mutex_lock(&sound_lock);
+    int ready = g_sounds[id].state == SOUND_LOADED;
+    pthread_mutex_unlock(&sound_lock);
+    return ready;
+}
@@ -0,0 +1,41 @@
+#ifndef SOUND_SERVICE_H
+#define SOUND_SERVICE_H
+
+/*
+ * sound_service.h
+ *
+ * Sound bank for the ringtone and notification sounds, which have to
+ * start the moment their event happens.
+ *
+ * Each sound is a file in ./Sounds (<name>.wav or <name>.mp3). A loader
+ * thread decodes them once, at startup, into PCM in the mixer's format.
+ * Playing one hands that PCM to the mixer as a clip: no decode, file I/O
+ * or device open on the way. Decoded sounds share a bounded cache; when
+ * it is full the least recently played sound not currently playing is
+ * dropped and decoded again on its next use.
+ */
+
+typedef enum
+{
+	SOUND_RINGTONE = 0,
+	SOUND_NOTIFICATION,
+	SOUND_MESSAGE,
+	SOUND_CLICK,
+	SOUND_COUNT
+} sound_id;
+
+void sound_service_init(void);
+void sound_service_shutdown(void);
+
+/*
+ * Start a sound; the ringtone loops until stopped. A sound that is not
+ * decoded yet starts as soon as the loader has it. Returns -1 if the
+ * sound has no file.
+ */
+int sound_service_play(sound_id id);
+void sound_service_stop(sound_id id);
+
+/* 1 once the sound is decoded and can start instantly. */
+int sound_service_ready(sound_id id);
+
+#endif
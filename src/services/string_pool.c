@@ -0,0 +1,143 @@
+#include "string_pool.h"
+
+#include <ctype.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *key;
+    uint32_t id;
+} collation_entry_t;
+
+static uint64_t hash_string(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    return strcmp(((const collation_entry_t *)a)->key, ((const collation_entry_t *)b)->key);
+}
+
+/* Double the table, keeping it at most half full. */
+static int grow_slots(string_pool_t *p) {
+    size_t slots = p->slot_mask ? (p->slot_mask + 1) * 2 : 64;
+    uint32_t *table = calloc(slots, sizeof(*table));
+    if (!table) return -1;
+    for (size_t id = 0; id < p->count; id++) {
+        size_t s = (size_t)hash_string(p->strings[id]) & (slots - 1);
+        while (table[s]) s = (s + 1) & (slots - 1);
+        table[s] = (uint32_t)id + 1;
+    }
+    free(p->slots);
+    p->slots = table;
+    p->slot_mask = slots - 1;
+    return 0;
+}
+
+void string_pool_init(string_pool_t *p) {
+    memset(p, 0, sizeof(*p));
+}
+
+void string_pool_free(string_pool_t *p) {
+    for (size_t i = 0; i < p->count; i++) free(p->strings[i]);
+    free(p->strings);
+    free(p->ranks);
+    free(p->slots);
+    memset(p, 0, sizeof(*p));
+}
+
+/* Slot holding s, or the empty slot where it would go. */
+static size_t find_slot(const string_pool_t *p, const char *s) {
+    size_t slot = (size_t)hash_string(s) & p->slot_mask;
+    while (p->slots[slot] && strcmp(p->strings[p->slots[slot] - 1], s) != 0) {
+        slot = (slot + 1) & p->slot_mask;
+    }
+    return slot;
+}
+
+int string_pool_find(const string_pool_t *p, const char *s) {
+    if (!p->slots) return -1;
+    size_t slot = find_slot(p, s);
+    return p->slots[slot] ? (int)p->slots[slot] - 1 : -1;
+}
+
+int string_pool_intern(string_pool_t *p, const char *s) {
+    if ((p->count + 1) * 2 > p->slot_mask + 1 && grow_slots(p) != 0) return -1;
+
+    size_t slot = find_slot(p, s);
+    if (p->slots[slot]) return (int)p->slots[slot] - 1;
+
+    if (p->count == p->capacity) {
+        size_t grown_cap = p->capacity ? p->capacity * 2 : 256;
+        char **grown = realloc(p->strings, grown_cap * sizeof(*grown));
+        if (!grown) return -1;
+        p->strings = grown;
+        p->capacity = grown_cap;
+    }
+    char *copy = strdup(s);
+    if (!copy) return -1;
+    p->strings[p->count] = copy;
+    p->slots[slot] = (uint32_t)p->count + 1;
+    return (int)p->count++;
+}
+
+const char *string_pool_get(const string_pool_t *p, uint32_t id) {
+    return id < p->count ? p->strings[id] : NULL;
+}
+
+/* strxfrm() key of s in a new buffer. */
+static char *collation_key(const char *s, int fold_case) {
+    char *folded = NULL;
+    if (fold_case) {
+        folded = strdup(s);
+        if (!folded) return NULL;
+        for (char *c = folded; *c; c++) *c = (char)tolower((unsigned char)*c);
+        s = folded;
+    }
+    size_t len = strxfrm(NULL, s, 0);
+    char *key = malloc(len + 1);
+    if (key) strxfrm(key, s, len + 1);
+    free(folded);
+    return key;
+}
+
+int string_pool_rank(string_pool_t *p) {
+    if (p->ranked == p->count) return 0;
+
+    const char *collate = setlocale(LC_COLLATE, NULL);
+    int fold_case = !collate || strcmp(collate, "C") == 0 || strncmp(collate, "C.", 2) == 0 ||
+                    strcmp(collate, "POSIX") == 0;
+
+    uint32_t *ranks = realloc(p->ranks, (p->count ? p->count : 1) * sizeof(*ranks));
+    collation_entry_t *entries = malloc((p->count ? p->count : 1) * sizeof(*entries));
+    if (ranks) p->ranks = ranks;
+    if (!ranks || !entries) {
+        free(entries);
+        return -1;
+    }
+
+    int ok = 1;
+    for (size_t id = 0; id < p->count; id++) {
+        entries[id].id = (uint32_t)id;
+        entries[id].key = ok ? collation_key(p->strings[id], fold_case) : NULL;
+        if (!entries[id].key) ok = 0;
+    }
+    if (ok) {
+        qsort(entries, p->count, sizeof(*entries), compare_keys);
+        uint32_t rank = 0;
+        for (size_t i = 0; i < p->count; i++) {
+            if (i > 0 && strcmp(entries[i].key, entries[i - 1].key) != 0) rank++;
+            p->ranks[entries[i].id] = rank;
+        }
+        p->ranked = p->count;
+    }
+
+    for (size_t i = 0; i < p->count; i++) free(entries[i].key);
+    free(entries);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,47 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * string_pool.h
+ *
+ * Interned strings for the music library: each distinct title, artist or
+ * genre is stored once and named by a small id, so an artist's hundred
+ * tracks share one copy.
+ *
+ * string_pool_rank() gives every string its place in the locale's
+ * collation order. It computes one strxfrm() key per distinct string,
+ * sorts the keys once and keeps only the resulting rank next to the
+ * string; after that, ordering tracks by any field is an integer
+ * comparison. Equal keys get equal ranks.
+ */
+
+typedef struct
+{
+	char **strings;	 /* Owned, by id */
+	uint32_t *ranks; /* Collation rank by id, once ranked */
+	size_t count;
+	size_t capacity;
+	uint32_t *slots; /* Hash table: id + 1, 0 when empty */
+	size_t slot_mask;
+	size_t ranked; /* Strings covered by ranks */
+} string_pool_t;
+
+void string_pool_init(string_pool_t *p);
+void string_pool_free(string_pool_t *p);
+
+/* Id of s, adding a copy if it is new; -1 if out of memory. */
+int string_pool_intern(string_pool_t *p, const char *s);
+int string_pool_find(const string_pool_t *p, const char *s); /* -1 if absent */
+const char *string_pool_get(const string_pool_t *p, uint32_t id);
+
+/*
+ * Rank every string by LC_COLLATE. Under C and C.UTF-8, which order by
+ * code point, ASCII letters are folded first so case does not split the
+ * order. The pool must not change while this runs.
+ */
+int string_pool_rank(string_pool_t *p);
+
+#endif
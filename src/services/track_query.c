@@ -0,0 +1,246 @@
+#include "track_query.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACK_QUERY_MAX_LINE 512
+#define SECONDS_PER_DAY 86400u
+
+static size_t word_count(size_t rows) {
+    return (rows + 63) / 64;
+}
+
+static int grow_bitset(track_bitset_t *b, size_t rows) {
+    size_t have = word_count(b->rows);
+    size_t want = word_count(rows);
+    if (want > have || !b->words) {
+        uint64_t *words = realloc(b->words, (want ? want : 1) * sizeof(*words));
+        if (!words) return -1;
+        memset(words + have, 0, ((want ? want : 1) - have) * sizeof(*words));
+        b->words = words;
+    }
+    if (rows > b->rows) b->rows = rows;
+    return 0;
+}
+
+int track_table_resize(track_table_t *t, size_t rows) {
+    if (rows > t->capacity) {
+        size_t cap = t->capacity ? t->capacity : 1024;
+        while (cap < rows) cap *= 2;
+        for (int c = 0; c < TRACK_COL_COUNT; c++) {
+            uint32_t *col = realloc(t->col[c], cap * sizeof(*col));
+            if (!col) return -1;
+            memset(col + t->capacity, 0, (cap - t->capacity) * sizeof(*col));
+            t->col[c] = col;
+        }
+        uint64_t *live = realloc(t->live, word_count(cap) * sizeof(*live));
+        if (!live) return -1;
+        memset(live + word_count(t->capacity), 0, (word_count(cap) - word_count(t->capacity)) * sizeof(*live));
+        t->live = live;
+        t->capacity = cap;
+    }
+    if (rows > t->rows) t->rows = rows;
+    return 0;
+}
+
+void track_table_free(track_table_t *t) {
+    for (int c = 0; c < TRACK_COL_COUNT; c++) free(t->col[c]);
+    free(t->live);
+    memset(t, 0, sizeof(*t));
+}
+
+void track_table_set_live(track_table_t *t, size_t row, int live) {
+    if (row >= t->rows) return;
+    uint64_t bit = 1ull << (row % 64);
+    if (live) {
+        t->live[row / 64] |= bit;
+    } else {
+        t->live[row / 64] &= ~bit;
+    }
+}
+
+static int add_term(track_query_t *q, track_column column, uint32_t lo, uint32_t hi, uint32_t days) {
+    track_term_t *terms = realloc(q->terms, (q->count + 1) * sizeof(*terms));
+    if (!terms) return -1;
+    q->terms = terms;
+    q->terms[q->count++] = (track_term_t){ column, lo, hi, days };
+    return 0;
+}
+
+int track_query_add(track_query_t *q, track_column column, uint32_t lo, uint32_t hi) {
+    return add_term(q, column, lo, hi, 0);
+}
+
+int track_query_add_recent(track_query_t *q, uint32_t days) {
+    return add_term(q, TRACK_COL_ADDED, 0, UINT32_MAX, days);
+}
+
+/* "a-b", "a-", "-b" or "a" into an inclusive range. */
+static void parse_range(const char *s, uint32_t *lo, uint32_t *hi) {
+    char *end;
+    *lo = 0;
+    *hi = UINT32_MAX;
+    if (*s != '-') {
+        *lo = (uint32_t)strtoul(s, &end, 10);
+        s = end;
+        if (*s != '-') *hi = *lo;
+    }
+    if (*s == '-' && isdigit((unsigned char)s[1])) *hi = (uint32_t)strtoul(s + 1, NULL, 10);
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    size_t len = strlen(s);
+    while (len > 0 && isspace((unsigned char)s[len - 1])) s[--len] = '\0';
+    return s;
+}
+
+int track_query_load(track_query_t *q, const char *path, track_query_resolve_fn resolve, void *ctx) {
+    memset(q, 0, sizeof(*q));
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char *dot = strrchr(base, '.');
+    int stem = dot ? (int)(dot - base) : (int)strlen(base);
+    snprintf(q->name, sizeof(q->name), "%.*s", stem, base);
+
+    char line[TRACK_QUERY_MAX_LINE];
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *field = trim(line);
+        if (*field == '\0') continue;
+        char *value = field;
+        while (*value && !isspace((unsigned char)*value)) value++;
+        if (*value) *value++ = '\0';
+        value = trim(value);
+
+        uint32_t lo, hi;
+        if (strcmp(field, "genre") == 0 || strcmp(field, "author") == 0) {
+            track_column column = field[0] == 'g' ? TRACK_COL_GENRE : TRACK_COL_AUTHOR;
+            int v = resolve(column, value, ctx);
+            lo = hi = v >= 0 ? (uint32_t)v : TRACK_QUERY_NONE;
+            ok = add_term(q, column, lo, hi, 0) == 0;
+        } else if (strcmp(field, "duration") == 0 || strcmp(field, "plays") == 0 || strcmp(field, "copies") == 0) {
+            track_column column = field[0] == 'd' ? TRACK_COL_DURATION : field[0] == 'p' ? TRACK_COL_PLAYS : TRACK_COL_COPIES;
+            parse_range(value, &lo, &hi);
+            ok = add_term(q, column, lo, hi, 0) == 0;
+        } else if (strcmp(field, "added") == 0) {
+            ok = track_query_add_recent(q, (uint32_t)strtoul(value, NULL, 10)) == 0;
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        track_query_free(q);
+        return -1;
+    }
+    return 0;
+}
+
+void track_query_free(track_query_t *q) {
+    free(q->terms);
+    q->terms = NULL;
+    q->count = 0;
+}
+
+void track_query_anchor(track_query_t *q, uint32_t now) {
+    for (size_t i = 0; i < q->count; i++) {
+        track_term_t *t = &q->terms[i];
+        if (t->column != TRACK_COL_ADDED || t->days == 0) continue;
+        uint64_t back = (uint64_t)t->days * SECONDS_PER_DAY;
+        t->lo = back < now ? now - (uint32_t)back : 0;
+        t->hi = UINT32_MAX;
+    }
+}
+
+/*
+ * OR the rows of col inside [lo, hi] into out. One unsigned compare per
+ * row and no branches, so it vectorizes; the tail word is handled apart.
+ */
+static void scan_range(const uint32_t *col, size_t rows, uint32_t lo, uint32_t hi, uint64_t *out) {
+    const uint32_t span = hi - lo;
+    size_t full = rows / 64;
+    for (size_t w = 0; w < full; w++) {
+        const uint32_t *v = col + w * 64;
+        uint64_t bits = 0;
+        for (unsigned b = 0; b < 64; b++) bits |= (uint64_t)(v[b] - lo <= span) << b;
+        out[w] |= bits;
+    }
+    uint64_t bits = 0;
+    for (size_t r = full * 64; r < rows; r++) bits |= (uint64_t)(col[r] - lo <= span) << (r % 64);
+    if (rows % 64) out[full] |= bits;
+}
+
+static int term_matches(const track_term_t *term, const track_table_t *t, size_t row) {
+    return t->col[term->column][row] - term->lo <= term->hi - term->lo;
+}
+
+static size_t popcount_words(const uint64_t *words, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) count += (size_t)__builtin_popcountll(words[i]);
+    return count;
+}
+
+int track_query_run(const track_query_t *q, const track_table_t *t, track_bitset_t *out) {
+    size_t words = word_count(t->rows);
+    if (grow_bitset(out, t->rows) != 0) return -1;
+    memcpy(out->words, t->live, words * sizeof(*out->words));
+
+    uint64_t *group = malloc((words ? words : 1) * sizeof(*group));
+    if (!group) return -1;
+    for (int c = 0; c < TRACK_COL_COUNT; c++) {
+        int used = 0;
+        for (size_t i = 0; i < q->count; i++) {
+            if (q->terms[i].column != (track_column)c) continue;
+            if (!used) memset(group, 0, words * sizeof(*group));
+            scan_range(t->col[c], t->rows, q->terms[i].lo, q->terms[i].hi, group);
+            used = 1;
+        }
+        if (!used) continue;
+        for (size_t w = 0; w < words; w++) out->words[w] &= group[w];
+    }
+    free(group);
+    out->matches = popcount_words(out->words, words);
+    return 0;
+}
+
+int track_query_update(const track_query_t *q, const track_table_t *t, track_bitset_t *b, size_t row) {
+    if (row >= t->rows || grow_bitset(b, t->rows) != 0) return -1;
+
+    int match = (t->live[row / 64] >> (row % 64)) & 1;
+    for (int c = 0; c < TRACK_COL_COUNT && match; c++) {
+        int used = 0;
+        int any = 0;
+        for (size_t i = 0; i < q->count && !any; i++) {
+            if (q->terms[i].column != (track_column)c) continue;
+            used = 1;
+            any = term_matches(&q->terms[i], t, row);
+        }
+        if (used && !any) match = 0;
+    }
+
+    uint64_t bit = 1ull << (row % 64);
+    int had = (b->words[row / 64] & bit) != 0;
+    if (match && !had) {
+        b->words[row / 64] |= bit;
+        b->matches++;
+    } else if (!match && had) {
+        b->words[row / 64] &= ~bit;
+        b->matches--;
+    }
+    return match;
+}
+
+int track_bitset_test(const track_bitset_t *b, size_t row) {
+    return row < b->rows && ((b->words[row / 64] >> (row % 64)) & 1);
+}
+
+void track_bitset_free(track_bitset_t *b) {
+    free(b->words);
+    memset(b, 0, sizeof(*b));
+}
@@ -0,0 +1,100 @@
+#ifndef TRACK_QUERY_H
+#define TRACK_QUERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * track_query.h
+ *
+ * Smart playlist queries over a column store of track metadata. Each
+ * column is a plain uint32_t array indexed by library track, so a query
+ * term is one branch-free range test per row, written so the compiler can
+ * vectorize it, and yields 64 result bits per word. Terms on the same
+ * column are ORed (genre Rock or genre Jazz); different columns are ANDed.
+ *
+ * Results are bitsets over the rows. A full run reads each queried column
+ * once; after that, a change to one track (a new play, a measured
+ * duration, a track added or removed) is re-tested on its own with
+ * track_query_update().
+ *
+ * A query file has one term per line, '#' starts a comment:
+ *
+ *   genre Rock          genre or author by name, exact
+ *   author Nina Simone
+ *   duration 120-300    seconds, either end may be left open ("-240")
+ *   plays 5-            times heard to the end
+ *   added 30            file changed within the last 30 days
+ *   copies 2-           tracks with the same audio, this one included
+ */
+
+typedef enum
+{
+	TRACK_COL_GENRE = 0,
+	TRACK_COL_AUTHOR,
+	TRACK_COL_DURATION, /* Seconds, 0 until known */
+	TRACK_COL_PLAYS,
+	TRACK_COL_ADDED, /* Unix time */
+	TRACK_COL_COPIES, /* Tracks with the same audio, 0 until hashed */
+	TRACK_COL_COUNT
+} track_column;
+
+/* Column value no row holds: a name that is not in the library. */
+#define TRACK_QUERY_NONE UINT32_MAX
+
+typedef struct
+{
+	uint32_t *col[TRACK_COL_COUNT];
+	uint64_t *live; /* Rows holding a track */
+	size_t rows;
+	size_t capacity;
+} track_table_t;
+
+typedef struct
+{
+	track_column column;
+	uint32_t lo; /* Inclusive range */
+	uint32_t hi;
+	uint32_t days; /* TRACK_COL_ADDED: the range is set by track_query_anchor() */
+} track_term_t;
+
+typedef struct
+{
+	char name[64];
+	track_term_t *terms;
+	size_t count;
+} track_query_t;
+
+typedef struct
+{
+	uint64_t *words;
+	size_t rows;
+	size_t matches;
+} track_bitset_t;
+
+/* Value of a genre or author name, or -1 if no track has it. */
+typedef int (*track_query_resolve_fn)(track_column column, const char *name, void *ctx);
+
+/* Rows start zeroed and not live; growing keeps existing rows. */
+int track_table_resize(track_table_t *t, size_t rows);
+void track_table_free(track_table_t *t);
+void track_table_set_live(track_table_t *t, size_t row, int live);
+
+int track_query_add(track_query_t *q, track_column column, uint32_t lo, uint32_t hi);
+int track_query_add_recent(track_query_t *q, uint32_t days);
+int track_query_load(track_query_t *q, const char *path, track_query_resolve_fn resolve, void *ctx);
+void track_query_free(track_query_t *q);
+
+/* Recent-days terms count back from now (Unix time). */
+void track_query_anchor(track_query_t *q, uint32_t now);
+
+/* Full evaluation into out, replacing its contents. */
+int track_query_run(const track_query_t *q, const track_table_t *t, track_bitset_t *out);
+
+/* Re-test one row after it changed, was added or was removed. */
+int track_query_update(const track_query_t *q, const track_table_t *t, track_bitset_t *b, size_t row);
+
+int track_bitset_test(const track_bitset_t *b, size_t row);
+void track_bitset_free(track_bitset_t *b);
+
+#endif
@@ -1,14 +1,22 @@
 #include "voice_memo_service.h"
+#include "mixer_service.h"
+#include "audio/audio_resample.h"
+#include "audio/audio_wav.h"
 
 #include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #define INITIAL_MEMO_CAPACITY 16
 #define TICK_STEP_MS 33
+#define MEMO_READ_FRAMES 1024
+#define MEMO_WAIT_US 5000
 
 static VoiceMemo **memos_index = NULL;
 static size_t memos_count = 0;
@@ -21,6 +29,19 @@ static unsigned memo_serial = 0;
 
 static const char *VOICE_MEMO_PATH = "./VoiceMemos";
 
+/*
+ * Memo audio. "x.vmemo" plays the sidecar "x.wav" when there is one,
+ * through the mixer's memo source, which ducks any music underneath.
+ * Memos without a sidecar keep the timer-only playback.
+ */
+static pthread_t audio_thread;
+static int audio_started = 0;
+static atomic_int audio_quit;
+static atomic_int audio_done;
+static atomic_ullong audio_written; /* Bytes handed to the mixer */
+static audio_wav_t audio_wav;
+static audio_resampler_t audio_rs;
+
 static int ensure_capacity(void)
 {
 	if (memos_count < memos_capacity)
@@ -57,6 +78,106 @@ static char *make_timestamp_filename(void)
 	return strdup(final_name);
 }
 
+static void sidecar_path(const char *filename, char *out, size_t out_size)
+{
+	const char *ext = strrchr(filename, '.');
+	int base_len = ext ? (int)(ext - filename) : (int)strlen(filename);
+	snprintf(out, out_size, "%s/%.*s.wav", VOICE_MEMO_PATH, base_len, filename);
+}
+
+/* Hand PCM to the mixer, waiting for room; -1 if asked to stop. */
+static int audio_push(audio_mixer_t *mixer, const int16_t *pcm, size_t frames)
+{
+	const unsigned char *p = (const unsigned char *)pcm;
+	size_t bytes = frames * AUDIO_MIXER_FRAME_BYTES;
+	while (bytes > 0)
+	{
+		size_t written = audio_mixer_write(mixer, AUDIO_SOURCE_MEMO, p, bytes);
+		p += written;
+		bytes -= written;
+		atomic_fetch_add(&audio_written, written);
+		if (bytes == 0)
+			break;
+		if (atomic_load(&audio_quit))
+			return -1;
+		usleep(MEMO_WAIT_US);
+	}
+	return 0;
+}
+
+static void *audio_thread_fn(void *arg)
+{
+	audio_mixer_t *mixer = arg;
+	int16_t in[MEMO_READ_FRAMES * 2];
+	int16_t *out = malloc(audio_resampler_max_out(&audio_rs, MEMO_READ_FRAMES) * AUDIO_MIXER_FRAME_BYTES);
+	if (!out)
+	{
+		atomic_store(&audio_done, 1);
+		return NULL;
+	}
+
+	while (!atomic_load(&audio_quit))
+	{
+		size_t frames = audio_wav_read(&audio_wav, in, MEMO_READ_FRAMES);
+		size_t produced = frames ? audio_resampler_process(&audio_rs, in, frames, out)
+								 : audio_resampler_flush(&audio_rs, out);
+		if (audio_push(mixer, out, produced) != 0 || frames == 0)
+			break;
+	}
+
+	free(out);
+	atomic_store(&audio_done, 1);
+	return NULL;
+}
+
+static void audio_stop(void)
+{
+	if (!audio_started)
+		return;
+	atomic_store(&audio_quit, 1);
+	pthread_join(audio_thread, NULL);
+	audio_started = 0;
+
+	audio_mixer_t *mixer = mixer_service_get();
+	audio_mixer_drop(mixer, AUDIO_SOURCE_MEMO);
+	audio_mixer_pause(mixer, AUDIO_SOURCE_MEMO, 0);
+	audio_wav_close(&audio_wav);
+	audio_resampler_free(&audio_rs);
+}
+
+/* Start the memo's sidecar audio if it has one; 0 on success. */
+static int audio_start(VoiceMemo *memo)
+{
+	audio_mixer_t *mixer = mixer_service_get();
+	if (!mixer)
+		return -1;
+
+	char path[1024];
+	sidecar_path(memo->filename, path, sizeof(path));
+	if (audio_wav_open(&audio_wav, path) != 0)
+		return -1;
+	if (audio_resampler_init(&audio_rs, audio_wav.rate, audio_wav.channels,
+							 AUDIO_MIXER_RATE, AUDIO_MIXER_CHANNELS) != 0)
+	{
+		audio_wav_close(&audio_wav);
+		return -1;
+	}
+
+	atomic_store(&audio_quit, 0);
+	atomic_store(&audio_done, 0);
+	atomic_store(&audio_written, 0);
+	audio_mixer_pause(mixer, AUDIO_SOURCE_MEMO, 0);
+	if (pthread_create(&audio_thread, NULL, audio_thread_fn, mixer) != 0)
+	{
+		audio_wav_close(&audio_wav);
+		audio_resampler_free(&audio_rs);
+		return -1;
+	}
+	audio_started = 1;
+	memo->duration_ms = (int)(audio_wav_frames(&audio_wav) * 1000 / (uint64_t)audio_wav.rate);
+	return 0;
+}
+
 static int write_memo_file(const VoiceMemo *memo)
 {
 	if (!memo || !memo->filename)
@@ -241,9 +362,11 @@ int voice_memo_service_play_start(const char *filename)
 	if (!found)
 		return -1;
 
+	audio_stop();
 	current_memo = (VoiceMemo *)found;
 	current_elapsed_ms = 0;
 	current_state = VM_PLAYING;
+	audio_start(current_memo);
 	return 0;
 }
 
@@ -252,6 +375,8 @@ int voice_memo_service_play_pause(void)
 	if (current_state != VM_PLAYING)
 		return -1;
 	current_state = VM_PAUSED;
+	if (audio_started)
+		audio_mixer_pause(mixer_service_get(), AUDIO_SOURCE_MEMO, 1);
 	return 0;
 }
 
@@ -260,6 +385,8 @@ int voice_memo_service_play_resume(void)
 	if (current_state != VM_PAUSED)
 		return -1;
 	current_state = VM_PLAYING;
+	if (audio_started)
+		audio_mixer_pause(mixer_service_get(), AUDIO_SOURCE_MEMO, 0);
 	return 0;
 }
 
@@ -267,6 +394,7 @@ int voice_memo_service_play_stop(void)
 {
 	if (current_state != VM_PLAYING && current_state != VM_PAUSED)
 		return -1;
+	audio_stop();
 	current_state = VM_IDLE;
 	current_memo = NULL;
 	current_elapsed_ms = 0;
@@ -286,6 +414,7 @@ int voice_memo_service_delete(const char *filename)
 
 		if (current_memo == memo)
 		{
+			audio_stop();
 			current_state = VM_IDLE;
 			current_memo = NULL;
 			current_elapsed_ms = 0;
@@ -294,6 +423,8 @@ int voice_memo_service_delete(const char *filename)
 		char path[1024];
 		snprintf(path, sizeof(path), "%s/%s", VOICE_MEMO_PATH, memo->filename);
 		remove(path);
+		sidecar_path(memo->filename, path, sizeof(path));
+		remove(path);
 
 		free(memo->filename);
 		free(memo);
@@ -317,6 +448,25 @@ int voice_memo_service_tick(void)
 		return 0;
 	}
 
+	/* With real audio, progress is what has been heard, not wall time. */
+	if (current_state == VM_PLAYING && audio_started)
+	{
+		audio_mixer_t *mixer = mixer_service_get();
+		unsigned long long written = atomic_load(&audio_written);
+		size_t latency = audio_mixer_latency(mixer, AUDIO_SOURCE_MEMO);
+		unsigned long long heard = written > latency ? written - latency : 0;
+		current_elapsed_ms = (int)(heard / AUDIO_MIXER_FRAME_BYTES * 1000 / AUDIO_MIXER_RATE);
+
+		if (atomic_load(&audio_done) && audio_mixer_queued(mixer, AUDIO_SOURCE_MEMO) == 0)
+		{
+			audio_stop();
+			current_state = VM_IDLE;
+			current_memo = NULL;
+			current_elapsed_ms = 0;
+		}
+		return 0;
+	}
+
 	if (current_state == VM_PLAYING)
 	{
 		current_elapsed_ms += TICK_STEP_MS;
@@ -345,6 +495,7 @@ int voice_memo_service_total_ms(void)
 
 void voice_memo_service_shutdown(void)
 {
+	audio_stop();
 	if (!memos_index)
 		return;
 
@@ -11,9 +11,10 @@
  * Each memo is identified by its filename.
  *
  * Mock stage:
- * - No real audio recording yet
- * - Recording/playback are simulated using timers
+ * - No real audio recording yet; recording is simulated using timers
  * - One file per memo in ./VoiceMemos
+ * - A memo plays its sidecar WAV (same name, .wav) through the mixer
+ *   when there is one, ducking any music; otherwise playback is a timer
  */
 
 typedef enum
@@ -216,6 +216,7 @@ screen_id screen_voice_memo_input(uint32_t key);
 
 void screen_notes_draw(struct ncplane *phone);
 screen_id screen_notes_input(uint32_t key);
+int screen_notes_typing(void);  /* 1 while a text field takes every key */
 
 /* ─── Screen Input Handlers ────────────────────────────────────────────── */
 